@@ -0,0 +1,441 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+
+#include <ScanBytes/ScanBytes.hpp>
+
+#include <HydrArgs/HydrArgs.hpp>
+
+#include "Corpus.hpp"
+#include "PerfCounters.hpp"
+
+using namespace ScanBytes::Bench;
+
+/// One backend scanning one corpus with a certain tier and count of threads
+struct RunResult{
+	std::string corpus;
+	CorpusSpec spec;
+	uint64_t dataSize;
+	ScanBytes::Backend backend;
+	ScanBytes::Tier tier;
+	uint16_t threads;
+	uint8_t attempts;
+	uint64_t matches;
+	bool correct; // the offsets found are as many as the generator has put
+	double minUs, medianUs, p99Us, meanUs;
+	bool hasCounters;
+	uint64_t counters[static_cast<uint8_t>(PerfCounter::Count)]; // per attempt
+};
+
+std::vector<std::string> splitList(const std::string &list){
+	std::vector<std::string> res;
+	std::istringstream s(list);
+	std::string el;
+	while(std::getline(s, el, ',')){
+		if(!el.empty()){
+			res.emplace_back(el);
+		}
+	}
+	return res;
+}
+
+/// A count of bytes with an optional K, M or G suffix
+size_t parseSize(const std::string &s){
+	size_t pos;
+	size_t res = std::stoull(s, &pos);
+	if(pos + 1 == s.size()){
+		switch(s[pos]){
+			case 'G':
+				res <<= 10;
+				[[fallthrough]];
+			case 'M':
+				res <<= 10;
+				[[fallthrough]];
+			case 'K':
+				res <<= 10;
+				return res;
+		}
+	}
+	if(pos != s.size() || !res){
+		throw std::invalid_argument(s);
+	}
+	return res;
+}
+
+/// The backends hardcoding their alphabets are meaningful only for the corpora having the same one
+bool scansAlphabet(ScanBytes::Backend b, const std::vector<uint8_t> &alphabet){
+	switch(b){
+		case ScanBytes::Backend::LF:
+		case ScanBytes::Backend::CSV:
+		case ScanBytes::Backend::TSV:
+		case ScanBytes::Backend::Space:
+		case ScanBytes::Backend::Punct:
+		case ScanBytes::Backend::CharSet:
+		{
+			std::vector<uint8_t> chars(alphabet);
+			return ScanBytes::getCharSetBackend(chars) == b;
+		}
+		default:
+			return true;
+	}
+}
+
+void computeStatistics(ScanBytes::BenchmarkResultT &durations, RunResult &r){
+	std::vector<double> us;
+	for(auto d: durations){
+		us.emplace_back(d.count());
+	}
+	std::sort(begin(us), end(us));
+	auto n = us.size();
+	r.minUs = us[0];
+	r.medianUs = n % 2 ? us[n / 2] : (us[n / 2 - 1] + us[n / 2]) / 2;
+	r.p99Us = us[(n * 99 + 99) / 100 - 1];  // nearest rank
+	double sum = 0;
+	for(auto el: us){
+		sum += el;
+	}
+	r.meanUs = sum / n;
+}
+
+inline double getGBps(const RunResult &r){
+	return r.dataSize / r.medianUs / 1e3;
+}
+
+inline double getMatchesPerSecond(const RunResult &r){
+	return r.matches / r.medianUs * 1e6;
+}
+
+void printResult(const RunResult &r){
+	std::cout << std::left << std::setw(36) << r.corpus << std::setw(10) << ScanBytes::backendNames[static_cast<uint8_t>(r.backend)] << std::setw(9) << ScanBytes::tierNames[static_cast<uint8_t>(r.tier)] << std::right << std::setw(4) << r.threads;
+	std::cout << std::fixed << std::setprecision(3) << std::setw(9) << getGBps(r) << " GB/s" << std::setw(10) << getMatchesPerSecond(r) / 1e6 << " Mmatch/s";
+	std::cout << std::setprecision(1) << "  median " << r.medianUs << " us, p99 " << r.p99Us << " us";
+	if(r.hasCounters){
+		std::cout << std::setprecision(3) << ", " << static_cast<double>(r.counters[static_cast<uint8_t>(PerfCounter::Cycles)]) / r.dataSize << " cycles/B, " << r.counters[static_cast<uint8_t>(PerfCounter::BranchMisses)] << " branch misses, " << r.counters[static_cast<uint8_t>(PerfCounter::LLCMisses)] << " LLC misses";
+	}
+	if(!r.correct){
+		std::cout << "  WRONG COUNT OF MATCHES";
+	}
+	std::cout << std::defaultfloat << std::endl;
+}
+
+void writeJSONString(std::ostream &out, const std::string &s){
+	out << '"';
+	for(char c: s){
+		if(c == '"' || c == '\\'){
+			out << '\\' << c;
+		} else if(static_cast<uint8_t>(c) < 0x20){
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<unsigned>(c) << std::dec << std::setfill(' ');
+		} else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+std::string getCPUModel(){
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+	while(std::getline(cpuinfo, line)){
+		if(line.starts_with("model name")){
+			auto pos = line.find(':');
+			if(pos != std::string::npos){
+				return line.substr(line.find_first_not_of(" \t", pos + 1));
+			}
+		}
+	}
+	return "unknown";
+}
+
+/// One object per run, the fields are flat so that runs of different builds can be joined on corpus, backend, tier and threads
+void writeJSON(std::ostream &out, std::vector<RunResult> &results, uint64_t seed){
+	out << std::setprecision(6);
+	out << "{\n\t\"cpu\": ";
+	writeJSONString(out, getCPUModel());
+	out << ",\n\t\"bestTier\": \"" << ScanBytes::tierNames[static_cast<uint8_t>(ScanBytes::detectBestTier())] << "\",\n";
+	out << "\t\"seed\": " << seed << ",\n";
+	out << "\t\"results\": [";
+	bool first = true;
+	for(auto &r: results){
+		out << (first ? "\n" : ",\n") << "\t\t{";
+		first = false;
+		out << "\"corpus\": ";
+		writeJSONString(out, r.corpus);
+		out << ", \"kind\": \"" << corpusKindNames[static_cast<uint8_t>(r.spec.kind)] << "\"";
+		out << ", \"size\": " << r.dataSize;
+		if(r.spec.kind == CorpusKind::Random){
+			out << ", \"density\": " << r.spec.density << ", \"alphabetSize\": " << static_cast<unsigned>(r.spec.alphabetSize);
+		} else {
+			out << ", \"lengths\": \"" << lengthDistributionNames[static_cast<uint8_t>(r.spec.lengths)] << "\", \"meanLength\": " << r.spec.meanLength;
+		}
+		out << ", \"backend\": \"" << ScanBytes::backendNames[static_cast<uint8_t>(r.backend)] << "\"";
+		out << ", \"tier\": \"" << ScanBytes::tierNames[static_cast<uint8_t>(r.tier)] << "\"";
+		out << ", \"threads\": " << r.threads << ", \"attempts\": " << static_cast<unsigned>(r.attempts);
+		out << ", \"matches\": " << r.matches << ", \"correct\": " << (r.correct ? "true" : "false");
+		out << ", \"minUs\": " << r.minUs << ", \"medianUs\": " << r.medianUs << ", \"p99Us\": " << r.p99Us << ", \"meanUs\": " << r.meanUs;
+		out << ", \"GBps\": " << getGBps(r) << ", \"matchesPerSecond\": " << getMatchesPerSecond(r);
+		if(r.hasCounters){
+			for(uint8_t i = 0; i < static_cast<uint8_t>(PerfCounter::Count); ++i){
+				out << ", \"" << perfCounterNames[i] << "\": " << r.counters[i];
+			}
+		}
+		out << "}";
+	}
+	out << "\n\t]\n}\n";
+}
+
+struct Options{
+	std::vector<CorpusSpec> corpora;
+	std::vector<ScanBytes::Backend> backends;
+	std::vector<ScanBytes::Tier> tiers;
+	std::vector<uint16_t> threads;
+	uint8_t attempts;
+	uint64_t seed;
+};
+
+/// Returns false if the run has failed
+bool runCorpus(Options &o, const CorpusSpec &spec, PerfCounters *counters, std::vector<RunResult> &results){
+	auto corpus = generateCorpus(spec, o.seed);
+	ScanBytes::ScannableT m{corpus.data.data(), corpus.data.size()};
+	auto name = spec.name();
+	bool ok = true;
+
+	for(auto tier: o.tiers){
+		try{
+			ScanBytes::forceTier(tier);
+		} catch(std::exception &e){
+			std::cerr << name << ": skipping tier " << ScanBytes::tierNames[static_cast<uint8_t>(tier)] << ": " << e.what() << std::endl;
+			continue;
+		}
+		for(auto b: o.backends){
+			if(b == ScanBytes::Backend::Auto){
+				b = ScanBytes::detectProperBackend(corpus.alphabet);
+			}
+			if(!scansAlphabet(b, corpus.alphabet)){
+				continue;
+			}
+			for(auto threads: o.threads){
+				ScanBytes::setThreadsCount(threads);
+				RunResult r{
+					.corpus = name,
+					.spec = spec,
+					.dataSize = corpus.data.size(),
+					.backend = b,
+					.tier = ScanBytes::getTier(),
+					.threads = ScanBytes::getThreadsCount(),
+					.attempts = o.attempts,
+					.hasCounters = counters != nullptr,
+				};
+				try{
+					uint64_t found = 0;
+					for(auto &chunk: ScanBytes::scan(m, corpus.alphabet, b)){
+						found += chunk->vec.size();
+					}
+					r.matches = b == ScanBytes::Backend::CSVQuoted ? corpus.unquotedMatches : corpus.matches;
+					r.correct = found == r.matches;
+
+					if(counters){
+						counters->start();
+					}
+					auto durations = ScanBytes::benchmark(b, m, corpus.alphabet, o.attempts);
+					if(counters){
+						counters->stop(r.counters);
+						for(auto &c: r.counters){
+							c /= o.attempts;
+						}
+					}
+					computeStatistics(durations, r);
+				} catch(std::logic_error &e){
+					std::cerr << name << ": skipping backend " << ScanBytes::backendNames[static_cast<uint8_t>(b)] << ": " << e.what() << std::endl;
+					break;
+				}
+				ok &= r.correct;
+				printResult(r);
+				results.emplace_back(r);
+			}
+		}
+	}
+	ScanBytes::forceTier(ScanBytes::Tier::Auto);
+	ScanBytes::setThreadsCount(0);
+	return ok;
+}
+
+std::vector<CorpusSpec> makeCorpora(const std::string &kinds, const std::string &sizes, const std::string &densities, const std::string &alphabetSizes, const std::string &lengths, size_t meanLength){
+	std::vector<CorpusSpec> res;
+	for(auto &kindName: splitList(kinds)){
+		auto kind = getCorpusKindByName(kindName);
+		if(kind == CorpusKind::Unknown){
+			throw std::invalid_argument("Invalid corpus kind: " + kindName);
+		}
+		for(auto &sizeStr: splitList(sizes)){
+			auto size = parseSize(sizeStr);
+			if(kind == CorpusKind::Random){
+				for(auto &densityStr: splitList(densities)){
+					for(auto &alphabetSizeStr: splitList(alphabetSizes)){
+						auto alphabetSize = std::stoul(alphabetSizeStr);
+						if(!alphabetSize || alphabetSize > maxAlphabetSize){
+							throw std::invalid_argument("Alphabet size must be within 1.." + std::to_string(maxAlphabetSize));
+						}
+						res.emplace_back(CorpusSpec{.kind = kind, .size = size, .density = std::stod(densityStr), .alphabetSize = static_cast<uint8_t>(alphabetSize)});
+					}
+				}
+			} else {
+				for(auto &lengthsName: splitList(lengths)){
+					auto d = getLengthDistributionByName(lengthsName);
+					if(d == LengthDistribution::Unknown){
+						throw std::invalid_argument("Invalid length distribution: " + lengthsName);
+					}
+					res.emplace_back(CorpusSpec{.kind = kind, .size = size, .lengths = d, .meanLength = meanLength});
+				}
+			}
+		}
+	}
+	return res;
+}
+
+std::vector<ScanBytes::Backend> parseBackends(const std::string &list){
+	std::vector<ScanBytes::Backend> res;
+	if(list == "all"){
+		for(auto b: {ScanBytes::Backend::JIT, ScanBytes::Backend::Fallback, ScanBytes::Backend::LF, ScanBytes::Backend::CSV, ScanBytes::Backend::TSV, ScanBytes::Backend::Space, ScanBytes::Backend::Punct, ScanBytes::Backend::CharSet, ScanBytes::Backend::SIMD, ScanBytes::Backend::Shuffle, ScanBytes::Backend::CSVQuoted}){
+			res.emplace_back(b);
+		}
+		return res;
+	}
+	for(auto &name: splitList(list)){
+		auto b = ScanBytes::getBackendByName(name);
+		if(b == ScanBytes::Backend::Unknown){
+			throw std::invalid_argument("Invalid backend name: " + name);
+		}
+		res.emplace_back(b);
+	}
+	return res;
+}
+
+std::vector<ScanBytes::Tier> parseTiers(const std::string &list){
+	std::vector<ScanBytes::Tier> res;
+	for(auto &name: splitList(list)){
+		auto t = ScanBytes::getTierByName(name);
+		if(t == ScanBytes::Tier::Unknown){
+			throw std::invalid_argument("Invalid tier name: " + name);
+		}
+		res.emplace_back(t);
+	}
+	return res;
+}
+
+/// "sweep" means 1, 2, 4 ... up to the count of the CPUs available
+std::vector<uint16_t> parseThreads(const std::string &list){
+	std::vector<uint16_t> res;
+	if(list == "sweep"){
+		uint16_t available = ScanBytes::getThreadsCount();
+		for(uint16_t n = 1; n < available; n *= 2){
+			res.emplace_back(n);
+		}
+		res.emplace_back(available);
+		return res;
+	}
+	for(auto &el: splitList(list)){
+		auto n = std::stoul(el);
+		if(!n || n > std::numeric_limits<uint16_t>::max()){
+			throw std::invalid_argument("Invalid count of threads: " + el);
+		}
+		res.emplace_back(n);
+	}
+	return res;
+}
+
+
+const char usage[] = "ScanBytesBench [options]";
+const char programName[] = "ScanBytesBench";
+const char description[] = "ScanBytesBench scans synthetic corpora with every backend, tier and count of threads and reports the throughput.";
+
+using namespace HydrArgs;
+using namespace HydrArgs::Backend;
+
+int main(int argc, const char ** argv){
+	SArg<ArgType::string> kindsArg{'k', "kinds", "Kinds of the corpora: Random, Lines, CSV", 0, "comma-separated list", "", "Random,Lines,CSV"};
+	SArg<ArgType::string> sizesArg{'s', "sizes", "Sizes of the corpora in bytes, K, M and G suffixes are allowed", 0, "comma-separated list", "", "64M"};
+	SArg<ArgType::string> densitiesArg{'d', "densities", "Shares of the bytes matching in Random corpora", 0, "comma-separated list", "", "0.001,0.01,0.1"};
+	SArg<ArgType::string> alphabetSizesArg{'a', "alphabet-sizes", "Counts of the chars to scan for in Random corpora", 0, "comma-separated list", "", "1,4,16"};
+	SArg<ArgType::string> lengthsArg{'l', "lengths", "Distributions of the lengths of the lines and the fields in Lines and CSV corpora: Fixed, Uniform, Geometric", 0, "comma-separated list", "", "Fixed,Uniform,Geometric"};
+	SArg<ArgType::string> meanLengthArg{'L', "mean-length", "Mean length of a line or a CSV record", 0, "bytes", "", "80"};
+	SArg<ArgType::string> backendsArg{'b', "backends", "Backends to run, all means every one not hardcoding an alphabet other than the one of a corpus", 0, "comma-separated list", "", "all"};
+	SArg<ArgType::string> tiersArg{'t', "tiers", "Instruction set tiers of SIMD kernels", 0, "comma-separated list", "", "Auto"};
+	SArg<ArgType::string> threadsArg{'j', "threads", "Counts of threads, sweep means the powers of 2 up to the count of CPUs available", 0, "comma-separated list", "", "sweep"};
+	SArg<ArgType::string> attemptsArg{'n', "attempts", "Count of the timed scans of every configuration, up to 255", 0, "count", "", "10"};
+	SArg<ArgType::string> perfArg{'p', "perf", "Whether to collect cycles, branch misses and LLC misses with perf_event: on or off", 0, "on|off", "", "off"};
+	SArg<ArgType::string> jsonArg{'o', "json", "File to write the results into as JSON, - for stdout", 0, "path", "", ""};
+	SArg<ArgType::string> seedArg{'S', "seed", "Seed of the generator of the corpora, the same seed gives the same corpora", 0, "number", "", "1"};
+
+	std::vector<Arg*> dashedSpec{&kindsArg, &sizesArg, &densitiesArg, &alphabetSizesArg, &lengthsArg, &meanLengthArg, &backendsArg, &tiersArg, &threadsArg, &attemptsArg, &perfArg, &jsonArg, &seedArg};
+	std::vector<Arg*> positionalSpec{};
+
+	std::unique_ptr<IArgsParser> ap{argsParserFactory(programName, description, usage, dashedSpec, positionalSpec)};
+
+	auto status = (*ap)({argv[0], {&argv[1], static_cast<size_t>(argc - 1)}});
+
+	if(status.parsingStatus){
+		return status.parsingStatus.returnCode;
+	}
+
+	Options o;
+	try{
+		o.corpora = makeCorpora(kindsArg.value, sizesArg.value, densitiesArg.value, alphabetSizesArg.value, lengthsArg.value, std::stoull(meanLengthArg.value));
+		o.backends = parseBackends(backendsArg.value);
+		o.tiers = parseTiers(tiersArg.value);
+		o.threads = parseThreads(threadsArg.value);
+		auto attempts = std::stoul(attemptsArg.value);
+		if(!attempts || attempts > std::numeric_limits<uint8_t>::max()){
+			throw std::invalid_argument("Count of attempts must be within 1..255");
+		}
+		o.attempts = attempts;
+		o.seed = std::stoull(seedArg.value);
+	} catch(std::logic_error &e){
+		std::cerr << e.what() << std::endl;
+		ap->printHelp(std::cout, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(perfArg.value != "on" && perfArg.value != "off"){
+		std::cerr << "Invalid value of --perf: " << perfArg.value << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::unique_ptr<PerfCounters> counters;
+	if(perfArg.value == "on"){
+		counters = std::make_unique<PerfCounters>();
+		if(!counters->available()){
+			std::cerr << "perf_event is not available (see /proc/sys/kernel/perf_event_paranoid), running without the counters" << std::endl;
+			counters.reset();
+		}
+	}
+
+	std::vector<RunResult> results;
+	bool ok = true;
+	for(auto &spec: o.corpora){
+		ok &= runCorpus(o, spec, counters.get(), results);
+	}
+
+	if(!jsonArg.value.empty()){
+		if(jsonArg.value == "-"){
+			writeJSON(std::cout, results, o.seed);
+		} else {
+			std::ofstream out(jsonArg.value);
+			writeJSON(out, results, o.seed);
+			if(!out){
+				std::cerr << "Cannot write " << jsonArg.value << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	if(!ok){
+		std::cerr << "Some backends have found a wrong count of matches" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,210 @@
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "Corpus.hpp"
+
+namespace ScanBytes::Bench{
+
+	const char * corpusKindNames[] = {
+		"Unknown",
+		"Random",
+		"Lines",
+		"CSV",
+	};
+
+	std::unordered_map<std::string, CorpusKind> corpusKindsByNames{
+		{corpusKindNames[static_cast<uint8_t>(CorpusKind::Random)], CorpusKind::Random},
+		{corpusKindNames[static_cast<uint8_t>(CorpusKind::Lines)], CorpusKind::Lines},
+		{corpusKindNames[static_cast<uint8_t>(CorpusKind::CSV)], CorpusKind::CSV},
+	};
+
+	CorpusKind getCorpusKindByName(std::string &name){
+		auto it = corpusKindsByNames.find(name);
+		if(it == end(corpusKindsByNames)){
+			return CorpusKind::Unknown;
+		}
+		return it->second;
+	}
+
+	const char * lengthDistributionNames[] = {
+		"Unknown",
+		"Fixed",
+		"Uniform",
+		"Geometric",
+	};
+
+	std::unordered_map<std::string, LengthDistribution> lengthDistributionsByNames{
+		{lengthDistributionNames[static_cast<uint8_t>(LengthDistribution::Fixed)], LengthDistribution::Fixed},
+		{lengthDistributionNames[static_cast<uint8_t>(LengthDistribution::Uniform)], LengthDistribution::Uniform},
+		{lengthDistributionNames[static_cast<uint8_t>(LengthDistribution::Geometric)], LengthDistribution::Geometric},
+	};
+
+	LengthDistribution getLengthDistributionByName(std::string &name){
+		auto it = lengthDistributionsByNames.find(name);
+		if(it == end(lengthDistributionsByNames)){
+			return LengthDistribution::Unknown;
+		}
+		return it->second;
+	}
+
+	namespace {
+		const char fillers[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+		const size_t fillersCount = sizeof(fillers) - 1;
+
+		/// The alphabet of a Random corpus is a prefix of it, the most common delimiters go first
+		const char delimiters[] = "\n,\t;|: .-_/\\=&#@!?*+()[]{}<>$%^~`'\"";
+
+		const size_t fieldsPerRecord = 8;
+
+		/// splitmix64, fast enough not to dominate the generation of hundreds of megabytes
+		struct Random{
+			uint64_t state;
+
+			inline uint64_t operator()(){
+				uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+				return z ^ (z >> 31);
+			}
+
+			/// In (0, 1]
+			inline double uniform(){
+				return ((*this)() >> 11) * (1. / (uint64_t(1) << 53)) + (1. / (uint64_t(1) << 53));
+			}
+
+			inline uint8_t filler(){
+				return fillers[(*this)() % fillersCount];
+			}
+
+			size_t length(LengthDistribution d, size_t mean){
+				mean = std::max<size_t>(mean, 1);
+				switch(d){
+					case LengthDistribution::Fixed:
+						return mean;
+					case LengthDistribution::Uniform:
+						return 1 + (*this)() % (2 * mean - 1);
+					case LengthDistribution::Geometric:
+						if(mean == 1){
+							return 1;
+						}
+						return 1 + static_cast<size_t>(std::log(uniform()) / std::log(1. - 1. / mean));
+					default:
+						throw std::logic_error("Unknown length distribution");
+				}
+			}
+		};
+
+		void generateRandom(const CorpusSpec &spec, Random &rnd, Corpus &c){
+			if(spec.alphabetSize < 1 || spec.alphabetSize > maxAlphabetSize){
+				throw std::logic_error("Alphabet size must be within 1.." + std::to_string(maxAlphabetSize));
+			}
+			c.alphabet.assign(delimiters, delimiters + spec.alphabetSize);
+			uint64_t threshold = static_cast<uint64_t>(std::clamp(spec.density, 0., 1.) * 4294967296.);
+			c.data.resize(spec.size);
+			for(auto &b: c.data){
+				uint64_t r = rnd();
+				if((r & 0xFFFFFFFF) < threshold){
+					b = c.alphabet[(r >> 32) % spec.alphabetSize];
+					++c.matches;
+				} else {
+					b = fillers[(r >> 32) % fillersCount];
+				}
+			}
+			c.unquotedMatches = c.matches;
+		}
+
+		void generateLines(const CorpusSpec &spec, Random &rnd, Corpus &c){
+			c.alphabet = {'\n'};
+			c.data.reserve(spec.size + spec.meanLength);
+			while(c.data.size() < spec.size){
+				auto len = rnd.length(spec.lengths, spec.meanLength);
+				for(size_t i = 1; i < len; ++i){
+					c.data.emplace_back(rnd.filler());
+				}
+				c.data.emplace_back('\n');
+				++c.matches;
+			}
+			c.unquotedMatches = c.matches;
+		}
+
+		void generateQuotedField(size_t len, Random &rnd, Corpus &c){
+			c.data.emplace_back('"');
+			for(size_t i = 0; i < len; ++i){
+				auto r = rnd();
+				switch(r % 16){
+					case 0:
+						c.data.emplace_back(',');
+						++c.matches;
+					break;
+					case 1:
+						c.data.emplace_back('\n');
+						++c.matches;
+					break;
+					case 2:
+						c.data.emplace_back('"');
+						c.data.emplace_back('"');
+					break;
+					default:
+						c.data.emplace_back(fillers[(r >> 8) % fillersCount]);
+				}
+			}
+			c.data.emplace_back('"');
+		}
+
+		void generateCSV(const CorpusSpec &spec, Random &rnd, Corpus &c){
+			c.alphabet = {',', '\n'};
+			c.data.reserve(spec.size + spec.size / 8 + 2 * spec.meanLength);
+			auto meanFieldLength = std::max<size_t>(spec.meanLength / fieldsPerRecord, 1);
+			while(c.data.size() < spec.size){
+				for(size_t f = 0; f < fieldsPerRecord; ++f){
+					auto len = rnd.length(spec.lengths, meanFieldLength);
+					if(rnd() % 4){
+						for(size_t i = 0; i < len; ++i){
+							c.data.emplace_back(rnd.filler());
+						}
+					} else {
+						generateQuotedField(len, rnd, c);
+					}
+					c.data.emplace_back(f + 1 < fieldsPerRecord ? ',' : '\n');
+					++c.matches;
+					++c.unquotedMatches;
+				}
+			}
+		}
+	};
+
+	const size_t maxAlphabetSize = sizeof(delimiters) - 1;
+
+	std::string CorpusSpec::name() const{
+		std::ostringstream s;
+		s << corpusKindNames[static_cast<uint8_t>(kind)] << "-" << size;
+		if(kind == CorpusKind::Random){
+			s << "-d" << density << "-a" << static_cast<unsigned>(alphabetSize);
+		} else {
+			s << "-" << lengthDistributionNames[static_cast<uint8_t>(lengths)] << meanLength;
+		}
+		return s.str();
+	}
+
+	Corpus generateCorpus(const CorpusSpec &spec, uint64_t seed){
+		Random rnd{seed};
+		Corpus c;
+		switch(spec.kind){
+			case CorpusKind::Random:
+				generateRandom(spec, rnd, c);
+			break;
+			case CorpusKind::Lines:
+				generateLines(spec, rnd, c);
+			break;
+			case CorpusKind::CSV:
+				generateCSV(spec, rnd, c);
+			break;
+			default:
+				throw std::logic_error("Unknown corpus kind");
+		}
+		return c;
+	}
+};
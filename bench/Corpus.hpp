@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ScanBytes::Bench{
+
+	enum class CorpusKind: uint8_t{
+		Unknown = 0,
+		Random = 1, // filler bytes with the chars of the alphabet scattered with a certain density
+		Lines = 2, // records delimited with \n
+		CSV = 3, // records of 8 fields, a quarter of the fields are quoted and contain commas, line breaks and escaped quotes
+	};
+
+	extern const char * corpusKindNames[];
+	CorpusKind getCorpusKindByName(std::string &name);
+
+	/// Of the lengths of the lines and the fields
+	enum class LengthDistribution: uint8_t{
+		Unknown = 0,
+		Fixed = 1,
+		Uniform = 2, // 1 .. 2 * mean - 1
+		Geometric = 3, // many short ones and a long tail
+	};
+
+	extern const char * lengthDistributionNames[];
+	LengthDistribution getLengthDistributionByName(std::string &name);
+
+	struct CorpusSpec{
+		CorpusKind kind;
+		size_t size; // the generated data may be a bit longer, the last record is not cut
+		double density = 0.01; // Random only: the share of the bytes which are matches
+		uint8_t alphabetSize = 1; // Random only
+		LengthDistribution lengths = LengthDistribution::Fixed; // Lines and CSV only
+		size_t meanLength = 80; // Lines and CSV only, of the lines and of the records respectively
+
+		std::string name() const;
+	};
+
+	struct Corpus{
+		std::vector<uint8_t> data;
+		std::vector<uint8_t> alphabet;
+		uint64_t matches = 0; // all the occurrences of the alphabet chars
+		uint64_t unquotedMatches = 0; // the ones outside quoted fields, that is what CSVQuoted backend finds
+	};
+
+	/// The largest `alphabetSize` supported, none of the chars of the alphabets is used as a filler
+	extern const size_t maxAlphabetSize;
+
+	/// Deterministic for a certain seed, so the runs of different builds scan the same data
+	Corpus generateCorpus(const CorpusSpec &spec, uint64_t seed);
+};
@@ -0,0 +1,78 @@
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "PerfCounters.hpp"
+
+namespace ScanBytes::Bench{
+
+	const char * perfCounterNames[] = {
+		"cycles",
+		"branchMisses",
+		"llcMisses",
+	};
+
+	namespace {
+		const uint64_t perfEventConfigs[] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_BRANCH_MISSES,
+			PERF_COUNT_HW_CACHE_MISSES, // usually mapped to the misses of the last level cache
+		};
+
+		int openCounter(uint64_t config){
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = config;
+			attr.disabled = 1;
+			attr.inherit = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		}
+	};
+
+	PerfCounters::PerfCounters(){
+		for(uint8_t i = 0; i < static_cast<uint8_t>(PerfCounter::Count); ++i){
+			fds[i] = openCounter(perfEventConfigs[i]);
+		}
+	}
+
+	PerfCounters::~PerfCounters(){
+		for(auto fd: fds){
+			if(fd >= 0){
+				close(fd);
+			}
+		}
+	}
+
+	bool PerfCounters::available() const{
+		return fds[static_cast<uint8_t>(PerfCounter::Cycles)] >= 0;
+	}
+
+	void PerfCounters::start(){
+		for(auto fd: fds){
+			if(fd >= 0){
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+	}
+
+	void PerfCounters::stop(uint64_t (&values)[static_cast<uint8_t>(PerfCounter::Count)]){
+		for(uint8_t i = 0; i < static_cast<uint8_t>(PerfCounter::Count); ++i){
+			values[i] = 0;
+			if(fds[i] < 0){
+				continue;
+			}
+			ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+			if(read(fds[i], &values[i], sizeof(values[i])) != sizeof(values[i])){
+				values[i] = 0;
+			}
+		}
+	}
+};
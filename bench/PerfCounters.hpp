@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ScanBytes::Bench{
+
+	enum class PerfCounter: uint8_t{
+		Cycles = 0,
+		BranchMisses = 1,
+		LLCMisses = 2,
+		Count = 3,
+	};
+
+	extern const char * perfCounterNames[];
+
+	/// Hardware counters of this thread and of the threads it starts while they are enabled, so a thread pool has to be created after `start`
+	struct PerfCounters{
+		int fds[static_cast<uint8_t>(PerfCounter::Count)];
+
+		/// Check `available()`: perf_event_open is often forbidden in containers and VMs
+		PerfCounters();
+		~PerfCounters();
+
+		PerfCounters(const PerfCounters &) = delete;
+		PerfCounters &operator=(const PerfCounters &) = delete;
+
+		bool available() const;
+
+		void start();
+
+		/// The values since `start`, the counters a CPU lacks are 0
+		void stop(uint64_t (&values)[static_cast<uint8_t>(PerfCounter::Count)]);
+	};
+};
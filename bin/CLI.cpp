@@ -1,26 +1,319 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string_view>
 #include <set>
+#include <mutex>
+#include <memory>
+#include <system_error>
 
-#include <mio/mmap.hpp>
 #include <ScanBytes/ScanBytes.hpp>
+#include <ScanBytes/IndexFormat.hpp>
+#include <ScanBytes/IndexReader.hpp>
+#include <ScanBytes/Stream.hpp>
+#include <ScanBytes/Scanner.hpp>
+#include <ScanBytes/Autotune.hpp>
+#include <ScanBytes/IOEngine.hpp>
 
 #include <HydrArgs/HydrArgs.hpp>
 
 #include <numeric>
+#include <limits>
+#include <cmath>
+#include <cctype>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 typedef int (CmdFuncPtr) (ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m);
 
+ScanBytes::IndexFormat indexFormat = ScanBytes::IndexFormat::Raw;
+std::string indexPath;
+std::string recordsSpec;
+std::string fieldSpec;
+std::string outputPath;
+size_t countBlockSize;
+uint32_t checkpointSize;
+ScanBytes::ScanStats *scanStats = nullptr;  // set by --stats
+
+/// Into --output or stdout. Regular files are written by all the threads in parallel, anything else through a stream.
+template<typename StorageT>
+void writeIndexToOutput(StorageT &res, ScanBytes::IndexHeader &h){
+	if(outputPath.empty()){
+		std::cout.flush();
+		if(ScanBytes::isParallelWritable(STDOUT_FILENO)){
+			ScanBytes::writeIndex(res, STDOUT_FILENO, h);
+		} else {
+			ScanBytes::writeIndex(res, std::cout, h);
+		}
+		return;
+	}
+
+	int fd = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if(fd < 0){
+		throw std::system_error(errno, std::generic_category(), "Cannot open " + outputPath);
+	}
+	if(ScanBytes::isParallelWritable(fd)){
+		ScanBytes::writeIndex(res, fd, h);
+		close(fd);
+		return;
+	}
+	close(fd);
+	std::ofstream out(outputPath, std::ios::binary);
+	ScanBytes::writeIndex(res, out, h);
+}
+
+/// Sequences separated with commas. `\,`, `\\`, `\n`, `\r`, `\t` and `\xHH` escapes allow any byte within them.
+std::vector<std::string> parseSequences(const std::string &spec){
+	std::vector<std::string> res(1);
+	for(size_t i = 0; i < spec.size(); ++i){
+		char c = spec[i];
+		if(c == ','){
+			res.emplace_back();
+			continue;
+		}
+		if(c == '\\'){
+			if(++i == spec.size()){
+				throw std::invalid_argument(spec);
+			}
+			switch(spec[i]){
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case ',': case '\\': c = spec[i]; break;
+				case 'x':
+					if(i + 2 >= spec.size() || !isxdigit(spec[i + 1]) || !isxdigit(spec[i + 2])){
+						throw std::invalid_argument(spec);
+					}
+					c = static_cast<char>(std::stoul(spec.substr(i + 1, 2), nullptr, 16));
+					i += 2;
+				break;
+				default:
+					throw std::invalid_argument(spec);
+			}
+		}
+		res.back() += c;
+	}
+	return res;
+}
+
+/// Fields indices take the last char of the alphabet as the delimiter of records and the rest as the delimiters of fields
+ScanBytes::NBST scanForIndex(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m, ScanBytes::ScanState &state){
+	if(indexFormat == ScanBytes::IndexFormat::Fields){
+		return ScanBytes::scanTagged(m, charsToScanFor, charsToScanFor.back(), b, state);
+	}
+	return ScanBytes::scan(m, charsToScanFor, b, state);
+}
+
+template<typename StorageT>
+int writeIndexOf(StorageT &res, ScanBytes::ScannableT &m, ScanBytes::ScanState &state){
+	ScanBytes::IndexHeader h{indexFormat};
+	h.setData(m);
+	if(state.inQuote){
+		h.flags |= ScanBytes::endsInQuote;
+	}
+	writeIndexToOutput(res, h);
+	return EXIT_SUCCESS;
+}
+
+/// Only the counts of the matches are needed, so it is a counting pass rather than a scan
+int sparseIndex(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
+	std::ofstream outputFile;
+	if(!outputPath.empty()){
+		outputFile.open(outputPath, std::ios::binary | std::ios::trunc);
+	}
+	std::ostream &out = outputPath.empty() ? std::cout : outputFile;
+	try{
+		ScanBytes::writeSparseIndex(m, charsToScanFor, b, out, checkpointSize);
+	} catch(std::logic_error &e){
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	out.flush();
+	return EXIT_SUCCESS;
+}
+
+/// The offsets of data under 4 GiB are kept as uint32_t, Flat indices store them so too
 int index(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
-	auto res = ScanBytes::scan(m, charsToScanFor, b);
-	ScanBytes::sortIndices(res);
-	ScanBytes::dumpIndices(res);
+	if(indexFormat == ScanBytes::IndexFormat::Sparse){
+		return sparseIndex(b, charsToScanFor, m);
+	}
+	ScanBytes::ScanState state{.stats = scanStats};
+	if(indexFormat != ScanBytes::IndexFormat::Fields && ScanBytes::getOffsetWidth(m.size()) == sizeof(uint32_t)){
+		auto res = ScanBytes::scanAs<uint32_t>(m, charsToScanFor, b, state);
+		return writeIndexOf(res, m, state);
+	}
+	auto res = scanForIndex(b, charsToScanFor, m, state);
+	return writeIndexOf(res, m, state);
+}
+
+/// Every file listed in `listPath` (one per line, - for stdin) gets its index written into `<file>.idx`
+int indexBatch(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, const std::string &listPath){
+	std::vector<std::string> paths;
+	{
+		std::ifstream listFile;
+		std::istream &list = listPath == "-" ? std::cin : (listFile.open(listPath), listFile);
+		if(!list){
+			std::cerr << "Cannot open " << listPath << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::string line;
+		while(std::getline(list, line)){
+			if(!line.empty()){
+				paths.emplace_back(line);
+			}
+		}
+	}
+
+	std::mutex cerrLock;
+	bool failed = false;
+	ScanBytes::Scanner scanner{charsToScanFor, b};
+	auto errors = scanner.scanFiles(paths, [&](size_t i, ScanBytes::ScannableT data, ScanBytes::NBST &res, ScanBytes::ScanState &state){
+		ScanBytes::IndexHeader h{indexFormat};
+		h.setData(data);
+		if(state.inQuote){
+			h.flags |= ScanBytes::endsInQuote;
+		}
+		std::string indexPath = paths[i] + ".idx";
+		std::ofstream out(indexPath, std::ios::binary | std::ios::trunc);
+		ScanBytes::writeIndex(res, out, h);
+		out.close();
+		if(!out){
+			std::lock_guard<std::mutex> guard(cerrLock);
+			std::cerr << "Cannot write " << indexPath << std::endl;
+			failed = true;
+		}
+	});
+	for(auto &e: errors){
+		std::cerr << e.message << std::endl;
+	}
+	return failed || !errors.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int update(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
+	try{
+		ScanBytes::updateIndex(indexPath, m, charsToScanFor, b);
+	} catch(std::runtime_error &e){
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	} catch(std::logic_error &e){
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/// The tail of a regular file read as a stream, so that the index can be updated when the file is appended to
+void fingerprintTail(ScanBytes::IndexHeader &h, const std::string &path, uint64_t dataSize){
+	std::vector<uint8_t> tail(std::min<uint64_t>(dataSize, ScanBytes::maxTailSize));
+	std::ifstream f(path, std::ios::binary);
+	f.seekg(dataSize - tail.size());
+	if(f.read(reinterpret_cast<char *>(tail.data()), tail.size())){
+		h.setTail(ScanBytes::ScannableT{tail}, dataSize);
+	}
+}
 
+/// For pipes and stdin, which cannot be mapped, and for the files read with Read or Direct I/O engine (then `path` is set). Raw offsets are written as soon as a buffer is scanned, other formats need the count upfront, so they are written at the end.
+int streamIndex(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, int fd, const std::string &path){
+	ScanBytes::NBST all;
+	std::ofstream outputFile;
+	if(!outputPath.empty() && indexFormat == ScanBytes::IndexFormat::Raw){
+		outputFile.open(outputPath, std::ios::binary | std::ios::trunc);
+	}
+	std::ostream &out = outputPath.empty() ? std::cout : outputFile;
+
+	ScanBytes::ScanState state{.stats = scanStats};
+	auto dataSize = ScanBytes::scanStream(fd, charsToScanFor, b, [&](ScanBytes::NBST &res){
+		if(indexFormat == ScanBytes::IndexFormat::Raw){
+			ScanBytes::writeIndex(res, out, indexFormat, 0);
+		} else {
+			for(auto &chunk: res){
+				all.emplace_back(std::move(chunk));
+			}
+		}
+	}, state);
+	if(indexFormat != ScanBytes::IndexFormat::Raw){
+		ScanBytes::IndexHeader h{indexFormat, 0, dataSize};
+		if(!path.empty()){
+			fingerprintTail(h, path, dataSize);
+		}
+		if(state.inQuote){
+			h.flags |= ScanBytes::endsInQuote;
+		}
+		writeIndexToOutput(all, h);
+	}
+	out.flush();
+	return EXIT_SUCCESS;
+}
+
+int count(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
+	ScanBytes::ScanState state{.stats = scanStats};
+	std::cout << ScanBytes::count(m, charsToScanFor, b, state) << std::endl;
+	return EXIT_SUCCESS;
+}
+
+int countStream(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, int fd){
+	std::cout << ScanBytes::countStream(fd, charsToScanFor, b, ScanBytes::defaultStreamBufferSize, ScanBytes::defaultStreamBuffersCount, scanStats) << std::endl;
 	return EXIT_SUCCESS;
 }
 
+/// A count per line, the N-th one is for bytes [N * countBlockSize, (N + 1) * countBlockSize)
+int countPerBlock(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
+	for(auto c: ScanBytes::countPerBlock(m, charsToScanFor, b, countBlockSize)){
+		std::cout << c << '\n';
+	}
+	std::cout.flush();
+	return EXIT_SUCCESS;
+}
+
+/// A line per char of the alphabet: its code and its count
+int histogram(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
+	auto counts = ScanBytes::countEachChar(m, charsToScanFor);
+	for(size_t i = 0; i < counts.size(); ++i){
+		std::cout << static_cast<unsigned>(charsToScanFor[i]) << '\t' << counts[i] << '\n';
+	}
+	std::cout.flush();
+	return EXIT_SUCCESS;
+}
+
+void printThreadStats(std::ostream &out, const ScanBytes::ThreadStats &t){
+	out << t.bytes << " bytes, " << t.matches << " matches, " << t.tasks << " tasks (" << t.steals << " steals), busy " << t.busyNs / 1e6 << " ms, " << t.arenas << " arenas, " << t.blocks << " blocks, lock wait " << t.lockWaitNs / 1e3 << " us, " << t.minorFaults << " minor / " << t.majorFaults << " major page faults";
+}
+
+void writeThreadStatsJSON(std::ostream &out, const ScanBytes::ThreadStats &t){
+	out << "{\"bytes\": " << t.bytes << ", \"matches\": " << t.matches << ", \"tasks\": " << t.tasks << ", \"steals\": " << t.steals << ", \"busyNs\": " << t.busyNs;
+	out << ", \"arenas\": " << t.arenas << ", \"blocks\": " << t.blocks << ", \"lockWaitNs\": " << t.lockWaitNs << ", \"minorFaults\": " << t.minorFaults << ", \"majorFaults\": " << t.majorFaults << "}";
+}
+
+/// Into stderr, stdout may carry the index
+void printStats(const ScanBytes::ScanStats &s, const std::string &format){
+	auto &out = std::cerr;
+	if(format == "json"){
+		out << "{\"scans\": " << s.scans << ", \"bytes\": " << s.bytes << ", \"matches\": " << s.matches << ", \"wallNs\": " << s.wallNs << ", \"bytesPerSecond\": " << s.throughput() << ", \"total\": ";
+		writeThreadStatsJSON(out, s.total());
+		out << ", \"threads\": [";
+		for(size_t i = 0; i < s.threads.size(); ++i){
+			out << (i ? ", " : "");
+			writeThreadStatsJSON(out, s.threads[i]);
+		}
+		out << "]}" << std::endl;
+		return;
+	}
+	out << s.bytes << " bytes in " << s.scans << " scans, " << s.matches << " matches, " << s.wallNs / 1e6 << " ms, " << s.throughput() / 1e9 << " GB/s" << std::endl;
+	for(size_t i = 0; i < s.threads.size(); ++i){
+		out << "thread " << i << ": ";
+		printThreadStats(out, s.threads[i]);
+		out << std::endl;
+	}
+	out << "total: ";
+	printThreadStats(out, s.total());
+	out << std::endl;
+}
+
 int benchmark(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
 	if(b == ScanBytes::Backend::Auto){
-		b = ScanBytes::getGenericBackend();
+		b = ScanBytes::detectProperBackend(charsToScanFor);
 	}
 
 	auto benchmarkAttempts = 10;
@@ -42,7 +335,184 @@ int benchmark(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBy
 }
 
 
-const char usage[] = "ScanBytes <i/s|v|b> <file>";
+/// Measures the backends on the beginning of the file and caches the fastest one for Auto
+int tune(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
+	try{
+		auto d = ScanBytes::autotune(charsToScanFor, m);
+		std::cout << ScanBytes::backendNames[static_cast<uint8_t>(d.backend)] << '\t' << d.threadsCount << " threads\t" << d.bytesPerSecond / 1e9 << " GB/s" << std::endl;
+		std::cerr << "Stored into " << ScanBytes::getTuningCachePath().string() << std::endl;
+	} catch(std::runtime_error &e){
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Reports why the index cannot be read and returns nullptr then
+std::unique_ptr<ScanBytes::IndexReader> openIndex(uint64_t dataSize){
+	try{
+		return std::make_unique<ScanBytes::IndexReader>(indexPath, dataSize);
+	} catch(std::runtime_error &e){
+		std::cerr << e.what() << std::endl;
+		return nullptr;
+	}
+}
+
+/// Rebuilds the tables and compares them with the ones of the index
+int verifyFields(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m, ScanBytes::IndexReader &r){
+	ScanBytes::ScanState state;
+	auto res = scanForIndex(b, charsToScanFor, m, state);
+	ScanBytes::IndexHeader h{indexFormat, 0, r.dataSize()};
+	std::ostringstream expected;
+	ScanBytes::writeIndex(res, expected, h);
+	auto e = expected.view().substr(sizeof(ScanBytes::IndexHeader));
+	std::string_view actual{reinterpret_cast<const char *>(r.map) + sizeof(ScanBytes::IndexHeader), r.mapSize - sizeof(ScanBytes::IndexHeader)};
+	if(r.dataSize() != m.size() || e != actual){
+		std::cerr << "The index doesn't match the data" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+int verify(ScanBytes::Backend b, std::vector<uint8_t> &charsToScanFor, ScanBytes::ScannableT &m){
+	auto reader = openIndex(m.size());
+	if(!reader){
+		return EXIT_FAILURE;
+	}
+	auto &r = *reader;
+	if(r.header.format == ScanBytes::IndexFormat::Fields){
+		indexFormat = ScanBytes::IndexFormat::Fields;
+		return verifyFields(b, charsToScanFor, m, r);
+	}
+	if(r.header.format == ScanBytes::IndexFormat::Sparse){
+		r.attachData(m);  // every block is rescanned once and its matches are checked against its checkpoints
+	}
+
+	bool isDelimiter[256]{};
+	if(b == ScanBytes::Backend::Sequences){
+		for(auto &s: ScanBytes::decodeSequences(charsToScanFor)){
+			isDelimiter[static_cast<uint8_t>(s.back())] = true;  // the offsets are the ones of the last bytes
+		}
+	} else {
+		for(auto c: charsToScanFor){
+			isDelimiter[c] = true;
+		}
+	}
+
+	uint64_t prev = 0;
+	try{
+		for(uint64_t i = 0; i < r.size(); ++i){
+			auto offset = r[i];
+			if(offset >= m.size() || (i && offset <= prev) || !isDelimiter[m[offset]]){
+				std::cerr << "Invalid offset #" << i << ": " << offset << std::endl;
+				return EXIT_FAILURE;
+			}
+			prev = offset;
+		}
+	} catch(std::runtime_error &e){
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	uint64_t expectedCount = 0;
+	for(auto &chunk: ScanBytes::scan(m, charsToScanFor, b)){
+		expectedCount += chunk->vec.size();
+	}
+	if(expectedCount != r.size()){
+		std::cerr << "The index contains " << r.size() << " offsets, but there are " << expectedCount << " delimiters in the file" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Field `fieldSpec` of every record of the range, one per line
+int getFields(ScanBytes::IndexReader &r, int dataFd, uint64_t first, uint64_t last){
+	uint64_t n;
+	try{
+		size_t pos;
+		n = std::stoull(fieldSpec, &pos);
+		if(pos < fieldSpec.size()){
+			throw std::invalid_argument(fieldSpec);
+		}
+	} catch(std::logic_error &e){
+		std::cerr << "Invalid field index: " << fieldSpec << std::endl;
+		close(dataFd);
+		return EXIT_FAILURE;
+	}
+
+	try{
+		for(uint64_t i = first; i <= last; ++i){
+			auto f = r.field(i, n);
+			ScanBytes::sendRange(dataFd, f.offset, f.size, STDOUT_FILENO);
+			if(write(STDOUT_FILENO, "\n", 1) != 1){
+				throw std::system_error(errno, std::generic_category(), "Cannot write");
+			}
+		}
+	} catch(std::logic_error &e){
+		std::cerr << e.what() << std::endl;
+		close(dataFd);
+		return EXIT_FAILURE;
+	}
+	close(dataFd);
+	return EXIT_SUCCESS;
+}
+
+/// `recordsSpec` is either `N` or `N:M`, both inclusive
+int getRecords(const std::string &dataPath){
+	uint64_t first, last;
+	try{
+		size_t pos;
+		first = last = std::stoull(recordsSpec, &pos);
+		if(pos < recordsSpec.size()){
+			if(recordsSpec[pos] != ':'){
+				throw std::invalid_argument(recordsSpec);
+			}
+			last = std::stoull(recordsSpec.substr(pos + 1));
+		}
+	} catch(std::logic_error &e){
+		std::cerr << "Invalid records range: " << recordsSpec << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	int dataFd = open(dataPath.c_str(), O_RDONLY | O_CLOEXEC);
+	if(dataFd < 0){
+		std::cerr << "Cannot open " << dataPath << std::endl;
+		return EXIT_FAILURE;
+	}
+	struct stat st;
+	fstat(dataFd, &st);
+
+	auto reader = openIndex(st.st_size);
+	if(!reader){
+		close(dataFd);
+		return EXIT_FAILURE;
+	}
+	auto &r = *reader;
+	if(!fieldSpec.empty()){
+		return getFields(r, dataFd, first, last);
+	}
+	if(r.header.format == ScanBytes::IndexFormat::Sparse){
+		r.attachData(dataFd);
+	}
+	ScanBytes::Record range;
+	try{
+		range = r.records(first, last);
+	} catch(std::out_of_range &e){
+		std::cerr << e.what() << ", there are " << r.recordsCount() << " records" << std::endl;
+		close(dataFd);
+		return EXIT_FAILURE;
+	} catch(std::runtime_error &e){
+		std::cerr << e.what() << std::endl;
+		close(dataFd);
+		return EXIT_FAILURE;
+	}
+	ScanBytes::sendRange(dataFd, range.offset, range.size, STDOUT_FILENO);
+	close(dataFd);
+	return EXIT_SUCCESS;
+}
+
+
+const char usage[] = "ScanBytes <s|c|cb|h|u|v|g|l|bs|tune> <file|->";
 const char programName[] = "ScanBytes";
 const char description[] = "ScanBytes allows you to scan a file for occurences of bytes and get a file with offsets.";
 
@@ -50,13 +520,26 @@ using namespace HydrArgs;
 using namespace HydrArgs::Backend;
 
 int main(int argc, const char ** argv){
-	SArg<ArgType::string> commandArg{'c', "command", "Command to run, can be s (scan), v (verify) or bs (benchmark scan)", 1, "i|v|b", "", ""};
-	SArg<ArgType::string> fileArg{'f', "file", "Scanned file", 1, "path to file", "", ""};
+	SArg<ArgType::string> commandArg{'c', "command", "Command to run, can be s (scan), c (count the matches), cb (count the matches within every --block-size bytes), h (count every char of the alphabet), u (update an index of a file that has been appended to), v (verify an index), g (get records using an index), l (index every file of a list, one path per line, into <file>.idx), bs (benchmark scan) or tune (find the fastest backend for the alphabet on the file, - for synthetic data, and use it for Auto from then on)", 1, "s|c|cb|h|u|v|g|l|bs|tune", "", ""};
+	SArg<ArgType::string> fileArg{'f', "file", "Scanned file, - for stdin. Stdin and pipes are scanned as a stream", 1, "path to file", "", ""};
 
 	SArg<ArgType::string> backendArg{'b', "backend", "The scanner implementation", 0, "Backend name", "", "Auto"};
 	SArg<ArgType::string> alphabetArg{'a', "alphabet", "Chars to use as separators", 0, "alphabet", "", "\n"};
+	SArg<ArgType::string> sequencesArg{'m', "sequences", "Multi-byte separators instead of --alphabet, found with Sequences backend: 1-16 bytes each, separated with commas, escapes: \\, \\\\ \\n \\r \\t \\xHH, e.g. '\\r\\n,||'. The offsets are the ones of their last bytes", 0, "sequences", "", ""};
+	SArg<ArgType::string> tierArg{'t', "tier", "Instruction set tier of SIMD kernels: Scalar, SSE2, SSSE3, AVX2, AVX512BW", 0, "Tier name", "", "Auto"};
+	SArg<ArgType::string> formatArg{'F', "format", "Format of the index: Raw (just uint64_t offsets), Flat (with a header), Packed (bit-packed deltas), Fields (records and fields tables, the last char of the alphabet delimits records) or Sparse (counts of the matches before every --checkpoint-size bytes, the records are found by rescanning a block)", 0, "Format name", "", "Raw"};
+	SArg<ArgType::string> indexArg{'i', "index", "Index file for u, v and g commands", 0, "path to index", "", ""};
+	SArg<ArgType::string> recordsArg{'r', "records", "Records to get with g command: N or N:M (inclusive)", 0, "range", "", "0"};
+	SArg<ArgType::string> fieldArg{'d', "field", "Field of the records to get with g command instead of the whole records, needs an index in Fields format", 0, "index", "", ""};
+	SArg<ArgType::string> outputArg{'o', "output", "File to write the index of s command into instead of stdout", 0, "path to index", "", ""};
+	SArg<ArgType::string> threadsArg{'j', "threads", "Count of threads, 0 means a thread per CPU available", 0, "count", "", "0"};
+	SArg<ArgType::string> blockSizeArg{'B', "block-size", "Size of the blocks for cb command, in bytes", 0, "size", "", "1048576"};
+	SArg<ArgType::string> checkpointSizeArg{'k', "checkpoint-size", "Size of the blocks of a Sparse index, in bytes: the larger, the smaller the index, but the more data g command rescans to find a record", 0, "size", "", "65536"};
+	SArg<ArgType::string> statsArg{'S', "stats", "Print the stats of the scans of s and c commands into stderr: text or json. Needs the library built with SCANBYTES_STATS", 0, "text|json", "", ""};
+	SArg<ArgType::string> placementArg{'P', "placement", "Where the threads run: OS (anywhere), Nodes (pinned to NUMA nodes, each one scans a contiguous part of the file into its own memory) or Cores (pinned to a CPU each, grouped by nodes)", 0, "placement name", "", "OS"};
+	SArg<ArgType::string> ioArg{'I', "io", "How a regular file is read: Auto, Mmap, Populate, Readahead (mapped), Read or Direct (read into buffers while the previous ones are scanned, s and c commands only; Direct bypasses the page cache)", 0, "I/O engine name", "", "Auto"};
 
-	std::vector<Arg*> dashedSpec{&backendArg, &alphabetArg};
+	std::vector<Arg*> dashedSpec{&backendArg, &alphabetArg, &sequencesArg, &tierArg, &formatArg, &indexArg, &recordsArg, &fieldArg, &outputArg, &threadsArg, &blockSizeArg, &checkpointSizeArg, &statsArg, &ioArg, &placementArg};
 
 	std::vector<Arg*> positionalSpec{&commandArg, &fileArg};
 
@@ -69,14 +552,36 @@ int main(int argc, const char ** argv){
 	}
 
 	CmdFuncPtr *cmdPtr = nullptr;
+	indexPath = indexArg.value;
+	recordsSpec = recordsArg.value;
+	fieldSpec = fieldArg.value;
+	outputPath = outputArg.value;
+
+	if((commandArg.value == "u" || commandArg.value == "v" || commandArg.value == "g") && indexPath.empty()){
+		std::cerr << "Command " << commandArg.value << " needs --index" << std::endl;
+		return EXIT_FAILURE;
+	}
 
 	if(commandArg.value == "s"){
 		cmdPtr = index;
+	} else if (commandArg.value == "c") {
+		cmdPtr = count;
+	} else if (commandArg.value == "cb") {
+		cmdPtr = countPerBlock;
+	} else if (commandArg.value == "h") {
+		cmdPtr = histogram;
 	} else if (commandArg.value == "bs") {
 		cmdPtr = benchmark;
+	} else if (commandArg.value == "tune") {
+		cmdPtr = tune;
+	} else if (commandArg.value == "u") {
+		cmdPtr = update;
 	} else if (commandArg.value == "v") {
-		std::cerr << "v not yet implemented" << std::endl;
-		return EXIT_FAILURE;
+		cmdPtr = verify;
+	} else if (commandArg.value == "l") {
+		// handled when the alphabet is ready
+	} else if (commandArg.value == "g") {
+		return getRecords(fileArg.value);  // doesn't need the whole file mapped
 	} else{
 		std::cerr << "Invalid command " << commandArg.value << std::endl;
 		ap->printHelp(std::cout, argv[0]);
@@ -90,6 +595,77 @@ int main(int argc, const char ** argv){
 		return EXIT_FAILURE;
 	}
 
+	indexFormat = ScanBytes::getIndexFormatByName(formatArg.value);
+	if(indexFormat == ScanBytes::IndexFormat::Unknown){
+		std::cerr << "Invalid index format name: " << formatArg.value << std::endl;
+		ap->printHelp(std::cout, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	auto ioEngine = ScanBytes::getIOEngineByName(ioArg.value);
+	if(ioEngine == ScanBytes::IOEngine::Unknown){
+		std::cerr << "Invalid I/O engine name: " << ioArg.value << std::endl;
+		ap->printHelp(std::cout, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	auto placement = ScanBytes::getThreadPlacementByName(placementArg.value);
+	if(placement == ScanBytes::ThreadPlacement::Unknown){
+		std::cerr << "Invalid thread placement name: " << placementArg.value << std::endl;
+		ap->printHelp(std::cout, argv[0]);
+		return EXIT_FAILURE;
+	}
+	ScanBytes::setThreadPlacement(placement);
+
+	auto tier = ScanBytes::getTierByName(tierArg.value);
+	if(tier == ScanBytes::Tier::Unknown){
+		std::cerr << "Invalid tier name: " << tierArg.value << std::endl;
+		ap->printHelp(std::cout, argv[0]);
+		return EXIT_FAILURE;
+	}
+	if(tier != ScanBytes::Tier::Auto){
+		if(!ScanBytes::isTierSupported(tier)){
+			std::cerr << "The CPU doesn't support tier " << tierArg.value << std::endl;
+			return EXIT_FAILURE;
+		}
+		ScanBytes::forceTier(tier);
+	}
+
+	try{
+		size_t pos;
+		auto threadsCount = std::stoul(threadsArg.value, &pos);
+		if(pos < threadsArg.value.size() || threadsCount > std::numeric_limits<uint16_t>::max()){
+			throw std::invalid_argument(threadsArg.value);
+		}
+		ScanBytes::setThreadsCount(threadsCount);
+	} catch(std::logic_error &e){
+		std::cerr << "Invalid count of threads: " << threadsArg.value << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try{
+		size_t pos;
+		countBlockSize = std::stoull(blockSizeArg.value, &pos);
+		if(pos < blockSizeArg.value.size() || !countBlockSize){
+			throw std::invalid_argument(blockSizeArg.value);
+		}
+	} catch(std::logic_error &e){
+		std::cerr << "Invalid block size: " << blockSizeArg.value << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try{
+		size_t pos;
+		auto size = std::stoull(checkpointSizeArg.value, &pos);
+		if(pos < checkpointSizeArg.value.size() || !size || size > std::numeric_limits<uint32_t>::max()){
+			throw std::invalid_argument(checkpointSizeArg.value);
+		}
+		checkpointSize = size;
+	} catch(std::logic_error &e){
+		std::cerr << "Invalid checkpoint size: " << checkpointSizeArg.value << std::endl;
+		return EXIT_FAILURE;
+	}
+
 	std::vector<uint8_t> charsToScanFor;
 	charsToScanFor.reserve(alphabetArg.value.size());
 	{
@@ -99,15 +675,112 @@ int main(int argc, const char ** argv){
 		for(uint8_t c: alphabetArg.value){
 			uint8_t offs = c >> 3;
 			uint8_t inOffs = c & 0x07;
-			if(!(charz[inOffs] & (1 << inOffs))){
+			if(!(charz[offs] & (1 << inOffs))){
 				charz[offs] |= (1 << inOffs);
 				charsToScanFor.emplace_back(c);
 			}
 		}
 	}
 
-	mio::ummap_source m(fileArg.value);
-	ScanBytes::ScannableT s{&m[0], m.size()};
+	if(!sequencesArg.value.empty()){
+		if(b != ScanBytes::Backend::Auto && b != ScanBytes::Backend::Sequences){
+			std::cerr << "--sequences are found only with Sequences backend" << std::endl;
+			return EXIT_FAILURE;
+		}
+		bool isSingleByteFormat = indexFormat == ScanBytes::IndexFormat::Fields || indexFormat == ScanBytes::IndexFormat::Sparse;
+		if(commandArg.value == "h" || commandArg.value == "tune" || isSingleByteFormat){
+			std::cerr << (isSingleByteFormat ? formatArg.value + " format" : "Command " + commandArg.value) << " needs single-byte separators" << std::endl;
+			return EXIT_FAILURE;
+		}
+		try{
+			charsToScanFor = ScanBytes::encodeSequences(parseSequences(sequencesArg.value));
+		} catch(std::logic_error &e){
+			std::cerr << "Invalid sequences: " << sequencesArg.value << std::endl;
+			return EXIT_FAILURE;
+		}
+		b = ScanBytes::Backend::Sequences;
+	} else if(b == ScanBytes::Backend::Sequences){
+		std::cerr << "Sequences backend needs --sequences" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if((indexFormat == ScanBytes::IndexFormat::Fields || indexFormat == ScanBytes::IndexFormat::Sparse) && commandArg.value == "l"){
+		std::cerr << formatArg.value << " indices can be built only with s command" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if(commandArg.value == "tune" && fileArg.value == "-"){
+		ScanBytes::ScannableT synthetic;
+		return tune(b, charsToScanFor, synthetic);
+	}
+
+	if(commandArg.value == "l"){
+		return indexBatch(b, charsToScanFor, fileArg.value);
+	}
+
+	ScanBytes::ScanStats stats;
+	if(!statsArg.value.empty()){
+		if(statsArg.value != "text" && statsArg.value != "json"){
+			std::cerr << "Invalid stats format: " << statsArg.value << std::endl;
+			return EXIT_FAILURE;
+		}
+		if(commandArg.value != "s" && commandArg.value != "c"){
+			std::cerr << "Only s and c commands collect the stats" << std::endl;
+			return EXIT_FAILURE;
+		}
+		if(!ScanBytes::areStatsCompiledIn()){
+			std::cerr << "The library is built without the stats, rebuild it with SCANBYTES_STATS defined (WITH_STATS CMake option)" << std::endl;
+			return EXIT_FAILURE;
+		}
+		scanStats = &stats;
+	}
+
+	bool isStdin = fileArg.value == "-";
+	struct stat st;
+	bool isUnmappable = isStdin || (!stat(fileArg.value.c_str(), &st) && !S_ISREG(st.st_mode));
+	bool isStreamed = !isUnmappable && !ScanBytes::isMappingEngine(ioEngine);
+	if(isUnmappable || isStreamed){
+		bool isMappedFormat = indexFormat == ScanBytes::IndexFormat::Fields || indexFormat == ScanBytes::IndexFormat::Sparse;
+		if((commandArg.value != "s" && commandArg.value != "c") || isMappedFormat){
+			std::cerr << "Command " << commandArg.value << " needs a regular file" << (commandArg.value == "s" ? " for " + formatArg.value + " format" : "") << (isStreamed ? " read with a mapping I/O engine" : "") << std::endl;
+			return EXIT_FAILURE;
+		}
+		int fd;
+		if(isStreamed){
+			try{
+				fd = ScanBytes::openForStreaming(fileArg.value, ioEngine);
+			} catch(std::system_error &e){
+				std::cerr << e.what() << std::endl;
+				return EXIT_FAILURE;
+			}
+		} else {
+			fd = isStdin ? STDIN_FILENO : open(fileArg.value.c_str(), O_RDONLY | O_CLOEXEC);
+		}
+		if(fd < 0){
+			std::cerr << "Cannot open " << fileArg.value << std::endl;
+			return EXIT_FAILURE;
+		}
+		auto res = commandArg.value == "c" ? countStream(b, charsToScanFor, fd) : streamIndex(b, charsToScanFor, fd, isStreamed ? fileArg.value : "");
+		if(isStreamed){
+			close(fd);
+		}
+		if(scanStats){
+			printStats(stats, statsArg.value);
+		}
+		return res;
+	}
+
+	std::unique_ptr<ScanBytes::FileMapping> m;
+	try{
+		m = std::make_unique<ScanBytes::FileMapping>(fileArg.value, ioEngine);
+	} catch(std::system_error &e){
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
 
-	return cmdPtr(b, charsToScanFor, s);
+	auto res = cmdPtr(b, charsToScanFor, m->data);
+	if(scanStats){
+		printStats(stats, statsArg.value);
+	}
+	return res;
 }
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+
+#include "ScanBytes.hpp"
+
+namespace ScanBytes{
+
+	/// The fastest backend and count of threads measured for an alphabet on a host
+	struct TuningDecision{
+		Backend backend = Backend::Unknown; // Unknown if nothing has been measured
+		uint16_t threadsCount = 0;
+		double bytesPerSecond = 0.;
+	};
+
+	/// The sample scanned by `autotune` is at most this large, a synthetic one is exactly this large
+	const size_t tuningSampleSize = 16 * 1024 * 1024;
+
+	/// `SCANBYTES_TUNING_CACHE` environment variable if it is set, otherwise `ScanBytes/tuning.tsv` in `XDG_CACHE_HOME` or `~/.cache`
+	std::filesystem::path getTuningCachePath();
+
+	/*
+	Scans the beginning of `sample` (or synthetic data with 1/64 of the bytes matching, if it is empty) with every backend able to find `charsToScanFor`, then with the fastest one using 1, 2, 4 ... `getThreadsCount()` threads.
+	The decision is stored into the cache keyed by the model of the CPU, the tier and the set of the chars, so from then on `Backend::Auto` resolves to the backend measured on this host, which scans with the measured count of threads unless it has been set with `setThreadsCount`. Throws `std::runtime_error` if the cache cannot be written.
+	*/
+	TuningDecision autotune(std::vector<uint8_t> charsToScanFor, ScannableT sample = {});
+
+	/// The cached decision for this CPU, the current tier and the set of the chars
+	TuningDecision getTuningDecision(std::vector<uint8_t> charsToScanFor);
+};
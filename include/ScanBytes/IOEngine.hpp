@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <memory>
+
+#include "ScanBytes.hpp"
+
+namespace ScanBytes{
+
+	/// How the data of a regular file gets into memory. Scanning a mapping of a file which is not in the page cache stalls the threads on page faults, a page at a time.
+	enum class IOEngine: uint8_t{
+		Unknown = 0,
+		Auto = 1, // Readahead if a sample of the pages of the mapping is not in the page cache, Mmap otherwise
+		Mmap = 2, // the pages are read on their first access
+		Populate = 3, // MAP_POPULATE: the whole file is read with large requests before the scan starts, also saves the minor faults for a cached file
+		Readahead = 4, // a thread asks the kernel to read (MADV_WILLNEED) a few chunks of the file ahead of every worker of a scan while it is scanned
+		Read = 5, // the file is read with large sequential reads into the buffers of a stream, the next one is read while the previous one is scanned
+		Direct = 6, // Read with O_DIRECT, bypassing the page cache. For the files read once or larger than the RAM, falls back to Read where the filesystem doesn't support it.
+	};
+
+	extern const char * ioEngineNames[];
+	IOEngine getIOEngineByName(std::string& name);
+
+	/// Whether the engine maps the file into memory, the other ones read it into the buffers of a stream
+	bool isMappingEngine(IOEngine e);
+
+	/// The buffers of the streams are aligned to this, so must their sizes be for Direct engine
+	const size_t directIOAlignment = 4096;
+
+	/// A regular file mapped read-only with Mmap, Populate or Readahead engine (Auto chooses between Mmap and Readahead). Throws std::system_error if it cannot be mapped.
+	struct FileMapping{
+		ScannableT data;
+		IOEngine engine;
+
+		FileMapping(const std::string &path, IOEngine e = IOEngine::Auto);
+		~FileMapping();
+
+		FileMapping(const FileMapping &) = delete;
+		FileMapping &operator=(const FileMapping &) = delete;
+
+	private:
+		struct Prefetcher;
+		std::unique_ptr<Prefetcher> prefetcher;
+	};
+
+	/// Opens a file to be passed to `scanStream` or `countStream` with Read or Direct engine and hints the kernel that it is read sequentially. Throws std::system_error if it cannot be opened.
+	int openForStreaming(const std::string &path, IOEngine e);
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "ScanBytes.hpp"
+
+namespace ScanBytes{
+
+	enum class IndexFormat: uint8_t{
+		Unknown = 0,
+		Raw = 1, // no header, just native uint64_t offsets, what `dumpIndices` writes
+		Flat = 2, // header + offsets, 4 bytes each if the data is under 4 GiB, 8 bytes otherwise
+		Packed = 3, // header + skip table + frames of bit-packed deltas
+		Fields = 4, // header + records table + narrow offsets of the fields relative to their records, built from `scanTagged` results
+		Sparse = 5, // header + alphabet + counts of the matches before every block of the data, the offsets are found by rescanning a block
+	};
+
+	extern const char * indexFormatNames[];
+	IndexFormat getIndexFormatByName(std::string& name);
+
+	enum IndexFlags: uint8_t{
+		endsInQuote = 1 << 0, // CSVQuoted: the data ends within a quoted field, needed to continue the scan when the data is appended
+		endsWithMatch = 1 << 1, // Sparse: the last byte of the data is a match, so no record follows the last match. The other formats read the last offset instead.
+	};
+
+	/// The last bytes of the indexed data are fingerprinted, so `updateIndex` can detect that the data has been changed rather than appended to
+	const uint32_t maxTailSize = 4 * 1024;
+
+	/*
+	All the numbers are little-endian.
+
+	Flat layout:
+		IndexHeader, `frameSize` is the width of an offset in bytes: `getOffsetWidth(dataSize)`, 4 or 8
+		offsets
+
+	Packed layout:
+		IndexHeader
+		PackedFrameEntry[framesCount], framesCount = ceil(count / frameSize)
+		payload: for each frame `uint8_t bitWidth` followed by `frameSize - 1` (fewer for the last frame) deltas between the consecutive offsets, `bitWidth` bits each, LSB first. A frame is padded to a whole byte.
+		8 zero bytes, so readers can always load a whole uint64_t
+	To get offset N, one takes the entry of the frame N / frameSize and adds the first N % frameSize deltas of the frame to its `first`.
+
+	Fields layout:
+		IndexHeader, `count` is the count of the record delimiters, `frameSize` is the width of a field offset in bytes: 2, 4 or 8, the least fitting all the records
+		FieldsRecordEntry[count + 2]: entry 0 is the first record, entry N + 1 is the record following record delimiter N. The last one is a sentinel: its `start` is `dataSize + 1` and `firstField` is the count of the field delimiters.
+		offsets of the field delimiters relative to the `start` of their records, in order
+	Record N spans from `start` of its entry to `start` of the next one minus 1, the delimiter, its field delimiters are `firstField`..`firstField` of the next entry. So a field is found with a lookup in each table.
+
+	Sparse layout:
+		IndexHeader, `count` is the count of the matches, `frameSize` is the size of a block of the data in bytes
+		SparseAlphabet
+		uint64_t checkpoints[blocksCount + 1], blocksCount = ceil(dataSize / frameSize): checkpoint N is the count of the matches before block N, the last one is `count`
+	The block of offset N is found with a binary search of the checkpoints, then the block is rescanned and offset N is its match `N - checkpoint`. So the index takes 8 bytes per block instead of 4-8 bytes per match, but needs the data to be read.
+	*/
+	struct IndexHeader{
+		static constexpr char signatureValue[8]{'S', 'c', 'a', 'n', 'B', 'I', 'd', 'x'};
+		static constexpr uint16_t currentVersion = 1;
+
+		char signature[8];
+		uint16_t version;
+		IndexFormat format;
+		uint8_t flags; // IndexFlags
+		uint32_t frameSize; // Packed: count of offsets in a frame, Flat and Fields: width of an offset, Sparse: size of a block of the data
+		uint64_t count; // count of the offsets
+		uint64_t dataSize; // size of the scanned data
+		uint64_t tailFingerprint; // hash of the `tailSize` bytes of the data preceding `dataSize`
+		uint32_t tailSize; // 0 if the tail was not fingerprinted (i.e. the data was a stream)
+		Backend backend; // Sparse: the one the checkpoints were counted with, the blocks are rescanned with it
+		uint8_t reserved[19];
+
+		IndexHeader(IndexFormat format=IndexFormat::Flat, uint64_t count=0, uint64_t dataSize=0);
+
+		/// Throws if the signature or the version is wrong
+		void validate() const;
+
+		/// Sets `dataSize` and fingerprints the tail of `data`
+		void setData(ScannableT data);
+
+		/// The same for the data read piece by piece: `tail` is its last `min(dataSize, maxTailSize)` bytes
+		void setTail(ScannableT tail, uint64_t dataSize);
+
+		/// Whether `data` starts with the data this index was built for
+		bool isPrefixOf(ScannableT data) const;
+	};
+	static_assert(sizeof(IndexHeader) == 64);
+
+	struct PackedFrameEntry{
+		uint64_t first; // the first offset in the frame
+		uint64_t payloadOffset; // relative to the beginning of the payload
+	};
+
+	const uint32_t defaultPackedFrameSize = 128;
+
+	/// The most data a lookup in a Sparse index rescans
+	const uint32_t defaultSparseBlockSize = 64 * 1024;
+
+	/// The chars a Sparse index was built for, so the reader can rescan the data without being told them. Bit `c % 8` of byte `c / 8` is set for char `c`.
+	struct SparseAlphabet{
+		uint8_t bits[256 / 8]{};
+
+		SparseAlphabet() = default;
+		SparseAlphabet(const std::vector<uint8_t> &chars);
+
+		std::vector<uint8_t> chars() const;
+
+		bool operator==(const SparseAlphabet &) const = default;
+	};
+	static_assert(sizeof(SparseAlphabet) == 32);
+
+	struct FieldsRecordEntry{
+		uint64_t start; // offset of the first byte of the record
+		uint64_t firstField; // index of the first field delimiter of the record
+	};
+
+	/// Writes the offsets (in order, as `scan` returns them, or `scanTagged` for Fields format) in the specified format. Encoding of Packed and Fields formats is done in parallel.
+	void writeIndex(NBST &chunks, std::ostream &out, IndexFormat format, uint64_t dataSize);
+
+	/// The same, but with a prepared header (`format`, `dataSize`, the fingerprint and the flags are taken from it), `count` and `frameSize` are filled in.
+	void writeIndex(NBST &chunks, std::ostream &out, IndexHeader h);
+
+	/// 4-byte offsets from `scanAs<uint32_t>`. The formats don't depend on the width of the offsets in memory, Raw widens them. Fields format is not supported.
+	void writeIndex(NarrowNBST &chunks, std::ostream &out, IndexHeader h);
+
+	/// Writes into a seekable file at the current position of `fd` and moves it to the end of the index. The file is extended to the final size first, then the threads write their slices in parallel with pwrite at the offsets computed from the sizes of the chunks.
+	void writeIndex(NBST &chunks, int fd, IndexHeader h);
+	void writeIndex(NarrowNBST &chunks, int fd, IndexHeader h);
+
+	/*
+	Writes a Sparse index of `data`, which takes a counting pass (popcnt, no offsets are stored) instead of a scan. `blockSize` trades the size of the index for the bytes rescanned by a lookup.
+	Auto is resolved before the pass and the backend is recorded in the index, so the lookups rescan with the same one. The blocks are rescanned independently, so the backends whose matches depend on the bytes before them (CSVQuoted and Sequences) aren't supported, std::logic_error is thrown for them.
+	*/
+	void writeSparseIndex(ScannableT data, std::vector<uint8_t> charsToScanFor, Backend b, std::ostream &out, uint32_t blockSize = defaultSparseBlockSize);
+
+	/// Whether `writeIndex` can write into `fd` in parallel: it is a regular file not opened for appending
+	bool isParallelWritable(int fd);
+
+	/*
+	Brings the index of a file that has only been appended to since indexing up to date: verifies the fingerprint of the tail, scans only the appended bytes and appends their offsets to the index.
+	The alphabet and the backend must be the same as the ones the index was built with. Flat indices are appended in place, Packed ones are re-encoded (the skip table precedes the payload), but the old offsets are not rescanned. Sparse ones get the checkpoints of the new blocks appended, counted with the backend recorded in the index, only the last old block, if it is incomplete, is counted again.
+	Raw indices have no header to verify, so they are not supported. Throws std::runtime_error if the data has been changed or truncated. Returns the count of the added offsets.
+	*/
+	uint64_t updateIndex(const std::string &indexPath, ScannableT data, std::vector<uint8_t> charsToScanFor, Backend b = Backend::Auto);
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <memory>
+
+#include "IndexFormat.hpp"
+
+namespace ScanBytes{
+
+	/// A record is the bytes between two consecutive delimiters, `size` doesn't include the delimiter
+	struct Record{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	/*
+	Memory-maps an index file of any format and answers the queries without loading it as a whole.
+	Record i spans from the byte after delimiter i - 1 (or from the beginning of the data) to delimiter i. If there are bytes after the last delimiter, they are the last record.
+	Sparse indices need the data attached with `attachData`, a lookup rescans a block of it. The offsets of the last rescanned block are kept, so the lookups within a block (e.g. both ends of a record) rescan it once, but such a reader must not be shared by the threads.
+	*/
+	struct IndexReader{
+		int fd;
+		const uint8_t *map;
+		size_t mapSize;
+
+		IndexHeader header;
+		const uint64_t *offsets; // Raw and Flat
+		const uint32_t *narrowOffsets; // Flat with 4-byte offsets
+		const PackedFrameEntry *frames; // Packed
+		const uint8_t *payload; // Packed
+		const FieldsRecordEntry *recordEntries; // Fields
+		const uint8_t *fieldOffsets; // Fields
+		const uint64_t *checkpoints; // Sparse
+		std::vector<uint8_t> alphabet; // Sparse
+
+		/// `dataSize` is needed for Raw indices which have no header, for other formats it is taken from the header if 0.
+		IndexReader(const std::string &path, uint64_t dataSize = 0);
+		~IndexReader();
+
+		IndexReader(const IndexReader &) = delete;
+		IndexReader &operator=(const IndexReader &) = delete;
+
+		/// Sparse format only: the data the index was built for, either mapped or read with pread from `dataFd`, which must stay open. It may have been appended to since indexing.
+		void attachData(ScannableT data);
+		void attachData(int dataFd);
+
+		/// count of the delimiters
+		inline uint64_t size() const {
+			return header.count;
+		}
+
+		inline uint64_t dataSize() const {
+			return header.dataSize;
+		}
+
+		/// offset of delimiter `n`. For Packed format it costs decoding at most `frameSize - 1` deltas, for Sparse format rescanning a block unless it is the last rescanned one. Throws std::runtime_error if the rescanned data doesn't match the index.
+		uint64_t operator[](uint64_t n) const;
+
+		/// Decodes all `size()` offsets into `out` sequentially, much cheaper than calling `operator[]` for each of them
+		void decodeAll(uint64_t *out) const;
+
+		uint64_t recordsCount() const;
+
+		Record record(uint64_t n) const;
+
+		/// The span of records `first`..`last` (inclusive) with the delimiters of all of them
+		Record records(uint64_t first, uint64_t last) const;
+
+		/// Fields format only: count of the fields of a record, which is the count of its field delimiters + 1
+		uint64_t fieldsCount(uint64_t record) const;
+
+		/// Fields format only: field `n` of a record without its delimiter, 2 lookups and no scanning
+		Record field(uint64_t record, uint64_t n) const;
+
+	private:
+		/// Checks the header and the extents of the tables it implies, the constructor cleans up if it throws
+		void parse(uint64_t dataSize);
+
+		uint64_t fieldOffset(uint64_t n) const;
+
+		/// Packed format: the width byte and the deltas of frame `f`, checked to be within the mapping
+		const uint8_t *framePayload(uint64_t f) const;
+
+		/// Sparse format
+		uint64_t getBlocksCount() const;
+
+		/// Sparse format: the offsets of the matches within a block of the data
+		const std::vector<uint64_t> &blockOffsets(uint64_t block) const;
+
+		struct Rescanner;
+		std::unique_ptr<Rescanner> rescanner;
+	};
+
+	/// Copies `size` bytes at `offset` of `dataFd` into `outFd` without passing them through user space where possible (sendfile/splice)
+	void sendRange(int dataFd, uint64_t offset, uint64_t size, int outFd);
+};
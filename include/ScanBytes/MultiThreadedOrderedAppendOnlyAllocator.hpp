@@ -4,59 +4,159 @@
 #include <vector>
 #include <compare>
 #include <memory>
+#include <mutex>
 #include <thread>
 
+/// A contiguous region the values of a single thread are appended to. Large ones are mmapped lazily, so the pages reserved but not used cost nothing.
+template<typename ValueT>
+struct Arena{
+	static constexpr size_t mmapThreshold = 1024 * 1024; // in bytes, smaller arenas are allocated on the heap
+
+	ValueT *values;
+	size_t capacity;
+
+	Arena(size_t capacity);
+	~Arena();
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+};
+
+/// The values of a block, a part of an arena it keeps alive. Has the read-only part of the interface of std::vector.
+template<typename ValueT>
+struct ArenaSpan{
+	std::shared_ptr<Arena<ValueT>> arena;
+	ValueT *ptr = nullptr;
+	size_t count = 0;
+
+	inline size_t size() const {
+		return count;
+	}
+
+	inline bool empty() const {
+		return !count;
+	}
+
+	inline ValueT *data() const {
+		return ptr;
+	}
+
+	inline ValueT &operator[](size_t i) const {
+		return ptr[i];
+	}
+
+	inline ValueT *begin() const {
+		return ptr;
+	}
+
+	inline ValueT *end() const {
+		return ptr + count;
+	}
+};
+
 template<typename ValueT>
 struct ValueBlock{
 	using value_type = ValueT;
-	using VecT = std::vector<ValueT>;
+	using VecT = ArenaSpan<ValueT>;
 
-	uint16_t id;
+	uint32_t id; // blocks are ordered by ids first, a scan task uses its index as the id
+	uint16_t worker = 0; // of a scan: the one whose range of the tasks has had the task of the block, see `WorkStealingQueue`
+	uint16_t workersCount = 0; // of the scan the block comes from, 0 if unknown
 	VecT vec;
 
-	ValueBlock(uint16_t id, size_t allocSize);
+	ValueBlock(uint32_t id, VecT vec);
+
+	/// A block with an arena of its own for `size` values, to be filled by the caller
+	ValueBlock(uint32_t id, size_t size);
+
 	std::strong_ordering operator<=>(const ValueBlock &b) const;
 };
 
 template<typename ValueT> struct ThreadAllocator;
 
+/// Of a thread allocator, counted on its slow paths only
+struct AllocatorStats{
+	uint64_t arenas = 0;
+	uint64_t blocks = 0;
+	uint64_t values = 0; // in the blocks cut
+	uint64_t lockWaitNs = 0; // measured only when the library is built with SCANBYTES_STATS
+};
+
+/*
+Every thread appends into an arena of its own without any locking, a block is cut when a thread starts a new task or its arena is full. Then the arena is replaced by a twice larger one.
+The blocks are put into `chunks` (under the lock) only once, when a thread is done. The values stay in the arenas, they are never copied.
+*/
 template<typename ValueT>
 struct MTOAOA{
 	using TAllocT = ThreadAllocator<ValueT>;
 	using StorageT = std::vector<std::unique_ptr<ValueBlock<ValueT>>>;
 	using NBT = ValueBlock<ValueT>;
 
-	static size_t page_size;
+	static constexpr size_t defaultArenaCapacity = 64 * 1024;
 
 	StorageT chunks;
 	std::mutex lock;
+	size_t arenaCapacity; // the capacity of the first arena of every thread, in values
 
-	MTOAOA();
+	/// `expectedPerThread` is the count of the values a thread is expected to append, the better it is predicted, the fewer arenas are allocated
+	MTOAOA(size_t expectedPerThread = defaultArenaCapacity);
 
-	TAllocT getForThread(uint16_t id);
-
-	NBT* reserveBlock(uint16_t id, size_t allocSize);
+	TAllocT getForThread(uint32_t id);
 };
 
 template<typename ValueT>
 struct ThreadAllocator{
 	using NAllocT = MTOAOA<ValueT>;
 
-	uint16_t id;
-	size_t allocSize;
-	size_t consumed;
+	uint32_t id;
 	NAllocT &parent;
-	typename NAllocT::NBT *mySpan;
-
-	ThreadAllocator(uint16_t id, NAllocT &parent);
+	std::shared_ptr<Arena<ValueT>> arena;
+	ValueT *blockStart = nullptr; // the current block is `blockStart`..`cur`
+	ValueT *cur = nullptr;
+	ValueT *end = nullptr;
+	typename NAllocT::StorageT blocks;
+	AllocatorStats stats;
+
+	ThreadAllocator(uint32_t id, NAllocT &parent);
 	~ThreadAllocator();
 
-	void finalize();
-
-	void reserveBlock();
+	ThreadAllocator(const ThreadAllocator &) = delete;
+	ThreadAllocator &operator=(const ThreadAllocator &) = delete;
 
-	void reserveBlock(size_t allocSize);
+	/// Hands the blocks over to the parent, called by the destructor
+	void finalize();
 
-	void append(uint64_t num);
+	/// The numbers appended after this go into blocks with id `taskId`
+	void startTask(uint32_t taskId);
+
+	inline void append(ValueT num){
+		if(cur == end){
+			grow(1);
+		}
+		*(cur++) = num;
+	}
+
+	/// Appends `toValue(offsets[i])` for every offset
+	template<typename TransformT>
+	inline void appendTransformed(const uint32_t *offsets, size_t count, TransformT toValue){
+		if(static_cast<size_t>(end - cur) < count){
+			grow(count);
+		}
+		for(size_t i = 0; i < count; ++i){
+			cur[i] = toValue(offsets[i]);
+		}
+		cur += count;
+	}
+
+	inline void appendRelative(uint64_t base, const uint32_t *offsets, size_t count){
+		appendTransformed(offsets, count, [base](uint32_t offset){
+			return base + offset;
+		});
+	}
+
+private:
+	void cutBlock();
+
+	/// Replaces the arena with a new one having space for at least `needed` values
+	void grow(size_t needed);
 };
-
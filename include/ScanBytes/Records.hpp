@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <optional>
+#include <functional>
+
+#include "ScanBytes.hpp"
+
+namespace ScanBytes{
+
+	/// Records starting within a window of a task, in order. A record is the bytes after a match (or the beginning of the data) till the next match (or the end of the data), without the match itself; the data ending with a match has no empty record after it. `record.data() - m.data()` is the offset of a record.
+	using RecordsBatchT = std::span<const ScannableT>;
+
+	/// Gets the records of a window of a task right after the window is scanned, while it is still in cache. Called concurrently from the scan threads, `worker` is the index of the calling one. The batches of a task come in order and from a single thread, the tasks are handled in any order.
+	using RecordsSinkT = std::function<void(uint16_t worker, size_t task, RecordsBatchT records)>;
+
+	/*
+	Scans `m` and passes the records to `sink` in the same pass, so they are not read through memory twice. The offsets of the matches are stored into `offsets` if it is set, then it is the same as the result of `scan`.
+	A task owns the records starting after its matches, the first one belongs to the first task. The last record of a task is completed by scanning past the end of the task till the next match, so the records straddling the tasks are passed whole, exactly once.
+	CSVQuoted counts the quotes of every task before the scan to know whether it starts within quotes. With Sequences a record ends before the first byte of the next match, the tasks a sequence reaches into from the previous one are scanned after the others, in order. `m` is the whole data, the records of a stream aren't supported.
+	*/
+	void scanRecords(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, RecordsSinkT sink, NBST *offsets = nullptr);
+
+	/// Count of the tasks `scanRecords` splits `m` into, `task` passed to the sink is below it
+	size_t getRecordsTasksCount(ScannableT m);
+
+	/// Calls `f(record)` for every record, concurrently from the scan threads
+	template<typename RecordFuncT>
+	void forEachRecord(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, RecordFuncT f, NBST *offsets = nullptr){
+		scanRecords(m, charsToScanFor, b, [&](uint16_t worker, size_t task, RecordsBatchT records){
+			for(auto &record: records){
+				f(record);
+			}
+		}, offsets);
+	}
+
+	/*
+	Ordered reduction: every task folds its records into a copy of `init` with `map(acc, record)` on the scan threads, then the results of the tasks are combined in order of the data with `acc = reduce(acc, taskResult)`, starting from `init`.
+	So `reduce` needs to be associative, but not commutative: concatenations and the things depending on the order of the records work.
+	*/
+	template<typename T, typename MapT, typename ReduceT>
+	T mapReduceRecords(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, T init, MapT map, ReduceT reduce, NBST *offsets = nullptr){
+		std::vector<std::optional<T>> results(getRecordsTasksCount(m));
+		scanRecords(m, charsToScanFor, b, [&](uint16_t worker, size_t task, RecordsBatchT records){
+			auto &acc = results[task];
+			if(!acc){
+				acc.emplace(init);
+			}
+			for(auto &record: records){
+				map(*acc, record);
+			}
+		}, offsets);
+
+		T res = init;
+		for(auto &acc: results){
+			if(acc){
+				res = reduce(std::move(res), std::move(*acc));
+			}
+		}
+		return res;
+	}
+};
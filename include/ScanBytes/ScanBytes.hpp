@@ -16,6 +16,7 @@
 #include <span>
 
 #include "MultiThreadedOrderedAppendOnlyAllocator.hpp"
+#include "ScanStats.hpp"
 
 namespace ScanBytes{
 
@@ -29,11 +30,66 @@ namespace ScanBytes{
 		LF = 4, // "\n" <> <>
 		CSV = 5, // "\n" <> <> "," <> <> CSV <> 5.98905
 		TSV = 6,
-		Space = 7,
-		Punct = 8,
+		Space = 7, // " "
+		Punct = 8, // ASCII punctuation, classified with the shuffle kernels
+		SIMD = 9, // 1-4 chars, compares 64-byte blocks at once
+		Shuffle = 10, // any alphabet, classifies bytes with nibble shuffle tables (SSSE3/AVX2)
+		CSVQuoted = 11, // RFC 4180 CSV, 1-3 delimiters, skips the ones within quoted fields. Never chosen automatically.
+		Sequences = 12, // multi-byte delimiters (CRLF, "||" ...) packed with `encodeSequences`, the offsets are the ones of their last bytes. Never chosen automatically.
+		CharSet = 13, // the common alphabets having detectors with the chars built in: "\n", "\r\n", ",\n", "\t\n", "|", "\x1f\x1e", " " and the punctuation. Auto chooses it (or LF, CSV, TSV, Space, Punct, which are the same) for them.
 	};
 
 
+	/// Instruction set levels the SIMD kernels are compiled for. The best one supported by the CPU is chosen at runtime.
+	enum class Tier: uint8_t{
+		Unknown = 0,
+		Auto = 1,
+		Scalar = 2, // no SIMD kernels at all
+		SSE2 = 3,
+		SSSE3 = 4, // adds pshufb, needed by the Shuffle backend
+		AVX2 = 5,
+		AVX512BW = 6,
+	};
+
+	extern const char * tierNames[];
+	Tier getTierByName(std::string& name);
+
+	bool isTierSupported(Tier t);
+	Tier detectBestTier();
+
+	/// The tier used by the SIMD backends. Initialized from SCANBYTES_TIER environment variable if it is set, otherwise with `detectBestTier()`.
+	Tier getTier();
+
+	/// Forces the SIMD backends to use the kernels of a certain tier, mainly for testing. Tier::Auto restores the detected one. Throws if the CPU doesn't support the tier.
+	void forceTier(Tier t);
+
+	/// Count of the threads scanning the data and encoding the indices. By default it is the count of the CPUs the process is allowed to run on.
+	uint16_t getThreadsCount();
+
+	/// 0 restores the default
+	void setThreadsCount(uint16_t count);
+
+	/*
+	Where the threads scanning the data and writing the indices run. The workers of a scan take equal contiguous ranges of the data, so pinning the consecutive ones to the same NUMA node gives every node a contiguous part of the data. Their offsets are written into the memory of their node, since the arenas get their pages on the first touch, and the threads writing an index write the offsets found by the workers of the same nodes.
+	The nodes are the ones in /sys/devices/system/node having the CPUs the process is allowed to run on.
+	*/
+	enum class ThreadPlacement: uint8_t{
+		Unknown = 0,
+		OS = 1, // wherever the scheduler puts them, the default
+		Nodes = 2, // the workers are spread over the nodes proportionally to their CPUs, each one is pinned to all the CPUs of its node
+		Cores = 3, // the same, but each worker is pinned to a CPU of its own
+	};
+
+	extern const char * threadPlacementNames[];
+	ThreadPlacement getThreadPlacementByName(std::string& name);
+
+	ThreadPlacement getThreadPlacement();
+	void setThreadPlacement(ThreadPlacement p);
+
+	/// Count of the NUMA nodes having the CPUs the process is allowed to run on, 1 on the systems without NUMA
+	uint16_t getNUMANodesCount();
+
+
 	using BenchmarkResultT = std::vector<std::chrono::duration<double, std::micro>>;
 
 	template<Backend backendEnum>
@@ -44,14 +100,78 @@ namespace ScanBytes{
 
 	Backend getGenericBackend();
 	Backend detectProperBackend(std::vector<uint8_t> &charsToScanFor);
+	/// The backend with a detector compiled for this set of chars (LF, CSV, TSV, Space, Punct or CharSet), Unknown if there is none
+	Backend getCharSetBackend(std::vector<uint8_t> &charsToScanFor);
 	Backend getBackendByName(std::string& n);
 
 	using NumbersAllocator = MTOAOA<uint64_t>;
 	using NBST = NumbersAllocator::StorageT;
+
+	/// Offsets stored as `OffsetT`, see `scanAs`
+	template<typename OffsetT>
+	using OffsetsST = typename MTOAOA<OffsetT>::StorageT;
+	using NarrowNBST = OffsetsST<uint32_t>;
+	/// The chunks are returned in order of the offsets
 	NBST scan(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b = Backend::Auto);
 
+	/// Sequences found by Backend::Sequences are 1 to this many bytes long
+	const size_t maxSequenceLength = 16;
+
+	/*
+	Packs byte sequences into the alphabet of Backend::Sequences: every one is prefixed with its length. Throws if a sequence is empty or longer than `maxSequenceLength`.
+	A match is the longest sequence starting at the leftmost position not covered by the previous match, so the matches never overlap: "|||" contains a single "||".
+	*/
+	std::vector<uint8_t> encodeSequences(const std::vector<std::string> &sequences);
+
+	/// The reverse of `encodeSequences`, throws if the alphabet is malformed
+	std::vector<std::string> decodeSequences(const std::vector<uint8_t> &charsToScanFor);
+
+	/// What is carried between the consecutive buffers of a stream scanned piece by piece
+	struct ScanState{
+		uint64_t base = 0; // offset of the next buffer within the stream, added to the offsets found in it
+		bool inQuote = false; // CSVQuoted only: whether the stream scanned so far ends within a quoted field
+		ScanStats *stats = nullptr; // filled if set, see ScanStats.hpp
+
+		/*
+		Sequences only: the last bytes of the stream scanned so far and the position the next match may start at, so the sequences spanning the buffers are found.
+		A buffer doesn't know what follows it, so if a sequence fits before its end while a longer one starting at the same position would span into the next buffer, the shorter one is matched.
+		*/
+		uint64_t sequencesFrom = 0;
+		uint8_t tail[maxSequenceLength - 1]{};
+		uint8_t tailSize = 0;
+	};
+
+	/// Scans the next buffer of a stream, the offsets are relative to the beginning of the stream. Advances `state`.
+	NBST scan(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state);
+
+	/// The narrowest width of the offsets (4 or 8 bytes) fitting the data ending at `dataEnd` (`state.base + m.size()` for a stream)
+	uint8_t getOffsetWidth(uint64_t dataEnd);
+
+	/// `scan` storing the offsets as `OffsetT`: uint32_t or uint64_t. For data under 4 GiB uint32_t halves the memory and the bandwidth needed for the offsets, throws if they don't fit.
+	template<typename OffsetT>
+	OffsetsST<OffsetT> scanAs(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state);
+
+	/// Set in the offsets of the record delimiters returned by `scanTagged`
+	const uint64_t recordTagBit = uint64_t(1) << 63;
+
+	/// Like `scan`, but the offsets of `recordDelimiter` (one of the chars) have `recordTagBit` set, so the delimiters of records and of fields are told apart without going back to the data. Used to build Fields indices.
+	NBST scanTagged(ScannableT m, std::vector<uint8_t> charsToScanFor, uint8_t recordDelimiter, Backend b, ScanState &state);
+
+	/// Count of the matches. Runs the same tasks as `scan`, but uses popcnt instead of extracting the offsets and never stores them.
+	uint64_t count(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b = Backend::Auto);
+
+	/// Counts the next buffer of a stream, advances `state`
+	uint64_t count(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state);
+
+	/// Counts of the matches within every `blockSize` bytes of `m`, the last block may be shorter. Useful to preallocate the outputs of the consumers of the blocks.
+	std::vector<uint64_t> countPerBlock(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, size_t blockSize);
+
+	/// Counts of the occurrences of every char of the alphabet, in the same order. Quotes are not taken into account.
+	std::vector<uint64_t> countEachChar(ScannableT m, std::vector<uint8_t> charsToScanFor);
+
 	BenchmarkResultT benchmark(Backend b, ScannableT m, std::vector<uint8_t> charsToScanFor, uint8_t benchmarkAttempts = 10);
 
+	/// Not needed for the results of `scan`, they are already in order
 	void sortIndices(NBST &chunks);
 
 	void dumpIndices(NBST &chunks);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ScanBytes{
+
+	/// What a single worker thread has done
+	struct ThreadStats{
+		uint64_t bytes = 0; // scanned
+		uint64_t matches = 0; // CSVQuoted counts the delimiters within quotes too and Sequences the ones before fixing the boundaries up, they don't know yet which of them are the matches
+		uint64_t tasks = 0;
+		uint64_t steals = 0; // ranges of tasks taken from other workers
+		uint64_t busyNs = 0; // wall time spent in tasks
+		uint64_t arenas = 0; // allocated for the offsets
+		uint64_t blocks = 0; // of the offsets cut from the arenas
+		uint64_t lockWaitNs = 0; // waiting for the lock of the allocator to hand the blocks over
+		uint64_t minorFaults = 0;
+		uint64_t majorFaults = 0; // the pages read from the disk
+
+		ThreadStats &operator+=(const ThreadStats &o);
+	};
+
+	/*
+	Filled by `scan`, `scanAs`, `scanTagged`, `count` and the streaming functions if `ScanState::stats` points to it, accumulated over all the scans using the same state.
+	The instrumentation is compiled into the library only with SCANBYTES_STATS defined (WITH_STATS CMake option). Otherwise the pointer is ignored and the scans don't spend a single instruction on it.
+	A single `ScanStats` must not be used by several scans running at the same time.
+	*/
+	struct ScanStats{
+		std::vector<ThreadStats> threads; // indexed by the id of the worker
+		uint64_t scans = 0; // calls, a stream is scanned by a call per buffer
+		uint64_t bytes = 0;
+		uint64_t matches = 0; // in the results returned, for CSVQuoted only the ones outside of quotes
+		uint64_t wallNs = 0;
+
+		ThreadStats total() const;
+
+		/// Bytes per second of the wall time
+		double throughput() const;
+	};
+
+	/// Whether the library has been built with SCANBYTES_STATS
+	bool areStatsCompiledIn();
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "ScanBytes.hpp"
+#include "Records.hpp"
+
+namespace ScanBytes{
+
+	/// Gets the sorted offsets of a file of a batch. `data` is valid only during the call. Called from the threads of the pool, concurrently for different files.
+	using FileSinkT = std::function<void(size_t fileIndex, ScannableT data, NBST &chunks, ScanState &state)>;
+
+	struct FileError{
+		size_t fileIndex;
+		std::string message;
+	};
+
+	/*
+	Keeps a thread pool and the built detector (for JIT backend, the generated code) between scans. Worth using instead of `scan` when there are lots of them, for small files creating the threads costs more than scanning.
+	The count of threads is `getThreadsCount()` at the moment of construction, or the one measured by `autotune` if the backend is Auto and the count has not been set. A Scanner must not be used from multiple threads at once.
+	*/
+	struct Scanner{
+		Backend backend;
+
+		Scanner(std::vector<uint8_t> charsToScanFor, Backend b = Backend::Auto);
+		~Scanner();
+
+		Scanner(const Scanner &) = delete;
+		Scanner &operator=(const Scanner &) = delete;
+
+		NBST scan(ScannableT m);
+
+		/// Scans the next buffer of a stream, see the same overload of `ScanBytes::scan`
+		NBST scan(ScannableT m, ScanState &state);
+
+		/// See `ScanBytes::count`
+		uint64_t count(ScannableT m);
+		uint64_t count(ScannableT m, ScanState &state);
+		std::vector<uint64_t> countPerBlock(ScannableT m, size_t blockSize);
+
+		/// See `ScanBytes::scanRecords`
+		void scanRecords(ScannableT m, RecordsSinkT sink, NBST *offsets = nullptr);
+
+		/*
+		Scans a batch of files, each one gets its own offsets passed to `sink`. The files fitting into a task are read and scanned by the workers, one file per task; the larger ones are memory-mapped and each one is split over the whole pool.
+		The files that cannot be read are skipped and reported in the result.
+		*/
+		std::vector<FileError> scanFiles(const std::vector<std::string> &paths, FileSinkT sink);
+
+	private:
+		struct Impl;
+		std::unique_ptr<Impl> impl;
+	};
+};
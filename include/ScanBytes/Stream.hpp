@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include "ScanBytes.hpp"
+
+namespace ScanBytes{
+
+	const size_t defaultStreamBufferSize = 16 * 1024 * 1024;
+	const uint8_t defaultStreamBuffersCount = 3;
+
+	/// Gets the offsets found in a buffer of a stream. The offsets are relative to the beginning of the stream, the buffers come in order.
+	using StreamSinkT = std::function<void(NBST &chunks)>;
+
+	/*
+	Scans everything readable from `fd` (a pipe, a socket, a file of any size, see `openForStreaming`) till EOF, returns the count of bytes read.
+	A separate thread reads ahead into `buffersCount` buffers of `bufferSize` bytes while a filled one is scanned by the usual multithreaded `scan`, so only these buffers and the offsets of a single buffer are kept in memory.
+	`stats`, if set, gets the stats of the scans of all the buffers.
+	*/
+	uint64_t scanStream(int fd, std::vector<uint8_t> charsToScanFor, Backend b, StreamSinkT sink, size_t bufferSize = defaultStreamBufferSize, uint8_t buffersCount = defaultStreamBuffersCount, ScanStats *stats = nullptr);
+
+	/// The same, continuing from `state` and advancing it, so one knows how the stream has ended, e.g. `state.inQuote` for the header of a CSVQuoted index. `state.stats` is used instead of `stats`.
+	uint64_t scanStream(int fd, std::vector<uint8_t> charsToScanFor, Backend b, StreamSinkT sink, ScanState &state, size_t bufferSize = defaultStreamBufferSize, uint8_t buffersCount = defaultStreamBuffersCount);
+
+	/// Like `scanStream`, but returns the count of the matches in the whole stream
+	uint64_t countStream(int fd, std::vector<uint8_t> charsToScanFor, Backend b, size_t bufferSize = defaultStreamBufferSize, uint8_t buffersCount = defaultStreamBuffersCount, ScanStats *stats = nullptr);
+};
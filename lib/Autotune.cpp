@@ -0,0 +1,241 @@
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <set>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <ScanBytes/Autotune.hpp>
+#include "CharDetector.hpp"
+#include "CPUFeatures.hpp"
+#include "DetectorScanner.hpp"
+
+namespace ScanBytes{
+
+	namespace {
+		const uint8_t tuningAttempts = 5;
+
+		/// Every backend able to find exactly these chars on this CPU and tier. CSVQuoted finds other matches, so it is never a candidate.
+		std::vector<Backend> getCandidateBackends(std::vector<uint8_t> &charsToScanFor){
+			std::vector<Backend> res;
+			std::set<uint8_t> chars(begin(charsToScanFor), end(charsToScanFor));
+			#ifdef SCANBYTES_JIT_SUPPORTED
+			if(getTier() != Tier::Scalar){
+				res.emplace_back(Backend::JIT);
+			}
+			#endif
+			res.emplace_back(Backend::Fallback);
+			if(auto b = getCharSetBackend(charsToScanFor); b != Backend::Unknown){
+				res.emplace_back(b);
+			}
+			#ifdef SCANBYTES_SIMD_SUPPORTED
+			if(chars.size() <= SIMDCharsDetector::maxChars && SIMDCharsDetector::isSupported()){
+				res.emplace_back(Backend::SIMD);
+			}
+			if(ShuffleCharsDetector::isSupported()){
+				res.emplace_back(Backend::Shuffle);
+			}
+			#endif
+			return res;
+		}
+
+		/// The chars in hex, sorted, so the order they are given in doesn't matter
+		std::string getAlphabetSignature(std::vector<uint8_t> &charsToScanFor){
+			std::set<uint8_t> chars(begin(charsToScanFor), end(charsToScanFor));
+			const char digits[] = "0123456789abcdef";
+			std::string res;
+			for(auto c: chars){
+				res += digits[c >> 4];
+				res += digits[c & 0xF];
+			}
+			return res;
+		}
+
+		std::string getTuningKey(std::vector<uint8_t> &charsToScanFor){
+			std::string model = getCPUModel();
+			std::replace(begin(model), end(model), '\t', ' ');
+			return model + "\t" + tierNames[static_cast<uint8_t>(getTier())] + "\t" + getAlphabetSignature(charsToScanFor);
+		}
+
+		/// A line per decision: CPU model, tier, alphabet signature, backend, count of threads, bytes per second, separated with tabs
+		struct TuningCache{
+			std::mutex lock;
+			bool loaded = false;
+			std::unordered_map<std::string, TuningDecision> decisions;
+
+			/// Under the lock
+			void load(){
+				if(loaded){
+					return;
+				}
+				loaded = true;
+				std::ifstream in(getTuningCachePath());
+				std::string line;
+				while(std::getline(in, line)){
+					std::vector<std::string> fields;
+					std::istringstream s(line);
+					std::string field;
+					while(std::getline(s, field, '\t')){
+						fields.emplace_back(field);
+					}
+					if(fields.size() != 6){
+						continue;
+					}
+					TuningDecision d;
+					d.backend = getBackendByName(fields[3]);
+					try{
+						d.threadsCount = std::stoul(fields[4]);
+						d.bytesPerSecond = std::stod(fields[5]);
+					} catch(std::logic_error &e){
+						continue;
+					}
+					if(d.backend != Backend::Unknown){
+						decisions[fields[0] + "\t" + fields[1] + "\t" + fields[2]] = d;
+					}
+				}
+			}
+
+			/// Under the lock. The file is replaced with a new one, so a concurrent reader never sees it half-written.
+			void save(){
+				auto path = getTuningCachePath();
+				std::error_code ec;
+				std::filesystem::create_directories(path.parent_path(), ec);
+				auto tmpPath = path;
+				tmpPath += ".tmp";
+				{
+					std::ofstream out(tmpPath, std::ios::trunc);
+					for(auto &[key, d]: decisions){
+						out << key << '\t' << backendNames[static_cast<uint8_t>(d.backend)] << '\t' << d.threadsCount << '\t' << d.bytesPerSecond << '\n';
+					}
+					out.close();
+					if(!out){
+						throw std::runtime_error("Cannot write " + tmpPath.string());
+					}
+				}
+				if(rename(tmpPath.c_str(), path.c_str())){
+					throw std::runtime_error("Cannot replace " + path.string());
+				}
+			}
+		};
+
+		TuningCache &getTuningCache(){
+			static TuningCache cache;
+			return cache;
+		}
+
+		/// Letters and digits with every char of the alphabet taking 1/64 of the bytes, roughly the density of the line breaks in a log
+		std::vector<uint8_t> makeSyntheticSample(std::vector<uint8_t> &charsToScanFor){
+			const char fillers[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+			std::vector<uint8_t> res(tuningSampleSize);
+			uint64_t state = 1;
+			for(auto &b: res){
+				state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+				uint32_t r = state >> 33;
+				if(r % 64 < charsToScanFor.size() && r % 64 < 63){
+					b = charsToScanFor[(r >> 6) % charsToScanFor.size()];
+				} else {
+					b = fillers[(r >> 6) % (sizeof(fillers) - 1)];
+				}
+			}
+			return res;
+		}
+
+		/// Median wall time of a scan, after a scan warming the caches and the page tables up
+		double measure(DetectorScanner &d, ScannableT m, ThreadPool &pool){
+			std::vector<double> times;
+			for(uint8_t i = 0; i <= tuningAttempts; ++i){
+				ScanState state;
+				auto t1 = std::chrono::steady_clock::now();
+				auto res = d.scan(m, state, pool);
+				auto t2 = std::chrono::steady_clock::now();
+				if(i){
+					times.emplace_back(std::chrono::duration<double>(t2 - t1).count());
+				}
+			}
+			std::sort(begin(times), end(times));
+			return times[times.size() / 2];
+		}
+	};
+
+	std::filesystem::path getTuningCachePath(){
+		if(const char *path = getenv("SCANBYTES_TUNING_CACHE")){
+			return path;
+		}
+		std::filesystem::path dir;
+		if(const char *cacheHome = getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome){
+			dir = cacheHome;
+		} else if(const char *home = getenv("HOME")){
+			dir = std::filesystem::path(home) / ".cache";
+		} else {
+			dir = std::filesystem::temp_directory_path();
+		}
+		return dir / "ScanBytes" / "tuning.tsv";
+	}
+
+	TuningDecision autotune(std::vector<uint8_t> charsToScanFor, ScannableT sample){
+		if(charsToScanFor.empty()){
+			throw std::logic_error("Set of the chars must be not empty");
+		}
+		std::vector<uint8_t> synthetic;
+		if(sample.empty()){
+			synthetic = makeSyntheticSample(charsToScanFor);
+			sample = ScannableT{synthetic.data(), synthetic.size()};
+		}
+		sample = sample.first(std::min(sample.size(), tuningSampleSize));
+
+		TuningDecision best;
+		uint16_t maxThreads = getWorkersCount(sample);
+		{
+			ThreadPool pool(maxThreads);
+			double bestTime = 0;
+			for(auto b: getCandidateBackends(charsToScanFor)){
+				auto d = makeDetectorScanner(b, charsToScanFor);
+				auto time = measure(*d, sample, pool);
+				if(best.backend == Backend::Unknown || time < bestTime){
+					best.backend = b;
+					bestTime = time;
+				}
+			}
+			best.threadsCount = maxThreads;
+			best.bytesPerSecond = sample.size() / bestTime;
+		}
+
+		auto d = makeDetectorScanner(best.backend, charsToScanFor);
+		for(uint16_t threadsCount = 1; threadsCount < maxThreads; threadsCount *= 2){
+			ThreadPool pool(threadsCount);
+			auto bytesPerSecond = sample.size() / measure(*d, sample, pool);
+			if(bytesPerSecond > best.bytesPerSecond){
+				best.threadsCount = threadsCount;
+				best.bytesPerSecond = bytesPerSecond;
+			}
+		}
+
+		auto &cache = getTuningCache();
+		std::lock_guard<std::mutex> guard(cache.lock);
+		cache.load();
+		cache.decisions[getTuningKey(charsToScanFor)] = best;
+		cache.save();
+		return best;
+	}
+
+	TuningDecision getTuningDecision(std::vector<uint8_t> charsToScanFor){
+		auto &cache = getTuningCache();
+		std::lock_guard<std::mutex> guard(cache.lock);
+		cache.load();
+		auto it = cache.decisions.find(getTuningKey(charsToScanFor));
+		if(it == end(cache.decisions)){
+			return {};
+		}
+		auto candidates = getCandidateBackends(charsToScanFor);
+		if(std::find(begin(candidates), end(candidates), it->second.backend) == end(candidates)){
+			return {};  // the cache has been made by a build with other backends
+		}
+		return it->second;
+	}
+};
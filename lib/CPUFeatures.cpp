@@ -0,0 +1,175 @@
+#include <atomic>
+#include <string>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ScanBytes/ScanBytes.hpp>
+#include "CPUFeatures.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(i386) || defined(__i386__) || defined(__i386) || defined(_M_IX86)
+	#include <cpuid.h>
+	#define SCANBYTES_CPUID_SUPPORTED 1
+#endif
+
+namespace ScanBytes{
+
+	namespace {
+		#ifdef SCANBYTES_CPUID_SUPPORTED
+			uint64_t xgetbv0(){
+				uint32_t eax, edx;
+				asm volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+				return (static_cast<uint64_t>(edx) << 32) | eax;
+			}
+		#endif
+
+		CPUFeatures detectCPUFeatures(){
+			CPUFeatures f;
+			#ifdef SCANBYTES_CPUID_SUPPORTED
+				uint32_t eax, ebx, ecx, edx;
+				if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)){
+					return f;
+				}
+				f.sse2 = edx & bit_SSE2;
+				f.ssse3 = ecx & bit_SSSE3;
+				f.pclmul = ecx & bit_PCLMUL;
+				f.popcnt = ecx & bit_POPCNT;
+
+				bool osSavesYmm = false, osSavesZmm = false;
+				if((ecx & bit_OSXSAVE) && (ecx & bit_AVX)){
+					uint64_t xcr0 = xgetbv0();
+					osSavesYmm = (xcr0 & 0x06) == 0x06;  // XMM and YMM state
+					osSavesZmm = osSavesYmm && (xcr0 & 0xE0) == 0xE0;  // opmask, ZMM_Hi256 and Hi16_ZMM state
+				}
+
+				if(__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)){
+					f.bmi1 = ebx & bit_BMI;
+					f.bmi2 = ebx & bit_BMI2;
+					f.avx2 = osSavesYmm && (ebx & bit_AVX2);
+					f.avx512f = osSavesZmm && (ebx & bit_AVX512F);
+					f.avx512bw = f.avx512f && (ebx & bit_AVX512BW);
+				}
+			#endif
+			return f;
+		}
+
+		std::string detectCPUModel(){
+			std::string model;
+			#ifdef SCANBYTES_CPUID_SUPPORTED
+				uint32_t regs[4];
+				if(__get_cpuid(0x80000000, &regs[0], &regs[1], &regs[2], &regs[3]) && regs[0] >= 0x80000004){
+					for(uint32_t leaf = 0x80000002; leaf <= 0x80000004; ++leaf){
+						__get_cpuid(leaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+						model.append(reinterpret_cast<const char *>(regs), sizeof(regs));
+					}
+					model.resize(strnlen(model.data(), model.size()));
+					auto first = model.find_first_not_of(' ');
+					model = first == std::string::npos ? "" : model.substr(first, model.find_last_not_of(' ') - first + 1);
+				}
+			#endif
+			return model.empty() ? "unknown" : model;
+		}
+
+		Tier tierFromEnvironment(){
+			const char *name = getenv("SCANBYTES_TIER");
+			if(!name){
+				return Tier::Auto;
+			}
+			std::string n{name};
+			auto t = getTierByName(n);
+			if(t == Tier::Unknown){
+				throw std::logic_error("Invalid tier name in SCANBYTES_TIER: " + n);
+			}
+			return t;
+		}
+
+		std::atomic<Tier> activeTier{Tier::Unknown};
+	};
+
+	const CPUFeatures &getCPUFeatures(){
+		static const CPUFeatures features = detectCPUFeatures();
+		return features;
+	}
+
+	const std::string &getCPUModel(){
+		static const std::string model = detectCPUModel();
+		return model;
+	}
+
+	const char * tierNames[] = {
+		"Unknown",
+		"Auto",
+		"Scalar",
+		"SSE2",
+		"SSSE3",
+		"AVX2",
+		"AVX512BW",
+	};
+
+	std::unordered_map<std::string, Tier> tiersByNames{
+		{tierNames[static_cast<uint8_t>(Tier::Auto)], Tier::Auto},
+		{tierNames[static_cast<uint8_t>(Tier::Scalar)], Tier::Scalar},
+		{tierNames[static_cast<uint8_t>(Tier::SSE2)], Tier::SSE2},
+		{tierNames[static_cast<uint8_t>(Tier::SSSE3)], Tier::SSSE3},
+		{tierNames[static_cast<uint8_t>(Tier::AVX2)], Tier::AVX2},
+		{tierNames[static_cast<uint8_t>(Tier::AVX512BW)], Tier::AVX512BW},
+	};
+
+	Tier getTierByName(std::string& name){
+		auto it = tiersByNames.find(name);
+		if(it == end(tiersByNames)){
+			return Tier::Unknown;
+		}
+		return it->second;
+	}
+
+	bool isTierSupported(Tier t){
+		auto &f = getCPUFeatures();
+		switch(t){
+			case Tier::Scalar:
+				return true;
+			case Tier::SSE2:
+				return f.sse2;
+			case Tier::SSSE3:
+				return f.sse2 && f.ssse3;
+			case Tier::AVX2:
+				return f.avx2 && f.bmi1 && f.bmi2 && f.pclmul && f.popcnt;
+			case Tier::AVX512BW:
+				return f.avx512bw && f.avx2 && f.bmi1 && f.bmi2 && f.pclmul && f.popcnt;
+			default:
+				return false;
+		}
+	}
+
+	Tier detectBestTier(){
+		#ifdef SCANBYTES_CPUID_SUPPORTED
+		for(auto t: {Tier::AVX512BW, Tier::AVX2, Tier::SSSE3, Tier::SSE2}){
+			if(isTierSupported(t)){
+				return t;
+			}
+		}
+		#endif
+		return Tier::Scalar;
+	}
+
+	void forceTier(Tier t){
+		if(t == Tier::Auto){
+			t = detectBestTier();
+		}
+		if(!isTierSupported(t)){
+			throw std::logic_error(std::string("Tier ") + tierNames[static_cast<uint8_t>(t)] + " is not supported by this CPU");
+		}
+		activeTier = t;
+	}
+
+	Tier getTier(){
+		Tier t = activeTier;
+		if(t == Tier::Unknown){
+			forceTier(tierFromEnvironment());
+			t = activeTier;
+		}
+		return t;
+	}
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace ScanBytes{
+	/// Features of the CPU we run on, detected with cpuid once, also taking into account whether the OS saves the wide registers.
+	struct CPUFeatures{
+		bool sse2 = false;
+		bool ssse3 = false;
+		bool pclmul = false;
+		bool popcnt = false;
+		bool bmi1 = false;
+		bool bmi2 = false;
+		bool avx2 = false;
+		bool avx512f = false;
+		bool avx512bw = false;
+	};
+
+	const CPUFeatures &getCPUFeatures();
+
+	/// The brand string reported by cpuid, "unknown" if there is none
+	const std::string &getCPUModel();
+};
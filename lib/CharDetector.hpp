@@ -1,9 +1,13 @@
 #pragma once
 #include <cstdint>
 #include <utility>
+#include <type_traits>
 #include <vector>
 
 #include "jit.hpp"
+#include "SIMDDetector.hpp"
+#include "QuotedCSVDetector.hpp"
+#include "SequencesDetector.hpp"
 
 struct FallbackCharDetector{
 	uint8_t charz[256 / 8];
@@ -32,35 +36,73 @@ struct FallbackCharDetector{
 	}
 };
 
-template <uint8_t targetChar>
-struct SingleCharDetector{
-	inline SingleCharDetector(std::vector<uint8_t> &v){};
+/*
+Alphabet known at compile time, so testing a byte is a chain of comparisons with constants.
+Alphabets of 1-4 chars run the compare kernels, the ones having the chars built in if they are listed in `Kernels::FixedAlphabets`. The larger ones run the shuffle kernels with the tables computed at compile time. Without the kernels every byte is tested with `operator()`.
+*/
+template <uint8_t... chars>
+struct CharSetDetector
+#ifdef SCANBYTES_SIMD_SUPPORTED
+	: public TieredDetector<CharSetDetector<chars...>>
+#endif
+{
+	static constexpr uint8_t charz[] = {chars...};
+	static constexpr bool usesCompare = sizeof...(chars) <= ScanBytes::Kernels::maxCompareChars;
 
-	inline bool operator()(uint8_t c) { return c == targetChar;};
-};
+	#ifdef SCANBYTES_SIMD_SUPPORTED
+	static constexpr size_t fixedIndex = ScanBytes::Kernels::fixedAlphabetIndex<chars...>;
 
-template <uint8_t mostFrequent, uint8_t leastFrequent>
-struct TwoCharsDetector{
-	inline TwoCharsDetector(std::vector<uint8_t> &v){};
+	static constexpr auto makeParams(){
+		if constexpr(usesCompare){
+			ScanBytes::Kernels::CompareParams params{};
+			for(size_t i = 0; i < ScanBytes::Kernels::maxCompareChars; ++i){
+				params.charz[i] = charz[i < sizeof...(chars) ? i : 0];
+			}
+			return params;
+		} else {
+			return ScanBytes::Kernels::makeShuffleParams(charz, sizeof...(chars));
+		}
+	}
 
-	inline bool operator()(uint8_t c) { return c == mostFrequent || c == leastFrequent;};
-};
+	static constexpr auto params = makeParams();
+	std::conditional_t<usesCompare, ScanBytes::Kernels::CompareKernelT, ScanBytes::Kernels::ShuffleKernelT> kernel = nullptr;
+	std::conditional_t<usesCompare, ScanBytes::Kernels::CompareCountKernelT, ScanBytes::Kernels::ShuffleCountKernelT> countKernel = nullptr;
+	#endif
 
-struct PunctDetector{
-	inline PunctDetector(std::vector<uint8_t> &v){};
+	inline CharSetDetector(std::vector<uint8_t> &v){
+		#ifdef SCANBYTES_SIMD_SUPPORTED
+		auto kernels = ScanBytes::Kernels::getKernels(ScanBytes::getTier());
+		if(!kernels){
+			return;
+		}
+		if constexpr(!usesCompare){
+			kernel = kernels->shuffle;
+			countKernel = kernels->shuffleCount;
+		} else if constexpr(fixedIndex < ScanBytes::Kernels::fixedAlphabetsCount){
+			kernel = kernels->fixedCompare[fixedIndex];
+			countKernel = kernels->fixedCompareCount[fixedIndex];
+		} else {
+			kernel = kernels->compare[sizeof...(chars) - 1];
+			countKernel = kernels->compareCount[sizeof...(chars) - 1];
+		}
+		#endif
+	};
 
 	inline bool operator()(uint8_t c) {
-		return (
-			(33 <= c && c < 48) ||
-			(58<= c && c < 65) ||
-			(91<= c && c < 97) ||
-			(123<= c && c < 127)
-		);
+		return ((c == chars) || ...);
 	};
 };
 
-using LineBreaksDetector = SingleCharDetector<'\n'>;
-using SpacesDetector = SingleCharDetector<' '>;
-using CSVDetector = TwoCharsDetector<',', '\n'>;
-using TSVDetector = TwoCharsDetector<'\t', '\n'>;
+/// ASCII punctuation: !"#$%&'()*+,-./:;<=>?@[\]^_`{|}~
+using PunctDetector = CharSetDetector<
+	'!', '"', '#', '$', '%', '&', '\'', '(', ')', '*', '+', ',', '-', '.', '/',
+	':', ';', '<', '=', '>', '?', '@',
+	'[', '\\', ']', '^', '_', '`',
+	'{', '|', '}', '~'
+>;
+
+using LineBreaksDetector = CharSetDetector<'\n'>;
+using SpacesDetector = CharSetDetector<' '>;
+using CSVDetector = CharSetDetector<',', '\n'>;
+using TSVDetector = CharSetDetector<'\t', '\n'>;
 
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include <ScanBytes/ScanBytes.hpp>
+#include <ScanBytes/Records.hpp>
+#include "Threading.hpp"
+#include "SIMDDetector.hpp"
+
+namespace ScanBytes{
+
+	/// The data is split into tasks of this size, which are handled by `runTasks`. They must be large enough to make scheduling overhead negligible, but small enough to keep all the threads busy till the end.
+	const size_t scanTaskSize = 64 * scanWindowSize;
+
+	inline size_t getTasksCount(ScannableT m){
+		return (m.size() + scanTaskSize - 1) / scanTaskSize;
+	}
+
+	/// Enough workers for all the tasks of `m`, but not more than `threadsCount`
+	inline uint16_t getWorkersCount(ScannableT m, uint16_t threadsCount = getThreadsCount()){
+		return std::max<size_t>(std::min<size_t>(threadsCount, getTasksCount(m)), 1);
+	}
+
+	/// A scan of `data` whose tasks are being run, registered so the prefetcher of the mapping having the data can keep ahead of its workers. The prefetchers are woken when it starts, when a worker takes a task and when it ends.
+	struct ScanInProgress{
+		ScannableT data;
+		WorkStealingQueue &queue;
+
+		ScanInProgress(ScannableT data, WorkStealingQueue &queue);
+		~ScanInProgress();
+
+		ScanInProgress(const ScanInProgress &) = delete;
+		ScanInProgress &operator=(const ScanInProgress &) = delete;
+	};
+
+	/// `runTasks` over the tasks of `m`, which is registered as a scan in progress meanwhile
+	template<typename WorkerFuncT>
+	void runTasks(ScannableT m, WorkerFuncT f, ThreadPool &pool){
+		size_t tasksCount = getTasksCount(m);
+		uint16_t workersCount = getWorkersCount(m, pool.size());
+		WorkStealingQueue q{tasksCount, workersCount};
+		ScanInProgress scan{m, q};
+		pool.run(workersCount, [&](uint16_t id){
+			f(id, q);
+		});
+	}
+
+	/// Resolves Auto like `detectProperBackend`, the count of threads `autotune` has measured for the backend replaces `threadsCount` unless it has been set with `setThreadsCount`
+	Backend detectProperBackend(std::vector<uint8_t> &charsToScanFor, uint16_t &threadsCount);
+
+	/// A detector of any backend built once and reused for many scans
+	struct DetectorScanner{
+		virtual ~DetectorScanner() = default;
+
+		/// Splits `m` into tasks and runs them on `pool`
+		virtual NBST scan(ScannableT m, ScanState &state, ThreadPool &pool) = 0;
+
+		/// The same with 4-byte offsets, `state.base + m.size()` must fit into them
+		virtual NarrowNBST scanNarrow(ScannableT m, ScanState &state, ThreadPool &pool) = 0;
+
+		/// For small data not worth splitting. The buffers must have space for `scanWindowSize` offsets, `altOffsets` is used only by CSVQuoted.
+		virtual NBST scanInThisThread(ScannableT m, ScanState &state, std::vector<uint32_t> &offsets, std::vector<uint32_t> &altOffsets) = 0;
+
+		/// `scan` tagging the offsets of `recordDelimiter` with `recordTagBit`
+		virtual NBST scanTagged(ScannableT m, ScanState &state, uint8_t recordDelimiter, ThreadPool &pool) = 0;
+
+		/// Adds the counts of the matches within every `blockSize` bytes of `m` to `counts`, which must have `(m.size() + blockSize - 1) / blockSize` items. Doesn't advance `state.base`.
+		virtual void count(ScannableT m, ScanState &state, size_t blockSize, uint64_t *counts, ThreadPool &pool) = 0;
+
+		/// Passes the records of `m` to `sink` while scanning it, see `ScanBytes::scanRecords`
+		virtual void scanRecords(ScannableT m, RecordsSinkT &sink, NBST *offsets, ThreadPool &pool) = 0;
+	};
+
+	std::unique_ptr<DetectorScanner> makeDetectorScanner(Backend b, std::vector<uint8_t> &charsToScanFor);
+};
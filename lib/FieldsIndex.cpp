@@ -0,0 +1,136 @@
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "FieldsIndex.hpp"
+#include "Threading.hpp"
+#include "FileIO.hpp"
+
+namespace ScanBytes{
+
+	namespace {
+		/// What is needed from a chunk to know where the tables of the chunks after it start
+		struct ChunkSummary{
+			uint64_t recordsCount = 0;
+			uint64_t lastRecordStart = 0; // after the last record delimiter of the chunk, if there is one
+			uint64_t lastLeadingField = 0; // the last field delimiter preceding the first record delimiter of the chunk, its record starts in a previous chunk
+			bool hasLeadingFields = false;
+			uint64_t maxRelativeOffset = 0; // of the fields of the records starting within the chunk
+		};
+
+		ChunkSummary summarize(const ValueBlock<uint64_t> &chunk){
+			ChunkSummary s;
+			for(auto v: chunk.vec){
+				if(v & recordTagBit){
+					++s.recordsCount;
+					s.lastRecordStart = (v & ~recordTagBit) + 1;
+				} else if(!s.recordsCount){
+					s.lastLeadingField = v;
+					s.hasLeadingFields = true;
+				} else {
+					s.maxRelativeOffset = std::max(s.maxRelativeOffset, v - s.lastRecordStart);
+				}
+			}
+			return s;
+		}
+
+		/// Where the part of the tables made of a chunk starts
+		struct ChunkPosition{
+			uint64_t record; // index of the entry of the first record delimiter of the chunk
+			uint64_t field;
+			uint64_t recordStart; // of the record open at the beginning of the chunk
+		};
+
+		template<typename FieldOffsetT>
+		void fillChunk(const ValueBlock<uint64_t> &chunk, ChunkPosition p, FieldsRecordEntry *records, FieldOffsetT *fields){
+			for(auto v: chunk.vec){
+				if(v & recordTagBit){
+					p.recordStart = (v & ~recordTagBit) + 1;
+					records[p.record++] = {.start = p.recordStart, .firstField = p.field};
+				} else {
+					fields[p.field++] = v - p.recordStart;
+				}
+			}
+		}
+
+		struct FieldsTables{
+			std::vector<FieldsRecordEntry> records;
+			std::vector<uint8_t> fields;
+		};
+
+		/// The chunks are summarized in parallel, then the positions of their parts are known and they are converted in parallel
+		FieldsTables buildFields(NBST &chunks, IndexHeader &h){
+			uint16_t threadsCount = std::clamp<size_t>(chunks.size(), 1, getThreadsCount());
+			std::vector<ChunkSummary> summaries(chunks.size());
+			runOnShares(chunks.size(), [&](uint16_t id, size_t first, size_t stop){
+				for(size_t i = first; i < stop; ++i){
+					summaries[i] = summarize(*chunks[i]);
+				}
+			}, threadsCount);
+
+			std::vector<ChunkPosition> positions(chunks.size());
+			ChunkPosition p{.record = 1, .field = 0, .recordStart = 0};
+			uint64_t maxRelativeOffset = 0;
+			for(size_t i = 0; i < chunks.size(); ++i){
+				auto &s = summaries[i];
+				positions[i] = p;
+				if(s.hasLeadingFields){
+					maxRelativeOffset = std::max(maxRelativeOffset, s.lastLeadingField - p.recordStart);
+				}
+				maxRelativeOffset = std::max(maxRelativeOffset, s.maxRelativeOffset);
+				p.record += s.recordsCount;
+				p.field += chunks[i]->vec.size() - s.recordsCount;
+				if(s.recordsCount){
+					p.recordStart = s.lastRecordStart;
+				}
+			}
+
+			h.count = p.record - 1;
+			h.frameSize = maxRelativeOffset <= UINT16_MAX ? sizeof(uint16_t) : maxRelativeOffset <= UINT32_MAX ? sizeof(uint32_t) : sizeof(uint64_t);
+
+			FieldsTables t;
+			t.records.resize(h.count + 2);
+			t.records.front() = {.start = 0, .firstField = 0};
+			t.records.back() = {.start = h.dataSize + 1, .firstField = p.field};
+			t.fields.resize(p.field * h.frameSize);
+
+			runOnShares(chunks.size(), [&](uint16_t id, size_t first, size_t stop){
+				for(size_t i = first; i < stop; ++i){
+					switch(h.frameSize){
+						case sizeof(uint16_t):
+							fillChunk(*chunks[i], positions[i], t.records.data(), reinterpret_cast<uint16_t *>(t.fields.data()));
+						break;
+						case sizeof(uint32_t):
+							fillChunk(*chunks[i], positions[i], t.records.data(), reinterpret_cast<uint32_t *>(t.fields.data()));
+						break;
+						default:
+							fillChunk(*chunks[i], positions[i], t.records.data(), reinterpret_cast<uint64_t *>(t.fields.data()));
+					}
+				}
+			}, threadsCount);
+			return t;
+		}
+	};
+
+	void writeFields(NBST &chunks, std::ostream &out, IndexHeader &h){
+		auto t = buildFields(chunks, h);
+		out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+		out.write(reinterpret_cast<const char *>(t.records.data()), t.records.size() * sizeof(t.records[0]));
+		out.write(reinterpret_cast<const char *>(t.fields.data()), t.fields.size());
+	}
+
+	void writeFields(NBST &chunks, int fd, uint64_t pos, IndexHeader &h){
+		auto t = buildFields(chunks, h);
+		uint64_t recordsSize = t.records.size() * sizeof(t.records[0]);
+		uint64_t stop = pos + sizeof(h) + recordsSize + t.fields.size();
+		if(ftruncate(fd, stop)){
+			throwErrno("Cannot extend the index");
+		}
+		pwriteFully(fd, &h, sizeof(h), pos);
+		pwriteFully(fd, t.records.data(), recordsSize, pos + sizeof(h));
+		pwriteFully(fd, t.fields.data(), t.fields.size(), pos + sizeof(h) + recordsSize);
+		lseek(fd, stop, SEEK_SET);
+	}
+};
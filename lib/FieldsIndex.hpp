@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+
+#include <ScanBytes/IndexFormat.hpp>
+
+namespace ScanBytes{
+	/// Builds the tables of Fields format from the tagged offsets and writes them, fills `count` and `frameSize` of the header
+	void writeFields(NBST &chunks, std::ostream &out, IndexHeader &h);
+
+	/// The same into a file at `pos`, leaves the position of `fd` at the end of the index
+	void writeFields(NBST &chunks, int fd, uint64_t pos, IndexHeader &h);
+};
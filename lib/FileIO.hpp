@@ -0,0 +1,30 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace ScanBytes{
+	[[noreturn]] inline void throwErrno(const std::string &what){
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+
+	/// pwrite returns less than asked when interrupted by a signal or for large sizes
+	inline void pwriteFully(int fd, const void *buf, size_t size, uint64_t offset){
+		auto p = static_cast<const uint8_t *>(buf);
+		while(size){
+			ssize_t w = pwrite(fd, p, size, offset);
+			if(w < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				throwErrno("Cannot write the index");
+			}
+			p += w;
+			offset += w;
+			size -= w;
+		}
+	}
+};
@@ -0,0 +1,291 @@
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ScanBytes/IOEngine.hpp>
+#include "DetectorScanner.hpp"
+#include "FileIO.hpp"
+
+namespace ScanBytes{
+	const char * ioEngineNames[] = {
+		"Unknown",
+		"Auto",
+		"Mmap",
+		"Populate",
+		"Readahead",
+		"Read",
+		"Direct",
+	};
+
+	std::unordered_map<std::string, IOEngine> ioEnginesByNames{
+		{ioEngineNames[static_cast<uint8_t>(IOEngine::Auto)], IOEngine::Auto},
+		{ioEngineNames[static_cast<uint8_t>(IOEngine::Mmap)], IOEngine::Mmap},
+		{ioEngineNames[static_cast<uint8_t>(IOEngine::Populate)], IOEngine::Populate},
+		{ioEngineNames[static_cast<uint8_t>(IOEngine::Readahead)], IOEngine::Readahead},
+		{ioEngineNames[static_cast<uint8_t>(IOEngine::Read)], IOEngine::Read},
+		{ioEngineNames[static_cast<uint8_t>(IOEngine::Direct)], IOEngine::Direct},
+	};
+
+	IOEngine getIOEngineByName(std::string& name){
+		auto it = ioEnginesByNames.find(name);
+		if(it == end(ioEnginesByNames)){
+			return IOEngine::Unknown;
+		}
+		return it->second;
+	}
+
+	bool isMappingEngine(IOEngine e){
+		return e == IOEngine::Auto || e == IOEngine::Mmap || e == IOEngine::Populate || e == IOEngine::Readahead;
+	}
+
+	namespace {
+		/// Pages of the mapping checked by Auto
+		const size_t residencySamplesCount = 64;
+
+		/// Whether most of a few evenly spread pages of the mapping are in the page cache
+		bool isMostlyResident(uint8_t *map, size_t size){
+			size_t pageSize = sysconf(_SC_PAGESIZE);
+			size_t pagesCount = (size + pageSize - 1) / pageSize;
+			size_t samplesCount = std::min(pagesCount, residencySamplesCount);
+			size_t resident = 0;
+			for(size_t i = 0; i < samplesCount; ++i){
+				unsigned char vec;
+				size_t page = i * pagesCount / samplesCount;
+				if(mincore(map + page * pageSize, pageSize, &vec)){
+					return true;  // cannot tell, the plain mapping is never worse than the prefetching one
+				}
+				resident += vec & 1;
+			}
+			return resident * 2 >= samplesCount;
+		}
+
+		/// A mapping whose prefetcher follows the scans within it
+		struct WatchedMapping{
+			ScannableT data;
+			bool hasBeenScanned = false; // a scan within it has started
+			bool stopping = false; // it is being unmapped
+		};
+
+		struct ScansRegistry{
+			std::mutex lock;
+			std::condition_variable changed;
+			std::vector<const ScanInProgress *> scans;
+			std::vector<WatchedMapping *> mappings;
+			uint64_t generation = 0; // bumped when a scan starts, progresses or ends
+
+			/// Wakes the prefetchers, `guard` holds the lock
+			void notify(std::unique_lock<std::mutex> &guard){
+				++generation;
+				guard.unlock();
+				changed.notify_all();
+			}
+		};
+
+		ScansRegistry &getScansRegistry(){
+			static ScansRegistry registry;
+			return registry;
+		}
+
+		bool isWithin(ScannableT part, ScannableT whole){
+			return part.data() >= whole.data() && part.data() + part.size() <= whole.data() + whole.size();
+		}
+	};
+
+	ScanInProgress::ScanInProgress(ScannableT data, WorkStealingQueue &queue): data(data), queue(queue){
+		auto &registry = getScansRegistry();
+		queue.onProgress = [&registry]{
+			std::unique_lock<std::mutex> guard(registry.lock);
+			registry.notify(guard);
+		};
+		std::unique_lock<std::mutex> guard(registry.lock);
+		registry.scans.emplace_back(this);
+		for(auto mapping: registry.mappings){
+			if(isWithin(data, mapping->data)){
+				mapping->hasBeenScanned = true;
+			}
+		}
+		registry.notify(guard);
+	}
+
+	ScanInProgress::~ScanInProgress(){
+		auto &registry = getScansRegistry();
+		std::unique_lock<std::mutex> guard(registry.lock);
+		registry.scans.erase(std::find(begin(registry.scans), end(registry.scans), this));
+		registry.notify(guard);
+	}
+
+	/*
+	Issues MADV_WILLNEED for a window of chunks ahead of every worker of the scans of the mapping, following the ranges of their WorkStealingQueue, so every worker finds its next pages already requested. Before a scan starts, the windows are at the beginnings of the ranges the workers will start with.
+	The window is bounded, so the pages are not read long before they are scanned, when a file larger than the page cache would get them evicted first.
+	The thread sleeps till a scan starts, progresses or ends, and exits when the scans of the mapping are over or all of it has been requested.
+	*/
+	struct FileMapping::Prefetcher{
+		static constexpr size_t chunkSize = 4 * scanTaskSize;
+		static constexpr size_t windowChunks = 4; // ahead of every worker
+
+		WatchedMapping watched; // guarded by the lock of the registry
+		std::thread thread;
+
+		Prefetcher(ScannableT data): watched{data}{
+			auto &registry = getScansRegistry();
+			{
+				std::lock_guard<std::mutex> guard(registry.lock);
+				registry.mappings.emplace_back(&watched);
+			}
+			thread = std::thread([this, data]{
+				run(data);
+			});
+		}
+
+		~Prefetcher(){
+			auto &registry = getScansRegistry();
+			std::unique_lock<std::mutex> guard(registry.lock);
+			watched.stopping = true;
+			registry.notify(guard);
+			thread.join();
+			guard.lock();
+			registry.mappings.erase(std::find(begin(registry.mappings), end(registry.mappings), &watched));
+		}
+
+		void run(ScannableT data){
+			size_t chunksCount = (data.size() + chunkSize - 1) / chunkSize;
+			std::vector<bool> advised(chunksCount);
+			size_t advisedCount = 0;
+			std::vector<std::pair<size_t, size_t>> cursors;  // the positions of the workers and the ends of their ranges
+
+			auto adviseWindows = [&](){
+				for(auto [position, stop]: cursors){
+					size_t stopChunk = std::min((stop + chunkSize - 1) / chunkSize, position / chunkSize + windowChunks);
+					for(size_t c = position / chunkSize; c < stopChunk; ++c){
+						if(!advised[c]){
+							madvise(data.data() + c * chunkSize, std::min(chunkSize, data.size() - c * chunkSize), MADV_WILLNEED);
+							advised[c] = true;
+							++advisedCount;
+						}
+					}
+				}
+			};
+
+			size_t tasksCount = getTasksCount(data);
+			uint16_t workersCount = getWorkersCount(data);
+			size_t start = 0;
+			for(uint16_t i = 0; i < workersCount; ++i){  // like the ranges of WorkStealingQueue
+				size_t stop = start + tasksCount / workersCount + (i < tasksCount % workersCount);
+				cursors.emplace_back(start * scanTaskSize, std::min(stop * scanTaskSize, data.size()));
+				start = stop;
+			}
+			adviseWindows();
+
+			auto &registry = getScansRegistry();
+			std::unique_lock<std::mutex> guard(registry.lock);
+			uint64_t seenGeneration = registry.generation - 1;  // a scan may have started already
+			while(advisedCount < chunksCount){
+				registry.changed.wait(guard, [&]{return watched.stopping || registry.generation != seenGeneration;});
+				if(watched.stopping){
+					return;
+				}
+				seenGeneration = registry.generation;
+				cursors.clear();
+				bool isScanned = false;
+				for(auto scan: registry.scans){
+					if(!isWithin(scan->data, data)){
+						continue;
+					}
+					isScanned = true;
+					size_t base = scan->data.data() - data.data();
+					for(uint16_t i = 0; i < scan->queue.workersCount; ++i){
+						auto &range = scan->queue.ranges[i];
+						std::lock_guard<std::mutex> rangeGuard(range.lock);
+						if(range.next < range.stop){
+							cursors.emplace_back(base + range.next * scanTaskSize, base + std::min(range.stop * scanTaskSize, scan->data.size()));
+						}
+					}
+				}
+				if(watched.hasBeenScanned && !isScanned){
+					return;  // the scans are over, nothing to keep ahead of
+				}
+				guard.unlock();
+				adviseWindows();
+				guard.lock();
+			}
+		}
+	};
+
+	FileMapping::FileMapping(const std::string &path, IOEngine e): engine(e){
+		if(!isMappingEngine(e)){
+			throw std::logic_error(std::string(ioEngineNames[static_cast<uint8_t>(e)]) + " engine doesn't map the files");
+		}
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if(fd < 0){
+			throwErrno("Cannot open " + path);
+		}
+		struct stat st;
+		if(fstat(fd, &st)){
+			int err = errno;
+			close(fd);
+			throw std::system_error(err, std::generic_category(), "Cannot stat " + path);
+		}
+		size_t size = st.st_size;
+		if(!size){
+			close(fd);
+			if(engine == IOEngine::Auto){
+				engine = IOEngine::Mmap;
+			}
+			return;
+		}
+		void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | (engine == IOEngine::Populate ? MAP_POPULATE : 0), fd, 0);
+		int err = errno;
+		close(fd);
+		if(map == MAP_FAILED){
+			throw std::system_error(err, std::generic_category(), "Cannot map " + path);
+		}
+		data = ScannableT{static_cast<uint8_t *>(map), size};
+
+		if(engine == IOEngine::Auto){
+			engine = isMostlyResident(data.data(), size) ? IOEngine::Mmap : IOEngine::Readahead;
+		}
+		if(engine == IOEngine::Readahead){
+			prefetcher = std::make_unique<Prefetcher>(data);
+		}
+	}
+
+	FileMapping::~FileMapping(){
+		prefetcher.reset();
+		if(data.data()){
+			munmap(data.data(), data.size());
+		}
+	}
+
+	int openForStreaming(const std::string &path, IOEngine e){
+		if(e != IOEngine::Read && e != IOEngine::Direct){
+			throw std::logic_error(std::string(ioEngineNames[static_cast<uint8_t>(e)]) + " engine doesn't stream the files");
+		}
+		int fd = -1;
+		if(e == IOEngine::Direct){
+			fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+			if(fd < 0 && errno != EINVAL){  // EINVAL: the filesystem doesn't support O_DIRECT
+				throwErrno("Cannot open " + path);
+			}
+		}
+		if(fd < 0){
+			fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if(fd < 0){
+				throwErrno("Cannot open " + path);
+			}
+		}
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		return fd;
+	}
+};
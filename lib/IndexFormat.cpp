@@ -0,0 +1,478 @@
+#include <cstring>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <ScanBytes/IndexFormat.hpp>
+#include "Threading.hpp"
+#include "FileIO.hpp"
+#include "FieldsIndex.hpp"
+
+namespace ScanBytes{
+
+	const char * indexFormatNames[] = {
+		"Unknown",
+		"Raw",
+		"Flat",
+		"Packed",
+		"Fields",
+		"Sparse",
+	};
+
+	std::unordered_map<std::string, IndexFormat> indexFormatsByNames{
+		{indexFormatNames[static_cast<uint8_t>(IndexFormat::Raw)], IndexFormat::Raw},
+		{indexFormatNames[static_cast<uint8_t>(IndexFormat::Flat)], IndexFormat::Flat},
+		{indexFormatNames[static_cast<uint8_t>(IndexFormat::Packed)], IndexFormat::Packed},
+		{indexFormatNames[static_cast<uint8_t>(IndexFormat::Fields)], IndexFormat::Fields},
+		{indexFormatNames[static_cast<uint8_t>(IndexFormat::Sparse)], IndexFormat::Sparse},
+	};
+
+	IndexFormat getIndexFormatByName(std::string& name){
+		auto it = indexFormatsByNames.find(name);
+		if(it == end(indexFormatsByNames)){
+			return IndexFormat::Unknown;
+		}
+		return it->second;
+	}
+
+	IndexHeader::IndexHeader(IndexFormat format, uint64_t count, uint64_t dataSize): version(currentVersion), format(format), flags(0), frameSize(0), count(count), dataSize(dataSize), tailFingerprint(0), tailSize(0), backend(Backend::Unknown){
+		memcpy(signature, signatureValue, sizeof(signature));
+		memset(reserved, 0, sizeof(reserved));
+	}
+
+	void IndexHeader::validate() const{
+		if(memcmp(signature, signatureValue, sizeof(signature))){
+			throw std::runtime_error("Not a ScanBytes index");
+		}
+		if(version != currentVersion){
+			throw std::runtime_error("Unsupported version of index: " + std::to_string(version));
+		}
+	}
+
+	namespace {
+		/// FNV-1a, the tail is small and it only has to catch accidental changes
+		uint64_t fingerprint(const uint8_t *p, size_t size){
+			uint64_t h = 0xcbf29ce484222325ULL;
+			for(size_t i = 0; i < size; ++i){
+				h = (h ^ p[i]) * 0x100000001b3ULL;
+			}
+			return h;
+		}
+	};
+
+	void IndexHeader::setData(ScannableT data){
+		dataSize = data.size();
+		tailSize = std::min<uint64_t>(dataSize, maxTailSize);
+		tailFingerprint = fingerprint(data.data() + dataSize - tailSize, tailSize);
+	}
+
+	void IndexHeader::setTail(ScannableT tail, uint64_t size){
+		if(tail.size() != std::min<uint64_t>(size, maxTailSize)){
+			throw std::logic_error("The tail must be the last " + std::to_string(maxTailSize) + " bytes of the data or the whole data");
+		}
+		dataSize = size;
+		tailSize = tail.size();
+		tailFingerprint = fingerprint(tail.data(), tailSize);
+	}
+
+	bool IndexHeader::isPrefixOf(ScannableT data) const{
+		return data.size() >= dataSize && fingerprint(data.data() + dataSize - tailSize, tailSize) == tailFingerprint;
+	}
+
+	namespace {
+		inline uint8_t bitWidth(uint64_t v){
+			return v ? 64 - __builtin_clzll(v) : 0;
+		}
+
+		struct BitWriter{
+			std::vector<uint8_t> &buf;
+			uint64_t acc = 0;
+			uint8_t filled = 0;
+
+			BitWriter(std::vector<uint8_t> &buf): buf(buf){}
+
+			void writeWord(uint64_t w, uint8_t bytes){
+				for(uint8_t i = 0; i < bytes; ++i){
+					buf.emplace_back(static_cast<uint8_t>(w >> (i * 8)));
+				}
+			}
+
+			void put(uint64_t v, uint8_t width){
+				if(!width){
+					return;
+				}
+				acc |= v << filled;
+				if(filled + width >= 64){
+					writeWord(acc, 8);
+					acc = filled ? v >> (64 - filled) : 0;
+					filled = filled + width - 64;
+				} else {
+					filled += width;
+				}
+			}
+
+			void flush(){
+				writeWord(acc, (filled + 7) / 8);
+				acc = 0;
+				filled = 0;
+			}
+		};
+
+		/// Iterates over the offsets of the sorted chunks starting from the global index `idx`
+		template<typename StorageT>
+		struct ChunksCursor{
+			StorageT &chunks;
+			size_t chunk;
+			size_t inChunk;
+
+			ChunksCursor(StorageT &chunks, const std::vector<uint64_t> &chunkStarts, uint64_t idx): chunks(chunks){
+				chunk = std::upper_bound(begin(chunkStarts), end(chunkStarts), idx) - begin(chunkStarts) - 1;
+				inChunk = idx - chunkStarts[chunk];
+			}
+
+			uint64_t next(){
+				while(inChunk >= chunks[chunk]->vec.size()){
+					++chunk;
+					inChunk = 0;
+				}
+				return chunks[chunk]->vec[inChunk++];
+			}
+		};
+
+		struct EncodedPart{
+			std::vector<uint8_t> payload;
+			std::vector<PackedFrameEntry> frames;
+		};
+
+		template<typename StorageT>
+		void encodeFrames(StorageT &chunks, const std::vector<uint64_t> &chunkStarts, uint64_t count, uint32_t frameSize, size_t firstFrame, size_t stopFrame, EncodedPart &part){
+			if(firstFrame >= stopFrame){
+				return;
+			}
+			ChunksCursor<StorageT> cursor{chunks, chunkStarts, firstFrame * frameSize};
+			std::vector<uint64_t> values(frameSize);
+			BitWriter w{part.payload};
+
+			for(size_t f = firstFrame; f < stopFrame; ++f){
+				size_t frameCount = std::min<uint64_t>(frameSize, count - f * frameSize);
+				uint64_t maxDelta = 0;
+				for(size_t i = 0; i < frameCount; ++i){
+					values[i] = cursor.next();
+					if(i){
+						maxDelta = std::max(maxDelta, values[i] - values[i - 1]);
+					}
+				}
+				uint8_t width = bitWidth(maxDelta);
+
+				part.frames.emplace_back(PackedFrameEntry{.first = values[0], .payloadOffset = part.payload.size()});
+				part.payload.emplace_back(width);
+				for(size_t i = 1; i < frameCount; ++i){
+					w.put(values[i] - values[i - 1], width);
+				}
+				w.flush();
+			}
+		}
+
+		/// Counts of the offsets before each chunk, followed by the total count
+		template<typename StorageT>
+		std::vector<uint64_t> getChunkStarts(StorageT &chunks){
+			std::vector<uint64_t> chunkStarts;
+			chunkStarts.reserve(chunks.size() + 1);
+			uint64_t count = 0;
+			for(auto &chunk: chunks){
+				chunkStarts.emplace_back(count);
+				count += chunk->vec.size();
+			}
+			chunkStarts.emplace_back(count);
+			return chunkStarts;
+		}
+
+		/// Encodes the frames in parallel, fills `count` and `frameSize` of the header. `payloadOffset` of the frames of every part are made relative to the beginning of the whole payload.
+		template<typename StorageT>
+		std::vector<EncodedPart> encodePacked(StorageT &chunks, IndexHeader &h){
+			h.frameSize = defaultPackedFrameSize;
+
+			auto chunkStarts = getChunkStarts(chunks);
+			uint64_t count = chunkStarts.back();
+			h.count = count;
+
+			size_t framesCount = (count + h.frameSize - 1) / h.frameSize;
+			std::vector<EncodedPart> parts(getThreadsCount());
+			runOnShares(framesCount, [&](uint16_t id, size_t firstFrame, size_t stopFrame){
+				encodeFrames(chunks, chunkStarts, count, h.frameSize, firstFrame, stopFrame, parts[id]);
+			}, parts.size());
+
+			uint64_t partOffset = 0;
+			for(auto &part: parts){
+				for(auto &frame: part.frames){
+					frame.payloadOffset += partOffset;
+				}
+				partOffset += part.payload.size();
+			}
+			return parts;
+		}
+
+		const uint64_t padding = 0;
+
+		template<typename StorageT>
+		void writePacked(StorageT &chunks, std::ostream &out, IndexHeader &h){
+			auto parts = encodePacked(chunks, h);
+
+			out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+			for(auto &part: parts){
+				out.write(reinterpret_cast<const char *>(part.frames.data()), part.frames.size() * sizeof(part.frames[0]));
+			}
+			for(auto &part: parts){
+				out.write(reinterpret_cast<const char *>(part.payload.data()), part.payload.size());
+			}
+			out.write(reinterpret_cast<const char *>(&padding), sizeof(padding));
+		}
+
+		template<typename StorageT>
+		void writePacked(StorageT &chunks, int fd, uint64_t pos, IndexHeader &h){
+			auto parts = encodePacked(chunks, h);
+
+			std::vector<uint64_t> framesPositions(parts.size()), payloadPositions(parts.size());
+			uint64_t tableStart = pos + sizeof(h);
+			uint64_t framesCount = 0;
+			for(size_t i = 0; i < parts.size(); ++i){
+				framesPositions[i] = tableStart + framesCount * sizeof(PackedFrameEntry);
+				framesCount += parts[i].frames.size();
+			}
+			uint64_t payloadStart = tableStart + framesCount * sizeof(PackedFrameEntry);
+			uint64_t payloadSize = 0;
+			for(size_t i = 0; i < parts.size(); ++i){
+				payloadPositions[i] = payloadStart + payloadSize;
+				payloadSize += parts[i].payload.size();
+			}
+			uint64_t stop = payloadStart + payloadSize + sizeof(padding);
+			if(ftruncate(fd, stop)){
+				throwErrno("Cannot extend the index");
+			}
+
+			pwriteFully(fd, &h, sizeof(h), pos);
+			runOnShares(parts.size(), [&](uint16_t id, size_t firstPart, size_t stopPart){
+				for(size_t i = firstPart; i < stopPart; ++i){
+					auto &part = parts[i];
+					pwriteFully(fd, part.frames.data(), part.frames.size() * sizeof(part.frames[0]), framesPositions[i]);
+					pwriteFully(fd, part.payload.data(), part.payload.size(), payloadPositions[i]);
+				}
+			}, parts.size());
+			pwriteFully(fd, &padding, sizeof(padding), stop - sizeof(padding));
+			lseek(fd, stop, SEEK_SET);
+		}
+
+		/// Offsets of the width of `OutT`, converted through a small buffer if the chunks store them in another width
+		template<typename OutT, typename ValueT, typename WriteT>
+		void writeConverted(const ValueT *offsets, size_t count, WriteT write){
+			if constexpr(std::is_same_v<OutT, ValueT>){
+				write(offsets, count * sizeof(OutT), 0);
+			} else {
+				std::vector<OutT> buf(std::min<size_t>(count, 64 * 1024));
+				for(size_t i = 0; i < count;){
+					size_t portion = std::min<size_t>(count - i, buf.size());
+					std::copy(offsets + i, offsets + i + portion, buf.data());
+					write(buf.data(), portion * sizeof(OutT), i * sizeof(OutT));
+					i += portion;
+				}
+			}
+		}
+
+		template<typename OutT, typename StorageT>
+		void writeChunks(StorageT &chunks, std::ostream &out){
+			for(auto &chunk: chunks){
+				writeConverted<OutT>(chunk->vec.data(), chunk->vec.size(), [&](const void *p, size_t size, size_t){
+					out.write(reinterpret_cast<const char *>(p), size);
+				});
+			}
+		}
+
+		/// A thread gets at least that much to write, writing small indices in parallel isn't worth starting the threads
+		const size_t minBytesPerThread = 4 * 1024 * 1024;
+
+		/*
+		With the threads placed, the thread N writes the blocks of the tasks the worker N of the scan has started with, on the same node, so the offsets are mostly read from the local memory. The blocks of a scan record that worker and the count of the workers the scan has actually had, which may differ from `getThreadsCount()` (a Scanner pool, an autotuned count).
+		Returns false if the blocks don't come from a single scan in order of their tasks, e.g. they come from several buffers of a stream.
+		*/
+		template<typename OutT, typename StorageT>
+		bool writeChunksByWorkers(StorageT &chunks, std::vector<uint64_t> &chunkStarts, int fd, uint64_t pos){
+			if(chunks.empty()){
+				return false;
+			}
+			uint16_t workersCount = chunks.front()->workersCount;
+			auto isOfTheScan = [&](auto &chunk){
+				return chunk->workersCount == workersCount;
+			};
+			auto byTasks = [](auto &a, auto &b){
+				return a->id < b->id;
+			};
+			if(!workersCount || !std::all_of(begin(chunks), end(chunks), isOfTheScan) || !std::is_sorted(begin(chunks), end(chunks), byTasks)){
+				return false;
+			}
+			std::vector<size_t> firstChunks(workersCount + 1);  // the workers of the blocks in order of the tasks are in order too
+			for(uint16_t i = 0; i <= workersCount; ++i){
+				firstChunks[i] = std::lower_bound(begin(chunks), end(chunks), i, [](auto &chunk, uint16_t worker){
+					return chunk->worker < worker;
+				}) - begin(chunks);
+			}
+
+			runOnShares(workersCount, [&](uint16_t id, size_t, size_t){
+				for(size_t i = firstChunks[id]; i < firstChunks[id + 1]; ++i){
+					auto &offsets = chunks[i]->vec;
+					uint64_t chunkPos = pos + chunkStarts[i] * sizeof(OutT);
+					writeConverted<OutT>(offsets.data(), offsets.size(), [&](const void *p, size_t size, size_t at){
+						pwriteFully(fd, p, size, chunkPos + at);
+					});
+				}
+			}, workersCount);
+			return true;
+		}
+
+		/// Each thread writes its slice of the offsets at its position computed from the sizes of the chunks before it
+		template<typename OutT, typename StorageT>
+		void writeChunks(StorageT &chunks, int fd, uint64_t pos){
+			auto chunkStarts = getChunkStarts(chunks);
+			uint64_t count = chunkStarts.back();
+			uint64_t stop = pos + count * sizeof(OutT);
+			if(ftruncate(fd, stop)){
+				throwErrno("Cannot extend the index");
+			}
+
+			uint16_t threadsCount = std::clamp<uint64_t>(count * sizeof(OutT) / minBytesPerThread, 1, getThreadsCount());
+			if(threadsCount > 1 && getThreadPlacement() != ThreadPlacement::OS && writeChunksByWorkers<OutT>(chunks, chunkStarts, fd, pos)){
+				lseek(fd, stop, SEEK_SET);
+				return;
+			}
+			runOnShares(count, [&](uint16_t id, size_t first, size_t last){
+				size_t chunk = std::upper_bound(begin(chunkStarts), end(chunkStarts), first) - begin(chunkStarts) - 1;
+				for(size_t i = first; i < last; ++chunk){
+					auto &offsets = chunks[chunk]->vec;
+					size_t inChunk = i - chunkStarts[chunk];
+					size_t portion = std::min<size_t>(offsets.size() - inChunk, last - i);
+					uint64_t portionPos = pos + i * sizeof(OutT);
+					writeConverted<OutT>(offsets.data() + inChunk, portion, [&](const void *p, size_t size, size_t at){
+						pwriteFully(fd, p, size, portionPos + at);
+					});
+					i += portion;
+				}
+			}, threadsCount);
+			lseek(fd, stop, SEEK_SET);
+		}
+
+		/// The narrowest width fitting the data, if its size is unknown, the widest
+		uint8_t getFlatOffsetWidth(const IndexHeader &h){
+			return h.count && !h.dataSize ? sizeof(uint64_t) : getOffsetWidth(h.dataSize);
+		}
+
+		template<typename StorageT>
+		void writeIndexOf(StorageT &chunks, std::ostream &out, IndexHeader &h){
+			using ValueT = typename StorageT::value_type::element_type::value_type;
+			h.count = 0;
+			switch(h.format){
+				case IndexFormat::Raw:
+					writeChunks<uint64_t>(chunks, out);
+				break;
+				case IndexFormat::Flat:
+					for(auto &chunk: chunks){
+						h.count += chunk->vec.size();
+					}
+					h.frameSize = getFlatOffsetWidth(h);
+					out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+					if(h.frameSize == sizeof(uint32_t)){
+						writeChunks<uint32_t>(chunks, out);
+					} else {
+						writeChunks<uint64_t>(chunks, out);
+					}
+				break;
+				case IndexFormat::Packed:
+					writePacked(chunks, out, h);
+				break;
+				case IndexFormat::Fields:
+					if constexpr(std::is_same_v<ValueT, uint64_t>){
+						writeFields(chunks, out, h);
+						break;
+					}
+					throw std::logic_error("Fields index needs the tagged 8-byte offsets");
+				case IndexFormat::Sparse:
+					throw std::logic_error("Sparse index is built from the data, use writeSparseIndex");
+				default:
+					throw std::logic_error("Unknown index format");
+			}
+		}
+
+		template<typename StorageT>
+		void writeIndexOf(StorageT &chunks, int fd, IndexHeader &h){
+			using ValueT = typename StorageT::value_type::element_type::value_type;
+			off_t pos = lseek(fd, 0, SEEK_CUR);
+			if(pos < 0){
+				throwErrno("The index must be written into a seekable file");
+			}
+			if(fcntl(fd, F_GETFL) & O_APPEND){
+				throw std::invalid_argument("pwrite ignores the offset for files opened with O_APPEND");
+			}
+			h.count = 0;
+			switch(h.format){
+				case IndexFormat::Raw:
+					writeChunks<uint64_t>(chunks, fd, pos);
+				break;
+				case IndexFormat::Flat:
+					for(auto &chunk: chunks){
+						h.count += chunk->vec.size();
+					}
+					h.frameSize = getFlatOffsetWidth(h);
+					if(h.frameSize == sizeof(uint32_t)){
+						writeChunks<uint32_t>(chunks, fd, pos + sizeof(h));
+					} else {
+						writeChunks<uint64_t>(chunks, fd, pos + sizeof(h));
+					}
+					pwriteFully(fd, &h, sizeof(h), pos);
+				break;
+				case IndexFormat::Packed:
+					writePacked(chunks, fd, pos, h);
+				break;
+				case IndexFormat::Fields:
+					if constexpr(std::is_same_v<ValueT, uint64_t>){
+						writeFields(chunks, fd, pos, h);
+						break;
+					}
+					throw std::logic_error("Fields index needs the tagged 8-byte offsets");
+				case IndexFormat::Sparse:
+					throw std::logic_error("Sparse index is built from the data, use writeSparseIndex");
+				default:
+					throw std::logic_error("Unknown index format");
+			}
+		}
+	};
+
+	void writeIndex(NBST &chunks, std::ostream &out, IndexFormat format, uint64_t dataSize){
+		writeIndex(chunks, out, IndexHeader{format, 0, dataSize});
+	}
+
+	void writeIndex(NBST &chunks, std::ostream &out, IndexHeader h){
+		writeIndexOf(chunks, out, h);
+	}
+
+	void writeIndex(NarrowNBST &chunks, std::ostream &out, IndexHeader h){
+		writeIndexOf(chunks, out, h);
+	}
+
+	bool isParallelWritable(int fd){
+		struct stat st;
+		return !fstat(fd, &st) && S_ISREG(st.st_mode) && !(fcntl(fd, F_GETFL) & O_APPEND);
+	}
+
+	void writeIndex(NBST &chunks, int fd, IndexHeader h){
+		writeIndexOf(chunks, fd, h);
+	}
+
+	void writeIndex(NarrowNBST &chunks, int fd, IndexHeader h){
+		writeIndexOf(chunks, fd, h);
+	}
+};
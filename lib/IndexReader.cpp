@@ -0,0 +1,489 @@
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#include <ScanBytes/IndexReader.hpp>
+#include "DetectorScanner.hpp"
+#include "FileIO.hpp"
+
+namespace ScanBytes{
+
+	namespace {
+		/// `p` must be followed by at least 8 readable bytes, which is guaranteed by the padding of Packed format
+		inline uint64_t extractBits(const uint8_t *p, uint64_t bitPos, uint8_t width){
+			const uint8_t *w = p + bitPos / 8;
+			uint8_t shift = bitPos % 8;
+			uint64_t v;
+			memcpy(&v, w, sizeof(v));
+			v >>= shift;
+			if(shift + width > 64){
+				v |= static_cast<uint64_t>(w[8]) << (64 - shift);
+			}
+			return width == 64 ? v : v & ((uint64_t(1) << width) - 1);
+		}
+
+		/// Whether `count` items of `size` bytes fit into the mapping after `offset`
+		inline bool fits(size_t mapSize, uint64_t offset, uint64_t count, uint64_t size){
+			return offset <= mapSize && count <= (mapSize - offset) / size;
+		}
+
+		[[noreturn]] void throwCorrupt(const std::string &what){
+			throw std::runtime_error("The index is truncated or corrupt: " + what);
+		}
+	};
+
+	/// Finds the offsets within the blocks of the data of a Sparse index and keeps the ones of the last block
+	struct IndexReader::Rescanner{
+		static constexpr uint64_t noBlock = std::numeric_limits<uint64_t>::max();
+
+		std::unique_ptr<DetectorScanner> detector; // built on the first rescan
+		ScannableT data;
+		int dataFd = -1;
+
+		uint64_t block = noBlock; // the one `offsets` are of
+		std::vector<uint64_t> offsets;
+		std::vector<uint8_t> buffer; // the block read from `dataFd`
+		std::vector<uint32_t> windowOffsets, altOffsets;
+
+		Rescanner(): windowOffsets(scanWindowSize), altOffsets(scanWindowSize){}
+
+		ScannableT read(uint64_t start, uint64_t size){
+			if(data.data()){
+				return data.subspan(start, size);
+			}
+			if(dataFd < 0){
+				throw std::logic_error("Sparse index needs the data attached to find the offsets");
+			}
+			buffer.resize(size);
+			for(uint64_t got = 0; got < size;){
+				ssize_t r = pread(dataFd, buffer.data() + got, size - got, start + got);
+				if(r < 0){
+					if(errno == EINTR){
+						continue;
+					}
+					throwErrno("Cannot read the data");
+				}
+				if(!r){
+					throw std::runtime_error("The data is shorter than the indexed one");
+				}
+				got += r;
+			}
+			return ScannableT{buffer};
+		}
+	};
+
+	IndexReader::IndexReader(const std::string &path, uint64_t dataSize): offsets(nullptr), narrowOffsets(nullptr), frames(nullptr), payload(nullptr), recordEntries(nullptr), fieldOffsets(nullptr), checkpoints(nullptr){
+		fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if(fd < 0){
+			throwErrno("Cannot open index " + path);
+		}
+		struct stat st;
+		if(fstat(fd, &st)){
+			close(fd);
+			throwErrno("Cannot stat index " + path);
+		}
+		mapSize = st.st_size;
+		map = nullptr;
+		if(mapSize){
+			map = static_cast<const uint8_t *>(mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, 0));
+			if(map == MAP_FAILED){
+				close(fd);
+				throwErrno("Cannot map index " + path);
+			}
+			madvise(const_cast<uint8_t *>(map), mapSize, MADV_RANDOM);
+		}
+
+		try{
+			parse(dataSize);
+		} catch(...){
+			if(map){
+				munmap(const_cast<uint8_t *>(map), mapSize);
+			}
+			close(fd);
+			throw;
+		}
+	}
+
+	/// Every table the lookups read from is checked to be within the mapping, so a truncated or corrupt index throws instead of crashing
+	void IndexReader::parse(uint64_t dataSize){
+		if(mapSize < sizeof(IndexHeader) || memcmp(map, IndexHeader::signatureValue, sizeof(IndexHeader::signatureValue))){
+			header = IndexHeader{IndexFormat::Raw, mapSize / sizeof(uint64_t), dataSize};
+			offsets = reinterpret_cast<const uint64_t *>(map);
+			return;
+		}
+
+		memcpy(&header, map, sizeof(header));
+		header.validate();
+		if(!header.dataSize && header.format != IndexFormat::Sparse){  // the blocks of Sparse ones depend on it
+			header.dataSize = dataSize;
+		}
+		const uint64_t tables = sizeof(IndexHeader);
+		switch(header.format){
+			case IndexFormat::Flat:
+				if(header.frameSize != sizeof(uint32_t) && header.frameSize != sizeof(uint64_t)){
+					throwCorrupt("invalid width of the offsets");
+				}
+				if(!fits(mapSize, tables, header.count, header.frameSize)){
+					throwCorrupt("the offsets exceed the file");
+				}
+				if(header.frameSize == sizeof(uint32_t)){
+					narrowOffsets = reinterpret_cast<const uint32_t *>(map + tables);
+				} else {
+					offsets = reinterpret_cast<const uint64_t *>(map + tables);
+				}
+			break;
+			case IndexFormat::Packed:{
+				if(!header.frameSize){
+					throwCorrupt("no frame size");
+				}
+				uint64_t framesCount = header.count / header.frameSize + (header.count % header.frameSize != 0);
+				if(!fits(mapSize, tables, framesCount, sizeof(PackedFrameEntry))){
+					throwCorrupt("the skip table exceeds the file");
+				}
+				frames = reinterpret_cast<const PackedFrameEntry *>(map + tables);
+				payload = reinterpret_cast<const uint8_t *>(frames + framesCount);
+				if(!fits(mapSize, payload - map, sizeof(uint64_t), 1)){
+					throwCorrupt("no padding after the payload");
+				}
+				if(framesCount){
+					framePayload(framesCount - 1);  // the frames are in order, so a truncated payload cuts the last one
+				}
+			}
+			break;
+			case IndexFormat::Fields:{
+				if(header.frameSize != sizeof(uint16_t) && header.frameSize != sizeof(uint32_t) && header.frameSize != sizeof(uint64_t)){
+					throwCorrupt("invalid width of the field offsets");
+				}
+				if(header.count > std::numeric_limits<uint64_t>::max() - 2 || !fits(mapSize, tables, header.count + 2, sizeof(FieldsRecordEntry))){
+					throwCorrupt("the records table exceeds the file");
+				}
+				recordEntries = reinterpret_cast<const FieldsRecordEntry *>(map + tables);
+				fieldOffsets = reinterpret_cast<const uint8_t *>(recordEntries + header.count + 2);
+				if(!fits(mapSize, fieldOffsets - map, recordEntries[header.count + 1].firstField, header.frameSize)){
+					throwCorrupt("the field offsets exceed the file");
+				}
+			}
+			break;
+			case IndexFormat::Sparse:{
+				if(!header.frameSize){
+					throwCorrupt("no block size");
+				}
+				if(header.backend == Backend::Unknown || header.backend == Backend::Auto || header.backend == Backend::CSVQuoted || header.backend == Backend::Sequences){
+					throwCorrupt("no backend to rescan the blocks with");
+				}
+				uint64_t blocksCount = getBlocksCount();
+				if(!fits(mapSize, tables + sizeof(SparseAlphabet), blocksCount + 1, sizeof(uint64_t))){
+					throwCorrupt("the checkpoints exceed the file");
+				}
+				alphabet = reinterpret_cast<const SparseAlphabet *>(map + tables)->chars();
+				checkpoints = reinterpret_cast<const uint64_t *>(map + tables + sizeof(SparseAlphabet));
+				if(checkpoints[0] || checkpoints[blocksCount] != header.count){
+					throwCorrupt("the checkpoints don't match the count of the matches");
+				}
+				rescanner = std::make_unique<Rescanner>();
+			}
+			break;
+			default:
+				throw std::runtime_error("Unsupported index format");
+		}
+	}
+
+	uint64_t IndexReader::getBlocksCount() const{
+		return header.dataSize / header.frameSize + (header.dataSize % header.frameSize != 0);
+	}
+
+	const uint8_t *IndexReader::framePayload(uint64_t f) const{
+		uint64_t frameCount = std::min<uint64_t>(header.frameSize, header.count - f * header.frameSize);
+		uint64_t payloadSize = mapSize - (payload - map);
+		uint64_t payloadOffset = frames[f].payloadOffset;
+		if(payloadOffset >= payloadSize){
+			throwCorrupt("frame " + std::to_string(f) + " is out of the payload");
+		}
+		uint8_t width = payload[payloadOffset];
+		if(width > 64 || !fits(payloadSize, payloadOffset + 1, ((frameCount - 1) * width + 7) / 8 + sizeof(uint64_t), 1)){
+			throwCorrupt("frame " + std::to_string(f) + " is out of the payload");
+		}
+		return payload + payloadOffset;
+	}
+
+	IndexReader::~IndexReader(){
+		if(map){
+			munmap(const_cast<uint8_t *>(map), mapSize);
+		}
+		close(fd);
+	}
+
+	void IndexReader::attachData(ScannableT data){
+		if(!rescanner){
+			throw std::logic_error("Only Sparse indices need the data");
+		}
+		if(data.size() < header.dataSize){
+			throw std::runtime_error("The data is shorter than the indexed one");
+		}
+		rescanner->data = data;
+		rescanner->dataFd = -1;
+		rescanner->block = Rescanner::noBlock;
+	}
+
+	void IndexReader::attachData(int dataFd){
+		if(!rescanner){
+			throw std::logic_error("Only Sparse indices need the data");
+		}
+		rescanner->data = ScannableT{};
+		rescanner->dataFd = dataFd;
+		rescanner->block = Rescanner::noBlock;
+	}
+
+	const std::vector<uint64_t> &IndexReader::blockOffsets(uint64_t block) const{
+		auto &rs = *rescanner;
+		if(rs.block == block){
+			return rs.offsets;
+		}
+		if(block >= getBlocksCount()){
+			throwCorrupt("the checkpoints aren't sorted");
+		}
+		rs.block = Rescanner::noBlock;
+		uint64_t start = block * header.frameSize;
+		auto bytes = rs.read(start, std::min<uint64_t>(header.frameSize, header.dataSize - start));
+		if(!rs.detector){
+			auto chars = alphabet;
+			rs.detector = makeDetectorScanner(header.backend, chars);
+		}
+		ScanState state{.base = start};
+		rs.offsets.clear();
+		for(auto &chunk: rs.detector->scanInThisThread(bytes, state, rs.windowOffsets, rs.altOffsets)){
+			rs.offsets.insert(rs.offsets.end(), chunk->vec.begin(), chunk->vec.end());
+		}
+		if(rs.offsets.size() != checkpoints[block + 1] - checkpoints[block]){
+			throw std::runtime_error("The data doesn't match the index: block " + std::to_string(block) + " has " + std::to_string(rs.offsets.size()) + " matches instead of " + std::to_string(checkpoints[block + 1] - checkpoints[block]));
+		}
+		rs.block = block;
+		return rs.offsets;
+	}
+
+	uint64_t IndexReader::operator[](uint64_t n) const{
+		if(n >= header.count){
+			throw std::out_of_range("Delimiter index is out of range: " + std::to_string(n));
+		}
+		if(offsets){
+			return offsets[n];
+		}
+		if(narrowOffsets){
+			return narrowOffsets[n];
+		}
+		if(recordEntries){
+			return recordEntries[n + 1].start - 1;
+		}
+		if(checkpoints){
+			uint64_t block = std::upper_bound(checkpoints, checkpoints + getBlocksCount() + 1, n) - checkpoints - 1;
+			return blockOffsets(block)[n - checkpoints[block]];
+		}
+
+		uint64_t f = n / header.frameSize;
+		uint64_t inFrame = n % header.frameSize;
+		const uint8_t *framePayload = this->framePayload(f);
+		uint8_t width = framePayload[0];
+		++framePayload;
+
+		uint64_t res = frames[f].first;
+		if(width){
+			for(uint64_t i = 0; i < inFrame; ++i){
+				res += extractBits(framePayload, i * width, width);
+			}
+		}
+		return res;
+	}
+
+	void IndexReader::decodeAll(uint64_t *out) const{
+		if(offsets){
+			if(header.count){
+				memcpy(out, offsets, header.count * sizeof(*out));
+			}
+			return;
+		}
+		if(narrowOffsets){
+			std::copy(narrowOffsets, narrowOffsets + header.count, out);
+			return;
+		}
+		if(recordEntries){
+			for(uint64_t i = 0; i < header.count; ++i){
+				out[i] = recordEntries[i + 1].start - 1;
+			}
+			return;
+		}
+		if(checkpoints){
+			uint64_t blocksCount = getBlocksCount();
+			for(uint64_t block = 0; block < blocksCount; ++block){
+				if(checkpoints[block + 1] != checkpoints[block]){
+					auto &blockOffsets = this->blockOffsets(block);
+					out = std::copy(begin(blockOffsets), end(blockOffsets), out);
+				}
+			}
+			return;
+		}
+
+		uint64_t framesCount = (header.count + header.frameSize - 1) / header.frameSize;
+		for(uint64_t f = 0; f < framesCount; ++f){
+			uint64_t frameCount = std::min<uint64_t>(header.frameSize, header.count - f * header.frameSize);
+			const uint8_t *framePayload = this->framePayload(f);
+			uint8_t width = framePayload[0];
+			++framePayload;
+
+			uint64_t res = frames[f].first;
+			*(out++) = res;
+			for(uint64_t i = 1; i < frameCount; ++i){
+				if(width){
+					res += extractBits(framePayload, (i - 1) * width, width);
+				}
+				*(out++) = res;
+			}
+		}
+	}
+
+	uint64_t IndexReader::recordsCount() const{
+		uint64_t c = size();
+		if(checkpoints){  // without rescanning the last block
+			return header.dataSize && !(header.flags & endsWithMatch) ? c + 1 : c;
+		}
+		if(!c){
+			return header.dataSize ? 1 : 0;
+		}
+		return (*this)[c - 1] + 1 < header.dataSize ? c + 1 : c;
+	}
+
+	Record IndexReader::record(uint64_t n) const{
+		return records(n, n);
+	}
+
+	Record IndexReader::records(uint64_t first, uint64_t last) const{
+		if(first > last || last >= recordsCount()){
+			throw std::out_of_range("Records range is out of range: " + std::to_string(first) + ".." + std::to_string(last));
+		}
+		uint64_t start = first ? (*this)[first - 1] + 1 : 0;
+		uint64_t stop = last < size() ? (*this)[last] + 1 : header.dataSize;
+		return {start, stop - start};
+	}
+
+	uint64_t IndexReader::fieldsCount(uint64_t record) const{
+		if(!recordEntries){
+			throw std::logic_error("Only Fields indices have the offsets of the fields");
+		}
+		if(record >= recordsCount()){
+			throw std::out_of_range("Record index is out of range: " + std::to_string(record));
+		}
+		uint64_t first = recordEntries[record].firstField, next = recordEntries[record + 1].firstField;
+		if(next < first || next > recordEntries[header.count + 1].firstField){
+			throwCorrupt("the fields of record " + std::to_string(record) + " are out of the table");
+		}
+		return next - first + 1;
+	}
+
+	uint64_t IndexReader::fieldOffset(uint64_t n) const{
+		switch(header.frameSize){
+			case sizeof(uint16_t):{
+				uint16_t v;
+				memcpy(&v, fieldOffsets + n * sizeof(v), sizeof(v));
+				return v;
+			}
+			case sizeof(uint32_t):{
+				uint32_t v;
+				memcpy(&v, fieldOffsets + n * sizeof(v), sizeof(v));
+				return v;
+			}
+			default:{
+				uint64_t v;
+				memcpy(&v, fieldOffsets + n * sizeof(v), sizeof(v));
+				return v;
+			}
+		}
+	}
+
+	Record IndexReader::field(uint64_t record, uint64_t n) const{
+		uint64_t count = fieldsCount(record);
+		if(n >= count){
+			throw std::out_of_range("Field index is out of range: " + std::to_string(n));
+		}
+		auto &entry = recordEntries[record];
+		uint64_t start = n ? entry.start + fieldOffset(entry.firstField + n - 1) + 1 : entry.start;
+		uint64_t stop = n + 1 < count ? entry.start + fieldOffset(entry.firstField + n) : recordEntries[record + 1].start - 1;
+		return {start, stop - start};
+	}
+
+	void sendRange(int dataFd, uint64_t offset, uint64_t size, int outFd){
+		off_t off = offset;
+		while(size){
+			ssize_t sent = sendfile(outFd, dataFd, &off, size);
+			if(sent < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				if(errno == EINVAL || errno == ENOSYS){
+					break;  // the kernel cannot sendfile into this kind of outFd, splice it through a pipe
+				}
+				throwErrno("sendfile failed");
+			}
+			if(!sent){
+				throw std::runtime_error("Unexpected end of the data file");
+			}
+			size -= sent;
+		}
+		if(!size){
+			return;
+		}
+
+		loff_t spliceOff = off;
+		while(size){
+			ssize_t sent = splice(dataFd, &spliceOff, outFd, nullptr, size, SPLICE_F_MORE);
+			if(sent < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				if(errno == EINVAL){
+					break;
+				}
+				throwErrno("splice failed");
+			}
+			if(!sent){
+				throw std::runtime_error("Unexpected end of the data file");
+			}
+			size -= sent;
+		}
+
+		// neither works, copying through a buffer
+		off = spliceOff;
+		char buf[64 * 1024];
+		while(size){
+			ssize_t got = pread(dataFd, buf, std::min<uint64_t>(size, sizeof(buf)), off);
+			if(got < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				throwErrno("pread failed");
+			}
+			if(!got){
+				throw std::runtime_error("Unexpected end of the data file");
+			}
+			for(ssize_t written = 0; written < got;){
+				ssize_t w = write(outFd, buf + written, got - written);
+				if(w < 0){
+					if(errno == EINTR){
+						continue;
+					}
+					throwErrno("write failed");
+				}
+				written += w;
+			}
+			off += got;
+			size -= got;
+		}
+	}
+};
@@ -0,0 +1,170 @@
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <type_traits>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <ScanBytes/IndexFormat.hpp>
+#include <ScanBytes/IndexReader.hpp>
+#include "FileIO.hpp"
+#include "SparseIndex.hpp"
+
+namespace ScanBytes{
+
+	namespace {
+		struct FileCloser{
+			int fd;
+
+			~FileCloser(){
+				close(fd);
+			}
+		};
+
+		/// The new offsets go after the old ones, the header is written the last, so an interrupted update leaves the old index valid
+		template<typename OffsetT>
+		void appendFlat(int fd, IndexHeader &h, NBST &added){
+			uint64_t pos = sizeof(IndexHeader) + h.count * sizeof(OffsetT);
+			std::vector<OffsetT> buf;
+			for(auto &chunk: added){
+				auto &offsets = chunk->vec;
+				const void *p = offsets.data();
+				if constexpr(!std::is_same_v<OffsetT, uint64_t>){
+					buf.assign(offsets.begin(), offsets.end());
+					p = buf.data();
+				}
+				auto s = offsets.size() * sizeof(OffsetT);
+				if(s){
+					pwriteFully(fd, p, s, pos);
+					pos += s;
+					h.count += offsets.size();
+				}
+			}
+			if(ftruncate(fd, pos)){
+				throwErrno("Cannot truncate the index");
+			}
+			pwriteFully(fd, &h, sizeof(h), 0);
+		}
+
+		/// Packed indices cannot be appended to in place, as well as Flat ones whose offsets outgrow 4 bytes
+		void rewriteIndex(const std::string &indexPath, IndexHeader &h, NBST &added){
+			NBST all;
+			{
+				IndexReader r{indexPath};
+				auto old = std::make_unique<NumbersAllocator::NBT>(0, r.size());
+				r.decodeAll(old->vec.data());
+				all.emplace_back(std::move(old));
+			}
+			for(auto &chunk: added){
+				all.emplace_back(std::move(chunk));
+			}
+
+			std::string tmpPath = indexPath + ".tmp";
+			{
+				std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+				writeIndex(all, out, h);
+				out.close();
+				if(!out){
+					throw std::runtime_error("Cannot write " + tmpPath);
+				}
+			}
+			if(rename(tmpPath.c_str(), indexPath.c_str())){
+				throwErrno("Cannot replace " + indexPath);
+			}
+		}
+
+		/// The checkpoints of the complete old blocks stay, the incomplete last one is counted again with the appended bytes following it. Its checkpoint is overwritten before the header, so an interrupted update is detected by the rescan of that block rather than leaving the old index valid.
+		uint64_t appendSparse(int fd, IndexHeader &h, ScannableT data, std::vector<uint8_t> &charsToScanFor){
+			SparseAlphabet alphabet, expected{charsToScanFor};
+			if(pread(fd, &alphabet, sizeof(alphabet), sizeof(IndexHeader)) != sizeof(alphabet) || !h.frameSize){
+				throw std::runtime_error("The index is truncated");
+			}
+			if(alphabet != expected){
+				throw std::runtime_error("The index was built for another alphabet");
+			}
+
+			uint64_t firstBlock = h.dataSize / h.frameSize;
+			uint64_t pos = sizeof(IndexHeader) + sizeof(SparseAlphabet) + firstBlock * sizeof(uint64_t);
+			std::vector<uint64_t> checkpoints(1);
+			if(pread(fd, checkpoints.data(), sizeof(uint64_t), pos) != sizeof(uint64_t)){
+				throw std::runtime_error("The index is truncated");
+			}
+			appendCheckpoints(data.subspan(firstBlock * h.frameSize), charsToScanFor, resolveSparseBackend(h.backend, charsToScanFor), h.frameSize, checkpoints);
+
+			pos += sizeof(uint64_t);
+			uint64_t s = (checkpoints.size() - 1) * sizeof(uint64_t);
+			if(s){
+				pwriteFully(fd, checkpoints.data() + 1, s, pos);
+			}
+			if(ftruncate(fd, pos + s)){
+				throwErrno("Cannot truncate the index");
+			}
+			uint64_t addedCount = checkpoints.back() - h.count;
+			h.count = checkpoints.back();
+			h.setData(data);
+			setEndsWithMatch(h, data, alphabet);
+			pwriteFully(fd, &h, sizeof(h), 0);
+			return addedCount;
+		}
+	};
+
+	uint64_t updateIndex(const std::string &indexPath, ScannableT data, std::vector<uint8_t> charsToScanFor, Backend b){
+		int fd = open(indexPath.c_str(), O_RDWR | O_CLOEXEC);
+		if(fd < 0){
+			throwErrno("Cannot open index " + indexPath);
+		}
+		FileCloser closer{fd};
+
+		IndexHeader h;
+		if(pread(fd, &h, sizeof(h), 0) != sizeof(h) || memcmp(h.signature, IndexHeader::signatureValue, sizeof(h.signature))){
+			throw std::runtime_error("Raw indices have no header and cannot be updated, rebuild the index instead");
+		}
+		h.validate();
+		if(h.format != IndexFormat::Flat && h.format != IndexFormat::Packed && h.format != IndexFormat::Sparse){
+			throw std::runtime_error("Unsupported index format");
+		}
+		if(h.dataSize && !h.tailSize){
+			throw std::runtime_error("The index has no fingerprint of the data (it was built from a stream), rebuild it instead");
+		}
+		if(!h.isPrefixOf(data)){
+			throw std::runtime_error("The data has been changed or truncated since it was indexed, rebuild the index instead");
+		}
+		if(h.format == IndexFormat::Sparse){
+			return appendSparse(fd, h, data, charsToScanFor);
+		}
+
+		ScanState state{.base = h.dataSize, .inQuote = static_cast<bool>(h.flags & endsInQuote)};
+		if(b == Backend::Sequences){
+			// to find the ones spanning the old end, the matches go on right after the last one indexed
+			state.tailSize = std::min<uint64_t>(h.dataSize, maxSequenceLength - 1);
+			memcpy(state.tail, data.data() + h.dataSize - state.tailSize, state.tailSize);
+			IndexReader r{indexPath, h.dataSize};
+			if(r.size()){
+				state.sequencesFrom = r[r.size() - 1] + 1;
+			}
+		}
+		NBST added;
+		uint64_t addedCount = 0;
+		if(data.size() > h.dataSize){
+			added = scan(data.subspan(h.dataSize), charsToScanFor, b, state);
+			for(auto &chunk: added){
+				addedCount += chunk->vec.size();
+			}
+		}
+
+		h.setData(data);
+		h.flags = state.inQuote ? (h.flags | endsInQuote) : (h.flags & ~endsInQuote);
+		if(h.format == IndexFormat::Packed || (h.frameSize == sizeof(uint32_t) && getOffsetWidth(h.dataSize) > sizeof(uint32_t))){
+			rewriteIndex(indexPath, h, added);
+		} else if(h.frameSize == sizeof(uint32_t)){
+			appendFlat<uint32_t>(fd, h, added);
+		} else {
+			appendFlat<uint64_t>(fd, h, added);
+		}
+		return addedCount;
+	}
+};
@@ -1,9 +1,44 @@
+#include <algorithm>
+#include <new>
+
+#include <sys/mman.h>
+
 #include <ScanBytes/MultiThreadedOrderedAppendOnlyAllocator.hpp>
-//#include "mio.hpp"
+#include "Stats.hpp"
+
+template<typename ValueT>
+Arena<ValueT>::Arena(size_t capacity): capacity(capacity){
+	size_t bytes = capacity * sizeof(ValueT);
+	if(bytes >= mmapThreshold){
+		void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if(map == MAP_FAILED){
+			throw std::bad_alloc();
+		}
+		values = static_cast<ValueT *>(map);
+	} else {
+		values = static_cast<ValueT *>(::operator new(bytes));
+	}
+}
+
+template<typename ValueT>
+Arena<ValueT>::~Arena(){
+	size_t bytes = capacity * sizeof(ValueT);
+	if(bytes >= mmapThreshold){
+		munmap(values, bytes);
+	} else {
+		::operator delete(values);
+	}
+}
+
+template<typename ValueT>
+ValueBlock<ValueT>::ValueBlock(uint32_t id, VecT vec): id(id), vec(std::move(vec)){
+}
 
 template<typename ValueT>
-ValueBlock<ValueT>::ValueBlock(uint16_t id, size_t allocSize): id(id), vec(allocSize){
-	vec.resize(0);
+ValueBlock<ValueT>::ValueBlock(uint32_t id, size_t size): id(id){
+	vec.arena = std::make_shared<Arena<ValueT>>(std::max<size_t>(size, 1));
+	vec.ptr = vec.arena->values;
+	vec.count = size;
 }
 
 template<typename ValueT>
@@ -11,18 +46,15 @@ std::strong_ordering ValueBlock<ValueT>::operator<=>(const ValueBlock &b) const{
 	auto cmp = id <=> b.id;
 	if (cmp != std::strong_ordering::equal){
 		return cmp;
+	} else if (vec.empty() || b.vec.empty()){
+		return b.vec.empty() <=> vec.empty();
 	} else {
 		return vec[0] <=> b.vec[0];
 	}
 }
 
 template<typename ValueT>
-size_t MTOAOA<ValueT>::page_size = 4 * 1024;
-
-template<typename ValueT>
-ThreadAllocator<ValueT>::ThreadAllocator(uint16_t id, MTOAOA<ValueT> &parent): id(id), parent(parent) {
-	allocSize = parent.page_size;
-	reserveBlock();
+ThreadAllocator<ValueT>::ThreadAllocator(uint32_t id, MTOAOA<ValueT> &parent): id(id), parent(parent) {
 }
 
 template<typename ValueT>
@@ -32,44 +64,61 @@ ThreadAllocator<ValueT>::~ThreadAllocator(){
 
 template<typename ValueT>
 void ThreadAllocator<ValueT>::finalize(){
+	cutBlock();
+	if(blocks.empty()){
+		return;
+	}
+	uint64_t waitStart = ScanBytes::statsCompiledIn ? ScanBytes::nowNs() : 0;
+	std::lock_guard<std::mutex> guard(parent.lock);
+	if constexpr(ScanBytes::statsCompiledIn){
+		stats.lockWaitNs += ScanBytes::nowNs() - waitStart;
+	}
+	for(auto &block: blocks){
+		parent.chunks.emplace_back(std::move(block));
+	}
+	blocks.clear();
 }
 
 template<typename ValueT>
-void ThreadAllocator<ValueT>::reserveBlock(){
-	reserveBlock(allocSize);
+void ThreadAllocator<ValueT>::cutBlock(){
+	if(cur != blockStart){
+		++stats.blocks;
+		stats.values += cur - blockStart;
+		blocks.emplace_back(std::make_unique<ValueBlock<ValueT>>(id, ArenaSpan<ValueT>{arena, blockStart, static_cast<size_t>(cur - blockStart)}));
+		blockStart = cur;
+	}
 }
 
 template<typename ValueT>
-void ThreadAllocator<ValueT>::reserveBlock(size_t allocSize){
-	mySpan = parent.reserveBlock(id, allocSize);
-	consumed = allocSize;
+void ThreadAllocator<ValueT>::startTask(uint32_t taskId){
+	cutBlock();
+	id = taskId;
 }
 
 template<typename ValueT>
-void ThreadAllocator<ValueT>::append(uint64_t num){
-	auto & v = (*mySpan).vec;
-	v.emplace_back(num);
-	if(v.size() == v.capacity()){
-		reserveBlock();
-	}
+void ThreadAllocator<ValueT>::grow(size_t needed){
+	cutBlock();
+	size_t capacity = arena ? arena->capacity * 2 : parent.arenaCapacity;
+	arena = std::make_shared<Arena<ValueT>>(std::max(capacity, needed));
+	++stats.arenas;
+	blockStart = cur = arena->values;
+	end = arena->values + arena->capacity;
 }
 
 template<typename ValueT>
-MTOAOA<ValueT>::MTOAOA(){}
+MTOAOA<ValueT>::MTOAOA(size_t expectedPerThread): arenaCapacity(std::max<size_t>(expectedPerThread, 1)){}
 
 template<typename ValueT>
-typename MTOAOA<ValueT>::TAllocT MTOAOA<ValueT>::getForThread(uint16_t id){
+typename MTOAOA<ValueT>::TAllocT MTOAOA<ValueT>::getForThread(uint32_t id){
 	return ThreadAllocator<ValueT>(id, *this);
 }
 
-template<typename ValueT>
-typename MTOAOA<ValueT>::NBT *MTOAOA<ValueT>::reserveBlock(uint16_t id, size_t allocSize){
-	lock.lock();
-	auto res = &*chunks.emplace_back(std::make_unique<NBT>(id, allocSize));
-	lock.unlock();
-	return res;
-}
-
+template struct Arena<uint64_t>;
 template struct ValueBlock<uint64_t>;
 template struct MTOAOA<uint64_t>;
 template struct ThreadAllocator<uint64_t>;
+
+template struct Arena<uint32_t>;
+template struct ValueBlock<uint32_t>;
+template struct MTOAOA<uint32_t>;
+template struct ThreadAllocator<uint32_t>;
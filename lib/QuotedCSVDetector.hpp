@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+
+#include "kernels/Kernels.hpp"
+
+/*
+RFC 4180 CSV: reports only the delimiters which are not within quoted fields.
+Quoting state is tracked as a mask computed with prefix XOR of the quotes bit mask, the doubled quotes used for escaping toggle it twice, so they need no special handling.
+A thread doesn't know whether its share starts within quotes, so it assumes it doesn't and puts the delimiters within quotes aside. If the assumption turns out to be wrong, the put aside ones are the right ones, see `scan`.
+*/
+struct QuotedCSVDetector{
+	static constexpr uint8_t quote = '"';
+
+	ScanBytes::Kernels::QuotedParams params;
+	ScanBytes::Kernels::QuotedKernelT kernel = nullptr;
+	ScanBytes::Kernels::QuotedCountKernelT countKernel = nullptr;
+	uint8_t count;
+
+	inline QuotedCSVDetector(std::vector<uint8_t> &v){
+		if(v.size() > ScanBytes::Kernels::maxQuotedDelimiters){
+			throw std::logic_error("Quoted CSV backend supports only 1-3 delimiters");
+		}
+		count = v.size();
+		for(size_t i = 0; i < ScanBytes::Kernels::maxQuotedDelimiters; ++i){
+			params.delimiters[i] = v[i < count ? i : 0];
+			if(params.delimiters[i] == quote){
+				throw std::logic_error("Quote char cannot be a delimiter");
+			}
+		}
+		params.quote = quote;
+
+		#ifdef SCANBYTES_SIMD_SUPPORTED
+		auto kernels = ScanBytes::Kernels::getKernels(ScanBytes::getTier());
+		if(kernels){
+			kernel = kernels->quoted[count - 1];
+			countKernel = kernels->quotedCount[count - 1];
+		}
+		#endif
+	}
+
+	inline bool operator()(uint8_t c){
+		for(uint8_t i = 0; i < count; ++i){
+			if(params.delimiters[i] == c){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// `inQuote` is all ones within quotes and 0 otherwise. Both buffers must have space for `scanWindowSize` offsets.
+	inline uint32_t *scanWindow(const uint8_t *begin, const uint8_t *end, uint32_t *out, uint32_t *&altOut, uint64_t &inQuote){
+		const uint8_t *blocksEnd = begin;
+		if(kernel){
+			blocksEnd += (end - begin) & ~(ScanBytes::Kernels::blockSize - 1);
+			out = kernel(params, begin, blocksEnd, out, altOut, inQuote);
+		}
+
+		uint32_t offset = blocksEnd - begin;
+		for(const uint8_t *p = blocksEnd; p < end; ++p, ++offset){
+			if(*p == quote){
+				inQuote = ~inQuote;
+			} else if((*this)(*p)){
+				if(inQuote){
+					*(altOut++) = offset;
+				} else {
+					*(out++) = offset;
+				}
+			}
+		}
+		return out;
+	}
+
+	/// Like `scanWindow`, but only counts, the count of the delimiters within quotes is added to `altCount`
+	inline uint64_t countRange(const uint8_t *begin, const uint8_t *end, uint64_t &altCount, uint64_t &inQuote){
+		const uint8_t *blocksEnd = begin;
+		uint64_t count = 0;
+		if(countKernel){
+			blocksEnd += (end - begin) & ~(ScanBytes::Kernels::blockSize - 1);
+			count = countKernel(params, begin, blocksEnd, altCount, inQuote);
+		}
+
+		for(const uint8_t *p = blocksEnd; p < end; ++p){
+			if(*p == quote){
+				inQuote = ~inQuote;
+			} else if((*this)(*p)){
+				if(inQuote){
+					++altCount;
+				} else {
+					++count;
+				}
+			}
+		}
+		return count;
+	}
+};
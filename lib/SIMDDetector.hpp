@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+
+#include "kernels/Kernels.hpp"
+
+/*
+Detectors having `scanWindow` are not called for every byte. Instead `scan` feeds them windows of `scanWindowSize` bytes and they write offsets of the matches (relative to the beginning of the window) into a buffer.
+The buffer must have space for `scanWindowSize` offsets.
+*/
+const size_t scanWindowSize = 16 * 1024;
+
+#ifdef SCANBYTES_SIMD_SUPPORTED
+
+	/// Base of the detectors running the SIMD kernels of the active tier on the whole blocks and checking the rest with `operator()`. Without a kernel every byte is checked with it.
+	template <typename DetectorT>
+	struct TieredDetector{
+		inline uint32_t *scanTail(const uint8_t *p, const uint8_t *end, uint32_t offset, uint32_t *out){
+			auto &self = *static_cast<DetectorT *>(this);
+			for(; p < end; ++p, ++offset){
+				if(self(*p)){
+					*(out++) = offset;
+				}
+			}
+			return out;
+		}
+
+		/// The whole blocks go to the kernel, all the bytes if there is none
+		inline const uint8_t *getBlocksEnd(const uint8_t *begin, const uint8_t *end){
+			auto &self = *static_cast<DetectorT *>(this);
+			return self.kernel ? begin + ((end - begin) & ~(ScanBytes::Kernels::blockSize - 1)) : begin;
+		}
+
+		inline uint32_t *scanWindow(const uint8_t *begin, const uint8_t *end, uint32_t *out){
+			auto &self = *static_cast<DetectorT *>(this);
+			const uint8_t *blocksEnd = getBlocksEnd(begin, end);
+			if(blocksEnd != begin){
+				out = self.kernel(self.params, begin, blocksEnd, out);
+			}
+			return scanTail(blocksEnd, end, blocksEnd - begin, out);
+		}
+
+		/// Count of the matches in [begin, end), no window size limit since nothing is written
+		inline uint64_t countRange(const uint8_t *begin, const uint8_t *end){
+			auto &self = *static_cast<DetectorT *>(this);
+			const uint8_t *blocksEnd = getBlocksEnd(begin, end);
+			uint64_t count = blocksEnd != begin ? self.countKernel(self.params, begin, blocksEnd) : 0;
+			for(const uint8_t *p = blocksEnd; p < end; ++p){
+				count += self(*p);
+			}
+			return count;
+		}
+	};
+
+	/// Compares 64-byte blocks against an alphabet of 1-4 chars and extracts offsets from the resulting bit masks.
+	struct SIMDCharsDetector: public TieredDetector<SIMDCharsDetector>{
+		static constexpr size_t maxChars = ScanBytes::Kernels::maxCompareChars;
+
+		ScanBytes::Kernels::CompareParams params;
+		ScanBytes::Kernels::CompareKernelT kernel;
+		ScanBytes::Kernels::CompareCountKernelT countKernel;
+		uint8_t count;
+
+		static inline bool isSupported(){
+			return ScanBytes::Kernels::getKernels(ScanBytes::getTier());
+		}
+
+		inline SIMDCharsDetector(std::vector<uint8_t> &v){
+			if(v.size() > maxChars){
+				throw std::logic_error("SIMD backend supports only alphabets of 1-4 chars");
+			}
+			auto kernels = ScanBytes::Kernels::getKernels(ScanBytes::getTier());
+			if(!kernels){
+				throw std::logic_error("SIMD backend is not available in the Scalar tier");
+			}
+			count = v.size();
+			for(size_t i = 0; i < maxChars; ++i){
+				params.charz[i] = v[i < count ? i : 0];
+			}
+			kernel = kernels->compare[count - 1];
+			countKernel = kernels->compareCount[count - 1];
+		}
+
+		inline bool operator()(uint8_t c){
+			for(uint8_t i = 0; i < count; ++i){
+				if(params.charz[i] == c){
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	/*
+	Classifies bytes against an arbitrary alphabet with two nibble-indexed shuffle tables, so the cost doesn't depend on the alphabet size.
+	A byte is split into its low nibble (used as an index into a table) and its high nibble. `lowTable` covers bytes < 0x80 and `highTable` covers bytes >= 0x80, a table entry contains a bit for every value of `(high nibble) & 7` present in the alphabet.
+	pshufb zeroes the lanes having the MSB of the index set, so the two lookups never overlap.
+	*/
+	struct ShuffleCharsDetector: public TieredDetector<ShuffleCharsDetector>{
+		ScanBytes::Kernels::ShuffleParams params;
+		ScanBytes::Kernels::ShuffleKernelT kernel;
+		ScanBytes::Kernels::ShuffleCountKernelT countKernel;
+
+		static inline bool isSupported(){
+			auto kernels = ScanBytes::Kernels::getKernels(ScanBytes::getTier());
+			return kernels && kernels->shuffle;
+		}
+
+		inline ShuffleCharsDetector(std::vector<uint8_t> &v){
+			if(!isSupported()){
+				throw std::logic_error("Shuffle backend requires SSSE3 tier or higher");
+			}
+			auto kernels = ScanBytes::Kernels::getKernels(ScanBytes::getTier());
+			kernel = kernels->shuffle;
+			countKernel = kernels->shuffleCount;
+
+			params = ScanBytes::Kernels::makeShuffleParams(v.data(), v.size());
+		}
+
+		inline bool operator()(uint8_t c){
+			uint8_t *table = c & 0x80 ? params.highTable : params.lowTable;
+			return table[c & 0x0F] & (1 << ((c >> 4) & 0x07));
+		}
+	};
+#endif
@@ -12,19 +12,38 @@
 #include <chrono>
 #include <utility>
 #include <functional>
+#include <atomic>
+#include <mutex>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
 
 #include <ScanBytes/ScanBytes.hpp>
 #include <ScanBytes/MultiThreadedOrderedAppendOnlyAllocator.hpp>
+#include <ScanBytes/Autotune.hpp>
 #include "CharDetector.hpp"
+#include "Threading.hpp"
+#include "DetectorScanner.hpp"
+#include "Stats.hpp"
 
 namespace ScanBytes{
 
 	template <Backend typeValue> struct GetBackendFromEnum{};
+	#ifdef SCANBYTES_JIT_SUPPORTED
 	template<> struct GetBackendFromEnum<Backend::JIT> {using type = JittedCharDetector;};
+	#endif
 	template<> struct GetBackendFromEnum<Backend::Fallback> {using type = FallbackCharDetector;};
 	template<> struct GetBackendFromEnum<Backend::LF> {using type = LineBreaksDetector;};
 	template<> struct GetBackendFromEnum<Backend::CSV> {using type = CSVDetector;};
 	template<> struct GetBackendFromEnum<Backend::TSV> {using type = TSVDetector;};
+	template<> struct GetBackendFromEnum<Backend::Space> {using type = SpacesDetector;};
+	template<> struct GetBackendFromEnum<Backend::Punct> {using type = PunctDetector;};
+	template<> struct GetBackendFromEnum<Backend::CSVQuoted> {using type = QuotedCSVDetector;};
+	template<> struct GetBackendFromEnum<Backend::Sequences> {using type = SequencesDetector;};
+	#ifdef SCANBYTES_SIMD_SUPPORTED
+	template<> struct GetBackendFromEnum<Backend::SIMD> {using type = SIMDCharsDetector;};
+	template<> struct GetBackendFromEnum<Backend::Shuffle> {using type = ShuffleCharsDetector;};
+	#endif
 
 
 	const char * backendNames[] = {
@@ -37,6 +56,11 @@ namespace ScanBytes{
 		"TSV",
 		"Space",
 		"Punct",
+		"SIMD",
+		"Shuffle",
+		"CSVQuoted",
+		"Sequences",
+		"CharSet",
 	};
 
 	std::unordered_map<std::string, Backend> backendsByNames{
@@ -48,6 +72,11 @@ namespace ScanBytes{
 		{backendNames[static_cast<uint8_t>(Backend::TSV)], Backend::TSV},
 		{backendNames[static_cast<uint8_t>(Backend::Space)], Backend::Space},
 		{backendNames[static_cast<uint8_t>(Backend::Punct)], Backend::Punct},
+		{backendNames[static_cast<uint8_t>(Backend::SIMD)], Backend::SIMD},
+		{backendNames[static_cast<uint8_t>(Backend::Shuffle)], Backend::Shuffle},
+		{backendNames[static_cast<uint8_t>(Backend::CSVQuoted)], Backend::CSVQuoted},
+		{backendNames[static_cast<uint8_t>(Backend::Sequences)], Backend::Sequences},
+		{backendNames[static_cast<uint8_t>(Backend::CharSet)], Backend::CharSet},
 	};
 
 	Backend getBackendByName(std::string& name){
@@ -58,71 +87,915 @@ namespace ScanBytes{
 		return it->second;
 	}
 
-	template<typename DetectorT>
-	void singleSearchingThreadFunction(uint8_t id, NumbersAllocator *nall, DetectorT *d, uint8_t *m, size_t start, size_t stop){
-		auto t = nall->getForThread(id);
+	std::vector<uint8_t> encodeSequences(const std::vector<std::string> &sequences){
+		std::vector<uint8_t> res;
+		for(auto &s: sequences){
+			if(s.empty() || s.size() > maxSequenceLength){
+				throw std::logic_error("Sequences must be 1-" + std::to_string(maxSequenceLength) + " bytes long");
+			}
+			res.emplace_back(s.size());
+			res.insert(end(res), begin(s), end(s));
+		}
+		return res;
+	}
+
+	std::vector<std::string> decodeSequences(const std::vector<uint8_t> &charsToScanFor){
+		std::vector<std::string> res;
+		for(size_t i = 0; i < charsToScanFor.size();){
+			size_t length = charsToScanFor[i++];
+			if(!length || length > maxSequenceLength || length > charsToScanFor.size() - i){
+				throw std::logic_error("Malformed sequences, they must be packed with encodeSequences");
+			}
+			res.emplace_back(reinterpret_cast<const char *>(&charsToScanFor[i]), length);
+			i += length;
+		}
+		if(res.empty()){
+			throw std::logic_error("Set of the sequences must be not empty");
+		}
+		return res;
+	}
 
-		for(size_t i=start; i<stop; ++i){
-			if((*d)(m[i])){
-				t.append(i);
+	/// Makes the stored values from the offsets found within a window
+	struct PlainOffsets{
+		inline uint64_t operator()(const uint8_t *window, uint64_t windowBase, uint32_t offset) const{
+			return windowBase + offset;
+		}
+	};
+
+	/// The window has just been scanned, so telling which char has matched costs only L1 hits
+	struct RecordTaggedOffsets{
+		uint8_t recordDelimiter;
+
+		inline uint64_t operator()(const uint8_t *window, uint64_t windowBase, uint32_t offset) const{
+			return (windowBase + offset) | (window[offset] == recordDelimiter ? recordTagBit : 0);
+		}
+	};
+
+	/// `offsets` is a buffer of `scanWindowSize` items
+	template<typename DetectorT, typename TAllocT, typename OffsetsT>
+	void scanTask(TAllocT &t, DetectorT *d, uint8_t *m, size_t start, size_t stop, uint64_t base, std::vector<uint32_t> &offsets, OffsetsT toValue){
+		if constexpr(requires (uint32_t *out){d->scanWindow(m, m, out);}){
+			for(size_t i=start; i<stop; i += scanWindowSize){
+				size_t windowStop = std::min(i + scanWindowSize, stop);
+				uint32_t *offsetsEnd = d->scanWindow(&m[i], &m[windowStop], &offsets[0]);
+				const uint8_t *window = &m[i];
+				uint64_t windowBase = base + i;
+				t.appendTransformed(&offsets[0], offsetsEnd - &offsets[0], [&](uint32_t offset){
+					return toValue(window, windowBase, offset);
+				});
+			}
+		} else {
+			for(size_t i=start; i<stop; ++i){
+				if((*d)(m[i])){
+					t.append(toValue(&m[i], base + i, 0));
+				}
 			}
 		}
 	}
 
+	/// Predicts the count of matches from a few evenly spread samples, so that a thread usually allocates a single arena
 	template<typename DetectorT>
-	NBST scan(ScannableT m, DetectorT &d){
+	size_t estimateMatchesCount(ScannableT m, DetectorT &d){
+		const size_t samplesCount = 32;
+		const size_t sampleSize = 1024;
+		if(m.size() < samplesCount * sampleSize * 4){
+			return std::min(m.size(), NumbersAllocator::defaultArenaCapacity);  // the arena grows if it is not enough
+		}
+		size_t step = m.size() / samplesCount;
+		size_t found = 0;
+		for(size_t i = 0; i < samplesCount; ++i){
+			const uint8_t *sample = m.data() + i * step;
+			for(size_t j = 0; j < sampleSize; ++j){
+				found += d(sample[j]);
+			}
+		}
+		return found * (m.size() / (samplesCount * sampleSize));
+	}
+
+	/// What a thread is expected to append, with some slack for uneven density and stolen tasks
+	template<typename DetectorT>
+	size_t estimateMatchesPerThread(ScannableT m, DetectorT &d, ThreadPool &pool){
+		return estimateMatchesCount(m, d) / getWorkersCount(m, pool.size()) * 5 / 4 + 1024;
+	}
+
+	/// Puts the blocks in order of their tasks in linear time. The blocks of a task are cut by a single thread one after another, so they are already in order.
+	template<typename StorageT>
+	void orderByTasks(StorageT &chunks, size_t tasksCount){
+		std::vector<size_t> positions(tasksCount + 1);
+		for(auto &chunk: chunks){
+			++positions[chunk->id + 1];
+		}
+		for(size_t i = 1; i <= tasksCount; ++i){
+			positions[i] += positions[i - 1];
+		}
+		StorageT res(chunks.size());
+		for(auto &chunk: chunks){
+			res[positions[chunk->id]++] = std::move(chunk);
+		}
+		chunks = std::move(res);
+	}
+
+	/// Records which worker of a scan of `m` has started with the task of every block, so the threads writing the index can be matched with the workers
+	template<typename StorageT>
+	void setInitialWorkers(StorageT &chunks, ScannableT m, ThreadPool &pool){
+		size_t tasksCount = getTasksCount(m);
+		uint16_t workersCount = getWorkersCount(m, pool.size());
+		for(auto &chunk: chunks){
+			chunk->worker = WorkStealingQueue::getInitialWorker(chunk->id, tasksCount, workersCount);
+			chunk->workersCount = workersCount;
+		}
+	}
+
+	/// `ValueT` is the type the offsets are stored as
+	template<typename ValueT = uint64_t, typename DetectorT, typename OffsetsT = PlainOffsets>
+	OffsetsST<ValueT> scan(ScannableT m, DetectorT &d, ScanState &state, ThreadPool &pool, OffsetsT toValue = {}){
 		/*
 		The following threading solutions have been tried (the numbers are times of processing of 2 fifferent large files of different sizes):
 		1. No multithreading, no parallelization. 0.475390 1.92215
 		2. Single dedicated std::thread, no parallelization 0.378107 1.50243e+06
 		2. Threading using tbb:parallel_for 0.182083 0.657477
 		3. OpenMP 0.151552 0.648832
-		4. std::thread, the current impl: 0.131101 0.488398
+		4. std::thread: 0.131101 0.488398
 
 		surprisingly, std::thread from the stdlib is the fastest way of all of them.
+		Now the scan runs on a persistent pool of std::threads taking 1 MiB tasks from work-stealing queues.
 
 		Note: the times have increased to 1s when I have introduced the abstractions to allow selection of chars in runtime. Seems like they are not fully optimized out.
 		*/
-		NumbersAllocator nall;
+		ScanRecorder rec{getStats(state), m.size(), pool};
+		MTOAOA<ValueT> nall{estimateMatchesPerThread(m, d, pool)};
+
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			auto t = nall.getForThread(worker);
+			WorkerRecorder w{rec.stats, worker};
+			std::vector<uint32_t> offsets(scanWindowSize);
+			size_t task;
+			while(q.next(worker, task)){
+				auto taskStart = w.startTask();
+				t.startTask(task);
+				size_t start = task * scanTaskSize;
+				size_t stop = std::min(start + scanTaskSize, m.size());
+				scanTask(t, &d, &m[0], start, stop, state.base, offsets, toValue);
+				w.endTask(taskStart, stop - start);
+			}
+			w.addSteals(q, worker);
+			w.addAllocator(t);
+		}, pool);
+
+		orderByTasks(nall.chunks, getTasksCount(m));
+		rec.setResults(nall.chunks);
+		return std::move(nall.chunks);
+	}
+
+	template<typename DetectorT>
+	NBST scanInThisThread(ScannableT m, DetectorT &d, ScanState &state, std::vector<uint32_t> &offsets, std::vector<uint32_t> &altOffsets){
+		NumbersAllocator nall{estimateMatchesCount(m, d)};
+		{
+			auto t = nall.getForThread(0);
+			scanTask(t, &d, m.data(), 0, m.size(), state.base, offsets, PlainOffsets{});
+		}
+		return std::move(nall.chunks);
+	}
+
+	template<typename TAllocT, typename OffsetsT>
+	void quotedScanTask(TAllocT &t, TAllocT &altT, QuotedCSVDetector *d, uint8_t *m, size_t start, size_t stop, uint64_t base, uint8_t *endsInQuote, std::vector<uint32_t> &offsets, std::vector<uint32_t> &altOffsets, OffsetsT toValue){
+		uint64_t inQuote = 0;
+		for(size_t i=start; i<stop; i += scanWindowSize){
+			size_t windowStop = std::min(i + scanWindowSize, stop);
+			uint32_t *altOffsetsEnd = &altOffsets[0];
+			uint32_t *offsetsEnd = d->scanWindow(&m[i], &m[windowStop], &offsets[0], altOffsetsEnd, inQuote);
+			const uint8_t *window = &m[i];
+			uint64_t windowBase = base + i;
+			auto windowToValue = [&](uint32_t offset){
+				return toValue(window, windowBase, offset);
+			};
+			t.appendTransformed(&offsets[0], offsetsEnd - &offsets[0], windowToValue);
+			altT.appendTransformed(&altOffsets[0], altOffsetsEnd - &altOffsets[0], windowToValue);
+		}
+		*endsInQuote = inQuote != 0;
+	}
+
+	template<typename ValueT = uint64_t, typename OffsetsT = PlainOffsets>
+	OffsetsST<ValueT> scan(ScannableT m, QuotedCSVDetector &d, ScanState &state, ThreadPool &pool, OffsetsT toValue = {}){
+		ScanRecorder rec{getStats(state), m.size(), pool};
+		size_t expected = estimateMatchesPerThread(m, d, pool);
+		MTOAOA<ValueT> nall{expected}, altNall{expected};
+		size_t tasksCount = getTasksCount(m);
+		std::vector<uint8_t> endsInQuote(tasksCount);
+
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			auto t = nall.getForThread(worker);
+			auto altT = altNall.getForThread(worker);
+			WorkerRecorder w{rec.stats, worker};
+			std::vector<uint32_t> offsets(scanWindowSize), altOffsets(scanWindowSize);
+			size_t task;
+			while(q.next(worker, task)){
+				auto taskStart = w.startTask();
+				t.startTask(task);
+				altT.startTask(task);
+				size_t start = task * scanTaskSize;
+				size_t stop = std::min(start + scanTaskSize, m.size());
+				quotedScanTask(t, altT, &d, &m[0], start, stop, state.base, &endsInQuote[task], offsets, altOffsets, toValue);
+				w.endTask(taskStart, stop - start);
+			}
+			w.addSteals(q, worker);
+			w.addAllocator(t);
+			w.addAllocator(altT);
+		}, pool);
+
+		// A task starts within quotes if the quotes before it (including the ones in the previous buffers) are unbalanced. Then the offsets it has put aside are the right ones.
+		std::vector<uint8_t> startsInQuote(endsInQuote.size());
+		uint8_t inQuote = state.inQuote;
+		for(size_t i = 0; i < endsInQuote.size(); ++i){
+			startsInQuote[i] = inQuote;
+			inQuote ^= endsInQuote[i];
+		}
+		state.inQuote = inQuote;
+
+		OffsetsST<ValueT> res;
+		res.reserve(nall.chunks.size());
+		for(auto &chunk: nall.chunks){
+			if(!startsInQuote[chunk->id]){
+				res.emplace_back(std::move(chunk));
+			}
+		}
+		for(auto &chunk: altNall.chunks){
+			if(startsInQuote[chunk->id]){
+				res.emplace_back(std::move(chunk));
+			}
+		}
+		orderByTasks(res, tasksCount);
+		rec.setResults(res);
+		return res;
+	}
+
+	NBST scanInThisThread(ScannableT m, QuotedCSVDetector &d, ScanState &state, std::vector<uint32_t> &offsets, std::vector<uint32_t> &altOffsets){
+		size_t expected = estimateMatchesCount(m, d);
+		NumbersAllocator nall{expected}, altNall{expected};
+		uint8_t endsInQuote;
+		{
+			auto t = nall.getForThread(0);
+			auto altT = altNall.getForThread(0);
+			quotedScanTask(t, altT, &d, m.data(), 0, m.size(), state.base, &endsInQuote, offsets, altOffsets, PlainOffsets{});
+		}
+		bool startsInQuote = state.inQuote;
+		state.inQuote ^= endsInQuote;
+		return std::move(startsInQuote ? altNall.chunks : nall.chunks);
+	}
+
+	/// What the fix-up of the tasks of Sequences backend needs to know about a task
+	struct SequencesTaskResult{
+		size_t next = 0; // the position right after its last match, 0 if it has none
+	};
+
+	template<typename TAllocT, typename OffsetsT>
+	SequencesTaskResult sequencesScanTask(TAllocT &t, SequencesDetector *d, uint8_t *m, size_t size, size_t start, size_t stop, size_t from, uint64_t base, std::vector<uint32_t> &offsets, OffsetsT toValue){
+		SequencesTaskResult res;
+		const uint8_t *fromPtr = m + from;
+		for(size_t i=start; i<stop; i += scanWindowSize){
+			size_t windowStop = std::min(i + scanWindowSize, stop);
+			const uint8_t *window = &m[i];
+			uint32_t *offsetsEnd = d->scanWindow(window, m + windowStop, m + size, fromPtr, &offsets[0]);
+			size_t count = offsetsEnd - &offsets[0];
+			if(count){
+				res.next = i + offsets[count - 1] + 1;
+				uint64_t windowBase = base + i;
+				t.appendTransformed(&offsets[0], count, [&](uint32_t offset){
+					return toValue(window, windowBase, offset);
+				});
+			}
+		}
+		return res;
+	}
+
+	/// The matches starting within the tail of the previous buffers of the stream and ending in `m`, appended to `ends` as positions within `m`. Returns the position within `m` the next match may start at.
+	size_t scanSequencesTail(SequencesDetector &d, ScannableT m, ScanState &state, std::vector<size_t> &ends){
+		uint8_t joined[2 * (maxSequenceLength - 1)];
+		size_t headSize = std::min(m.size(), maxSequenceLength - 1);
+		memcpy(joined, state.tail, state.tailSize);
+		memcpy(joined + state.tailSize, m.data(), headSize);
+		const uint8_t *tailEnd = joined + state.tailSize;
+		const uint8_t *limit = tailEnd + headSize;
+
+		uint64_t joinedBase = state.base - state.tailSize;
+		uint64_t from = std::max(state.sequencesFrom, joinedBase);
+		while(from < state.base){
+			auto last = d.next(joined + (from - joinedBase), tailEnd, limit);
+			if(!last){
+				break;
+			}
+			if(last >= tailEnd){  // the ones within the tail have been found by the previous scan
+				ends.emplace_back(last - tailEnd);
+			}
+			from = joinedBase + (last - joined) + 1;
+		}
+		return from > state.base ? from - state.base : 0;
+	}
+
+	/// Keeps the last bytes of the stream for `scanSequencesTail` of the next buffer
+	void keepSequencesTail(ScanState &state, ScannableT m, size_t from){
+		state.sequencesFrom = std::max(state.sequencesFrom, state.base + from);
+		size_t keep = std::min(maxSequenceLength - 1, state.tailSize + m.size());
+		if(m.size() >= keep){
+			memcpy(state.tail, m.data() + m.size() - keep, keep);
+		} else {
+			memmove(state.tail, state.tail + state.tailSize + m.size() - keep, keep - m.size());
+			memcpy(state.tail + keep - m.size(), m.data(), m.size());
+		}
+		state.tailSize = keep;
+	}
+
+	/*
+	A task has assumed that no match of the previous ones reaches into it. Where one does, the matches of the task are compared with the ones found serially from the end of that match till both agree on a match: from there on they are the same, since the only state is the position the next match may start at. Usually they agree on the first match.
+	`fixTask(task, dropped, added)` replaces the first matches of the task (`dropped`) with `added`, both are the positions of their last bytes. Returns the position the next match may start at after all the tasks, 0 if there are no matches.
+	*/
+	template<typename FixT>
+	size_t fixUpSequences(SequencesDetector &d, ScannableT m, std::vector<SequencesTaskResult> &tasks, size_t from, FixT fixTask){
+		const uint8_t *limit = m.data() + m.size();
+		std::vector<size_t> dropped, added;
+		for(size_t task = 0; task < tasks.size(); ++task){
+			size_t start = task * scanTaskSize;
+			const uint8_t *stop = m.data() + std::min(start + scanTaskSize, m.size());
+			auto &r = tasks[task];
+			if(from > start){
+				dropped.clear();
+				added.clear();
+				auto assumed = d.next(m.data() + start, stop, limit);
+				auto actual = d.next(m.data() + from, stop, limit);
+				while(assumed != actual){
+					if(assumed && (!actual || assumed < actual)){
+						dropped.emplace_back(assumed - m.data());
+						assumed = d.next(assumed + 1, stop, limit);
+					} else {
+						added.emplace_back(actual - m.data());
+						actual = d.next(actual + 1, stop, limit);
+					}
+				}
+				if(!actual){  // they have never agreed, the rest of the task is replaced
+					r.next = added.empty() ? 0 : added.back() + 1;
+				}
+				fixTask(task, dropped, added);
+			}
+			if(r.next){
+				from = r.next;
+			}
+		}
+		return from;
+	}
+
+	template<typename ValueT = uint64_t, typename OffsetsT = PlainOffsets>
+	OffsetsST<ValueT> scan(ScannableT m, SequencesDetector &d, ScanState &state, ThreadPool &pool, OffsetsT toValue = {}){
+		ScanRecorder rec{getStats(state), m.size(), pool};
+		MTOAOA<ValueT> nall{estimateMatchesPerThread(m, d, pool)};
+		size_t tasksCount = getTasksCount(m);
+		std::vector<SequencesTaskResult> tasks(tasksCount);
 
-		auto s = m.size();
-		uint16_t procsCount = std::thread::hardware_concurrency();
-		uint16_t lastProc = procsCount - 1;
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			auto t = nall.getForThread(worker);
+			WorkerRecorder w{rec.stats, worker};
+			std::vector<uint32_t> offsets(scanWindowSize);
+			size_t task;
+			while(q.next(worker, task)){
+				auto taskStart = w.startTask();
+				t.startTask(task);
+				size_t start = task * scanTaskSize;
+				size_t stop = std::min(start + scanTaskSize, m.size());
+				tasks[task] = sequencesScanTask(t, &d, m.data(), m.size(), start, stop, start, state.base, offsets, toValue);
+				w.endTask(taskStart, stop - start);
+			}
+			w.addSteals(q, worker);
+			w.addAllocator(t);
+		}, pool);
 
-		size_t shareSize = s / procsCount;
+		orderByTasks(nall.chunks, tasksCount);
+		std::vector<size_t> firstChunks(tasksCount + 1);
+		for(auto &chunk: nall.chunks){
+			++firstChunks[chunk->id + 1];
+		}
+		for(size_t i = 1; i <= tasksCount; ++i){
+			firstChunks[i] += firstChunks[i - 1];
+		}
 
-		std::vector<std::thread> threadList;
+		auto makeBlock = [&](uint32_t id, std::vector<size_t> &ends){
+			auto block = std::make_unique<ValueBlock<ValueT>>(id, ends.size());
+			for(size_t i = 0; i < ends.size(); ++i){
+				block->vec[i] = toValue(&m[ends[i]], state.base + ends[i], 0);
+			}
+			return block;
+		};
+
+		OffsetsST<ValueT> res;
+		std::vector<size_t> tailEnds;
+		size_t from = scanSequencesTail(d, m, state, tailEnds);
+		if(!tailEnds.empty()){
+			res.emplace_back(makeBlock(0, tailEnds));
+		}
+
+		std::vector<std::unique_ptr<ValueBlock<ValueT>>> insertions(tasksCount);
+		from = fixUpSequences(d, m, tasks, from, [&](size_t task, std::vector<size_t> &dropped, std::vector<size_t> &added){
+			size_t toDrop = dropped.size();
+			for(size_t i = firstChunks[task]; toDrop && i < firstChunks[task + 1]; ++i){
+				auto &vec = nall.chunks[i]->vec;
+				size_t n = std::min(toDrop, vec.count);
+				vec.ptr += n;
+				vec.count -= n;
+				toDrop -= n;
+			}
+			if(!added.empty()){
+				insertions[task] = makeBlock(task, added);
+			}
+		});
+		keepSequencesTail(state, m, from);
 
-		for(uint8_t i = 0; i < lastProc; ++i){
-			size_t start = shareSize * i;
-			size_t stop = start + shareSize;
-			threadList.emplace_back(std::thread(singleSearchingThreadFunction<DetectorT>, i, &nall, &d, &m[0], start, stop));
+		for(size_t task = 0; task < tasksCount; ++task){
+			if(insertions[task]){
+				res.emplace_back(std::move(insertions[task]));
+			}
+			for(size_t i = firstChunks[task]; i < firstChunks[task + 1]; ++i){
+				if(!nall.chunks[i]->vec.empty()){
+					res.emplace_back(std::move(nall.chunks[i]));
+				}
+			}
 		}
-		threadList.emplace_back(std::thread(singleSearchingThreadFunction<DetectorT>, lastProc, &nall, &d, &m[0], shareSize * lastProc, s));
-		std::for_each(threadList.begin(),threadList.end(), std::mem_fn(&std::thread::join));
+		rec.setResults(res);
+		return res;
+	}
 
+	NBST scanInThisThread(ScannableT m, SequencesDetector &d, ScanState &state, std::vector<uint32_t> &offsets, std::vector<uint32_t> &altOffsets){
+		NumbersAllocator nall{estimateMatchesCount(m, d)};
+		{
+			auto t = nall.getForThread(0);
+			std::vector<size_t> tailEnds;
+			size_t from = scanSequencesTail(d, m, state, tailEnds);
+			for(auto end: tailEnds){
+				t.append(state.base + end);
+			}
+			auto r = sequencesScanTask(t, &d, m.data(), m.size(), 0, m.size(), from, state.base, offsets, PlainOffsets{});
+			keepSequencesTail(state, m, r.next ? r.next : from);
+		}
 		return std::move(nall.chunks);
 	}
 
-	template<Backend backendEnum>
-	NBST scanWithFreshDetector(ScannableT m, std::vector<uint8_t> charsToScanFor){
-		using DetectorT = typename GetBackendFromEnum<backendEnum>::type;
-		DetectorT d(charsToScanFor);
-		return std::move(scan(m, d));
+	/// Count of the matches in [begin, end). The detectors having no counting kernels extract the offsets window by window into `offsets` and count them.
+	template<typename DetectorT>
+	uint64_t countRange(DetectorT *d, const uint8_t *begin, const uint8_t *end, std::vector<uint32_t> &offsets){
+		uint64_t count = 0;
+		if constexpr(requires {d->countRange(begin, end);}){
+			count = d->countRange(begin, end);
+		} else if constexpr(requires (uint32_t *out){d->scanWindow(begin, end, out);}){
+			for(const uint8_t *p = begin; p < end;){
+				const uint8_t *windowEnd = p + std::min<size_t>(scanWindowSize, end - p);
+				count += d->scanWindow(p, windowEnd, &offsets[0]) - &offsets[0];
+				p = windowEnd;
+			}
+		} else {
+			for(const uint8_t *p = begin; p < end; ++p){
+				count += (*d)(*p);
+			}
+		}
+		return count;
+	}
+
+	/// Adds the counts of the parts of [start, stop) to the counts of the blocks they fall into. Only the blocks shared by several tasks are contended. Returns the count within the task.
+	template<typename DetectorT>
+	uint64_t countTask(DetectorT *d, const uint8_t *m, size_t start, size_t stop, size_t blockSize, uint64_t *counts, std::vector<uint32_t> &offsets){
+		uint64_t total = 0;
+		for(size_t i = start; i < stop;){
+			size_t block = i / blockSize;
+			size_t partStop = std::min(stop, (block + 1) * blockSize);
+			auto count = countRange(d, m + i, m + partStop, offsets);
+			std::atomic_ref<uint64_t>(counts[block]).fetch_add(count, std::memory_order_relaxed);
+			total += count;
+			i = partStop;
+		}
+		return total;
+	}
+
+	template<typename DetectorT>
+	void countBlocks(ScannableT m, DetectorT &d, ScanState &state, size_t blockSize, uint64_t *counts, ThreadPool &pool){
+		ScanRecorder rec{getStats(state), m.size(), pool};
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			WorkerRecorder w{rec.stats, worker};
+			std::vector<uint32_t> offsets(scanWindowSize);
+			size_t task;
+			while(q.next(worker, task)){
+				auto taskStart = w.startTask();
+				size_t start = task * scanTaskSize;
+				size_t stop = std::min(start + scanTaskSize, m.size());
+				auto count = countTask<DetectorT>(&d, m.data(), start, stop, blockSize, counts, offsets);
+				w.endTask(taskStart, stop - start, count);
+				if(rec.stats){
+					std::atomic_ref<uint64_t>(rec.matches).fetch_add(count, std::memory_order_relaxed);
+				}
+			}
+			w.addSteals(q, worker);
+		}, pool);
+	}
+
+	/// Every task keeps both counts of every block it overlaps till it is known whether it starts within quotes, so unlike the others it needs memory proportional to the count of the tasks
+	void countBlocks(ScannableT m, QuotedCSVDetector &d, ScanState &state, size_t blockSize, uint64_t *counts, ThreadPool &pool){
+		ScanRecorder rec{getStats(state), m.size(), pool};
+		size_t tasksCount = getTasksCount(m);
+		std::vector<std::vector<uint64_t>> taskCounts(tasksCount);  // the counts outside of quotes and within them, interleaved
+		std::vector<uint8_t> endsInQuote(tasksCount);
+
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			WorkerRecorder w{rec.stats, worker};
+			size_t task;
+			while(q.next(worker, task)){
+				auto taskStart = w.startTask();
+				size_t start = task * scanTaskSize;
+				size_t stop = std::min(start + scanTaskSize, m.size());
+				auto &c = taskCounts[task];
+				uint64_t inQuote = 0;
+				for(size_t i = start; i < stop;){
+					size_t partStop = std::min(stop, (i / blockSize + 1) * blockSize);
+					uint64_t altCount = 0;
+					c.emplace_back(d.countRange(&m[i], &m[partStop], altCount, inQuote));
+					c.emplace_back(altCount);
+					i = partStop;
+				}
+				endsInQuote[task] = inQuote != 0;
+				if(w.ts){
+					uint64_t count = 0;
+					for(auto el: c){
+						count += el;
+					}
+					w.endTask(taskStart, stop - start, count);
+				}
+			}
+			w.addSteals(q, worker);
+		}, pool);
+
+		uint8_t inQuote = state.inQuote;
+		for(size_t task = 0; task < tasksCount; ++task){
+			auto &c = taskCounts[task];
+			size_t block = task * scanTaskSize / blockSize;
+			for(size_t i = 0; i < c.size(); i += 2, ++block){
+				counts[block] += c[i + inQuote];
+				rec.matches += c[i + inQuote];
+			}
+			inQuote ^= endsInQuote[task];
+		}
+		state.inQuote = inQuote;
+	}
+
+	/// The matches are counted by the blocks their last bytes are in
+	SequencesTaskResult sequencesCountTask(SequencesDetector *d, const uint8_t *m, size_t size, size_t start, size_t stop, size_t blockSize, uint64_t *counts, std::vector<uint32_t> &offsets, uint64_t &total){
+		SequencesTaskResult res;
+		const uint8_t *from = m + start;
+		size_t block = start / blockSize;
+		uint64_t blockCount = 0;
+		for(size_t i = start; i < stop; i += scanWindowSize){
+			size_t windowStop = std::min(i + scanWindowSize, stop);
+			uint32_t *offsetsEnd = d->scanWindow(m + i, m + windowStop, m + size, from, &offsets[0]);
+			for(uint32_t *o = &offsets[0]; o < offsetsEnd; ++o){
+				size_t last = i + *o;
+				if(last / blockSize != block){
+					std::atomic_ref<uint64_t>(counts[block]).fetch_add(blockCount, std::memory_order_relaxed);
+					total += blockCount;
+					block = last / blockSize;
+					blockCount = 0;
+				}
+				++blockCount;
+				res.next = last + 1;
+			}
+		}
+		std::atomic_ref<uint64_t>(counts[block]).fetch_add(blockCount, std::memory_order_relaxed);
+		total += blockCount;
+		return res;
+	}
+
+	void countBlocks(ScannableT m, SequencesDetector &d, ScanState &state, size_t blockSize, uint64_t *counts, ThreadPool &pool){
+		ScanRecorder rec{getStats(state), m.size(), pool};
+		size_t tasksCount = getTasksCount(m);
+		std::vector<SequencesTaskResult> tasks(tasksCount);
+
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			WorkerRecorder w{rec.stats, worker};
+			std::vector<uint32_t> offsets(scanWindowSize);
+			size_t task;
+			while(q.next(worker, task)){
+				auto taskStart = w.startTask();
+				size_t start = task * scanTaskSize;
+				size_t stop = std::min(start + scanTaskSize, m.size());
+				uint64_t count = 0;
+				tasks[task] = sequencesCountTask(&d, m.data(), m.size(), start, stop, blockSize, counts, offsets, count);
+				w.endTask(taskStart, stop - start, count);
+				if(rec.stats){
+					std::atomic_ref<uint64_t>(rec.matches).fetch_add(count, std::memory_order_relaxed);
+				}
+			}
+			w.addSteals(q, worker);
+		}, pool);
+
+		std::vector<size_t> tailEnds;
+		size_t from = scanSequencesTail(d, m, state, tailEnds);
+		for(auto last: tailEnds){
+			++counts[last / blockSize];
+		}
+		rec.matches += tailEnds.size();
+		from = fixUpSequences(d, m, tasks, from, [&](size_t task, std::vector<size_t> &dropped, std::vector<size_t> &added){
+			for(auto last: dropped){
+				--counts[last / blockSize];
+			}
+			for(auto last: added){
+				++counts[last / blockSize];
+			}
+			rec.matches += added.size() - dropped.size();
+		});
+		keepSequencesTail(state, m, from);
+	}
+
+	/// Finds the matches of the windows of a task for `recordsTask`: `find` writes the offsets of their last bytes relative to the window into `offsets`, `length(i)` is the length of match i
+	template<typename DetectorT>
+	struct MatchesFinder{
+		DetectorT *d;
+		std::vector<uint32_t> offsets = std::vector<uint32_t>(scanWindowSize);
+
+		uint32_t *find(const uint8_t *begin, const uint8_t *end){
+			if constexpr(requires (uint32_t *out){d->scanWindow(begin, end, out);}){
+				return d->scanWindow(begin, end, &offsets[0]);
+			} else {
+				uint32_t *out = &offsets[0];
+				for(const uint8_t *p = begin; p < end; ++p){
+					if((*d)(*p)){
+						*(out++) = p - begin;
+					}
+				}
+				return out;
+			}
+		}
+
+		inline size_t length(size_t i) const {
+			return 1;
+		}
+	};
+
+	/// `inQuote` must be set to whether the task starts within quotes, then the delimiters put aside are the quoted ones and are skipped
+	struct QuotedMatchesFinder{
+		QuotedCSVDetector *d;
+		uint64_t inQuote = 0;
+		std::vector<uint32_t> offsets = std::vector<uint32_t>(scanWindowSize);
+		std::vector<uint32_t> altOffsets = std::vector<uint32_t>(scanWindowSize);
+
+		uint32_t *find(const uint8_t *begin, const uint8_t *end){
+			uint32_t *altOffsetsEnd = &altOffsets[0];
+			return d->scanWindow(begin, end, &offsets[0], altOffsetsEnd, inQuote);
+		}
+
+		inline size_t length(size_t i) const {
+			return 1;
+		}
+	};
+
+	/// `from` must be set to the position the first match of the task may start at, a match may end past the window
+	struct SequencesMatchesFinder{
+		SequencesDetector *d;
+		const uint8_t *limit;
+		const uint8_t *from = nullptr;
+		std::vector<uint32_t> offsets = std::vector<uint32_t>(scanWindowSize);
+		std::vector<uint8_t> lengths = std::vector<uint8_t>(scanWindowSize);
+
+		uint32_t *find(const uint8_t *begin, const uint8_t *end){
+			return d->scanWindow(begin, end, limit, from, &offsets[0], &lengths[0]);
+		}
+
+		inline size_t length(size_t i) const {
+			return lengths[i];
+		}
+	};
+
+	/// The position of the first match at or after `from`, `m.size()` if there is none. Clobbers the offsets of the finder.
+	template<typename FinderT>
+	size_t findNextMatch(FinderT &f, ScannableT m, size_t from){
+		for(size_t i = from; i < m.size(); i += scanWindowSize){
+			size_t windowStop = std::min(i + scanWindowSize, m.size());
+			if(f.find(&m[i], m.data() + windowStop) != &f.offsets[0]){
+				return i + f.offsets[0] + 1 - f.length(0);
+			}
+		}
+		return m.size();
+	}
+
+	/// `records` is a buffer for the records of a window. The offsets are appended to `t` only if `keepOffsets`. Returns the position right after the last match of the task, 0 if it has none.
+	template<typename FinderT, typename TAllocT>
+	size_t recordsTask(TAllocT &t, bool keepOffsets, FinderT &f, ScannableT m, size_t task, uint16_t worker, std::vector<ScannableT> &records, RecordsSinkT &sink){
+		const size_t noRecord = std::numeric_limits<size_t>::max();
+		size_t start = task * scanTaskSize;
+		size_t stop = std::min(start + scanTaskSize, m.size());
+		size_t recordStart = task ? noRecord : 0;  // the record before the first match of a task belongs to a previous one
+		size_t next = 0;
+		for(size_t i = start; i < stop; i += scanWindowSize){
+			size_t windowStop = std::min(i + scanWindowSize, stop);
+			uint32_t *offsetsEnd = f.find(&m[i], m.data() + windowStop);
+			size_t count = offsetsEnd - &f.offsets[0];
+			records.clear();
+			for(size_t j = 0; j < count; ++j){
+				size_t match = i + f.offsets[j];
+				if(recordStart != noRecord){
+					records.emplace_back(m.data() + recordStart, match + 1 - f.length(j) - recordStart);
+				}
+				recordStart = next = match + 1;
+			}
+			if(keepOffsets){
+				t.appendRelative(i, &f.offsets[0], count);
+			}
+			if(!records.empty()){
+				sink(worker, task, records);
+			}
+		}
+		if(recordStart == noRecord){
+			return next;
+		}
+		size_t recordStop = findNextMatch(f, m, stop);
+		if(recordStop > recordStart || recordStop < m.size()){
+			ScannableT last{m.data() + recordStart, recordStop - recordStart};
+			sink(worker, task, RecordsBatchT{&last, 1});
+		}
+		return next;
+	}
+
+	template<typename DetectorT>
+	void scanRecords(ScannableT m, DetectorT &d, RecordsSinkT &sink, NBST *offsets, ThreadPool &pool){
+		NumbersAllocator nall{offsets ? estimateMatchesPerThread(m, d, pool) : 1};  // the arenas are allocated on the first append only
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			auto t = nall.getForThread(worker);
+			MatchesFinder<DetectorT> f{&d};
+			std::vector<ScannableT> records;
+			records.reserve(scanWindowSize);
+			size_t task;
+			while(q.next(worker, task)){
+				t.startTask(task);
+				recordsTask(t, offsets != nullptr, f, m, task, worker, records, sink);
+			}
+		}, pool);
+
+		if(offsets){
+			orderByTasks(nall.chunks, getTasksCount(m));
+			*offsets = std::move(nall.chunks);
+		}
+	}
+
+	/// Whether a delimiter is within quotes depends on all the quotes before it, and the records passed to the sink cannot be taken back like the offsets of `scan`. So the quotes of every task are counted first to know whether it starts within quotes.
+	void scanRecords(ScannableT m, QuotedCSVDetector &d, RecordsSinkT &sink, NBST *offsets, ThreadPool &pool){
+		size_t tasksCount = getTasksCount(m);
+		std::vector<uint8_t> startsInQuote(tasksCount);
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			size_t task;
+			while(q.next(worker, task)){
+				size_t start = task * scanTaskSize;
+				size_t stop = std::min(start + scanTaskSize, m.size());
+				uint64_t inQuote = 0, altCount = 0;
+				d.countRange(m.data() + start, m.data() + stop, altCount, inQuote);
+				startsInQuote[task] = inQuote != 0;  // whether it ends within quotes for now
+			}
+		}, pool);
+		uint8_t inQuote = 0;
+		for(auto &s: startsInQuote){
+			uint8_t endsInQuote = s;
+			s = inQuote;
+			inQuote ^= endsInQuote;
+		}
+
+		NumbersAllocator nall{offsets ? estimateMatchesPerThread(m, d, pool) : 1};
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			auto t = nall.getForThread(worker);
+			QuotedMatchesFinder f{&d};
+			std::vector<ScannableT> records;
+			records.reserve(scanWindowSize);
+			size_t task;
+			while(q.next(worker, task)){
+				t.startTask(task);
+				f.inQuote = startsInQuote[task] ? ~uint64_t(0) : 0;
+				recordsTask(t, offsets != nullptr, f, m, task, worker, records, sink);
+			}
+		}, pool);
+
+		if(offsets){
+			orderByTasks(nall.chunks, tasksCount);
+			*offsets = std::move(nall.chunks);
+		}
 	}
 
+	/// Whether a sequence starting before `start` ends at or after it, then the matches after `start` depend on the ones before it
+	bool isReachedInto(SequencesDetector &d, ScannableT m, size_t start){
+		const uint8_t *limit = m.data() + m.size();
+		for(size_t p = start - std::min(start, d.maxDistance); p < start; ++p){
+			if(d.isFirst[m[p]] && p + d.matchAt(&m[p], limit) > start){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*
+	A match reaching into a task from the previous one moves the position its first match may start at, and the records passed to the sink cannot be taken back like the offsets fixed up by `scan`.
+	So the tasks no sequence reaches into (usually all of them) are scanned in parallel, and the rest are scanned after them in order, when the matches before them are known.
+	*/
+	void scanRecords(ScannableT m, SequencesDetector &d, RecordsSinkT &sink, NBST *offsets, ThreadPool &pool){
+		size_t tasksCount = getTasksCount(m);
+		std::vector<uint8_t> isDeferred(tasksCount);
+		std::vector<size_t> nexts(tasksCount);
+		NumbersAllocator nall{offsets ? estimateMatchesPerThread(m, d, pool) : 1};
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			auto t = nall.getForThread(worker);
+			SequencesMatchesFinder f{&d, m.data() + m.size()};
+			std::vector<ScannableT> records;
+			records.reserve(scanWindowSize);
+			size_t task;
+			while(q.next(worker, task)){
+				size_t start = task * scanTaskSize;
+				if(isReachedInto(d, m, start)){
+					isDeferred[task] = true;
+					continue;
+				}
+				t.startTask(task);
+				f.from = m.data() + start;
+				nexts[task] = recordsTask(t, offsets != nullptr, f, m, task, worker, records, sink);
+			}
+		}, pool);
+
+		{
+			auto t = nall.getForThread(0);
+			SequencesMatchesFinder f{&d, m.data() + m.size()};
+			std::vector<ScannableT> records;
+			size_t from = 0;
+			for(size_t task = 0; task < tasksCount; ++task){
+				from = std::max(from, task * scanTaskSize);
+				if(isDeferred[task]){
+					t.startTask(task);
+					f.from = m.data() + from;
+					nexts[task] = recordsTask(t, offsets != nullptr, f, m, task, 0, records, sink);
+				}
+				if(nexts[task]){
+					from = nexts[task];
+				}
+			}
+		}
+
+		if(offsets){
+			orderByTasks(nall.chunks, tasksCount);
+			*offsets = std::move(nall.chunks);
+		}
+	}
+
+	template<typename DetectorT>
+	struct DetectorScannerImpl: public DetectorScanner{
+		DetectorT d;
+
+		DetectorScannerImpl(std::vector<uint8_t> &charsToScanFor): d(charsToScanFor){}
+
+		NBST scan(ScannableT m, ScanState &state, ThreadPool &pool) override{
+			auto res = ScanBytes::scan(m, d, state, pool);
+			setInitialWorkers(res, m, pool);
+			return res;
+		}
+
+		NBST scanInThisThread(ScannableT m, ScanState &state, std::vector<uint32_t> &offsets, std::vector<uint32_t> &altOffsets) override{
+			return ScanBytes::scanInThisThread(m, d, state, offsets, altOffsets);
+		}
+
+		NarrowNBST scanNarrow(ScannableT m, ScanState &state, ThreadPool &pool) override{
+			auto res = ScanBytes::scan<uint32_t>(m, d, state, pool);
+			setInitialWorkers(res, m, pool);
+			return res;
+		}
+
+		NBST scanTagged(ScannableT m, ScanState &state, uint8_t recordDelimiter, ThreadPool &pool) override{
+			auto res = ScanBytes::scan(m, d, state, pool, RecordTaggedOffsets{recordDelimiter});
+			setInitialWorkers(res, m, pool);
+			return res;
+		}
+
+		void count(ScannableT m, ScanState &state, size_t blockSize, uint64_t *counts, ThreadPool &pool) override{
+			ScanBytes::countBlocks(m, d, state, blockSize, counts, pool);
+		}
+
+		void scanRecords(ScannableT m, RecordsSinkT &sink, NBST *offsets, ThreadPool &pool) override{
+			ScanBytes::scanRecords(m, d, sink, offsets, pool);
+			if(offsets){
+				setInitialWorkers(*offsets, m, pool);
+			}
+		}
+	};
+
 	template<Backend backendEnum>
-	BenchmarkResultT benchmarkWithDetector(ScannableT m, std::vector<uint8_t> &charsToScanFor, uint8_t benchmarkAttempts){
-		using DetectorT = typename GetBackendFromEnum<backendEnum>::type;
+	using BackendScanner = DetectorScannerImpl<typename GetBackendFromEnum<backendEnum>::type>;
+
+	template<typename DetectorT>
+	BenchmarkResultT benchmarkDetector(ScannableT m, std::vector<uint8_t> &charsToScanFor, uint8_t benchmarkAttempts){
 		DetectorT d(charsToScanFor);
+		ThreadPool pool(getWorkersCount(m));
 
 		BenchmarkResultT res;
 		res.reserve(benchmarkAttempts);
 
 		NBST resSt;
 		for(decltype(benchmarkAttempts) i=0;i<benchmarkAttempts;++i){
+			ScanState state;
 			auto t1 = std::chrono::high_resolution_clock::now();
-			resSt = scan(m, d);
+			resSt = scan(m, d, state, pool);
 			auto t2 = std::chrono::high_resolution_clock::now();
 
 			resSt.clear();
@@ -132,77 +1005,356 @@ namespace ScanBytes{
 		return res;
 	}
 
-	Backend detectProperBackendInternal(std::vector<uint8_t> &charsToScanFor, size_t s){
-		if(s == 1){
-			if(charsToScanFor[0] == '\n'){
-				return Backend::LF;
-			}
-		} else if(s == 2){
-			if((charsToScanFor[0] == '\n' && charsToScanFor[1] == ',') || (charsToScanFor[1] == '\n' && charsToScanFor[0] == ',')){
-				return Backend::CSV;
-			} else if((charsToScanFor[0] == '\n' && charsToScanFor[1] == '\t') || (charsToScanFor[1] == '\n' && charsToScanFor[0] == '\t')){
-				return Backend::TSV;
-			}
+	/// The named backend having the same detector, CharSet if there is none
+	template<typename DetectorT>
+	constexpr Backend getNamedBackend(){
+		if constexpr(std::is_same_v<DetectorT, LineBreaksDetector>){
+			return Backend::LF;
+		} else if constexpr(std::is_same_v<DetectorT, CSVDetector>){
+			return Backend::CSV;
+		} else if constexpr(std::is_same_v<DetectorT, TSVDetector>){
+			return Backend::TSV;
+		} else if constexpr(std::is_same_v<DetectorT, SpacesDetector>){
+			return Backend::Space;
+		} else if constexpr(std::is_same_v<DetectorT, PunctDetector>){
+			return Backend::Punct;
 		}
-		return getGenericBackend();
+		return Backend::CharSet;
 	}
 
-	Backend detectProperBackend(std::vector<uint8_t> &charsToScanFor){
-		auto s = charsToScanFor.size();
-		if(s){
-			return detectProperBackendInternal(charsToScanFor, s);
+	/// An alphabet having a `CharSetDetector` compiled for it
+	struct CharSetEntry{
+		std::vector<uint8_t> chars; // sorted
+		Backend backend;
+		std::unique_ptr<DetectorScanner> (*make)(std::vector<uint8_t> &charsToScanFor);
+		BenchmarkResultT (*benchmark)(ScannableT m, std::vector<uint8_t> &charsToScanFor, uint8_t benchmarkAttempts);
+	};
+
+	template<uint8_t... chars>
+	CharSetEntry makeCharSetEntry(CharSetDetector<chars...> *){
+		using DetectorT = CharSetDetector<chars...>;
+		std::vector<uint8_t> sorted{chars...};
+		std::sort(begin(sorted), end(sorted));
+		return {
+			.chars = sorted,
+			.backend = getNamedBackend<DetectorT>(),
+			.make = [](std::vector<uint8_t> &charsToScanFor) -> std::unique_ptr<DetectorScanner>{
+				return std::make_unique<DetectorScannerImpl<DetectorT>>(charsToScanFor);
+			},
+			.benchmark = benchmarkDetector<DetectorT>,
+		};
+	}
+
+	template<uint8_t... chars>
+	constexpr CharSetDetector<chars...> *getDetectorOf(Kernels::FixedAlphabet<chars...>){
+		return nullptr;  // only the type matters
+	}
+
+	/// Every alphabet having the kernels with the chars built in, and the punctuation
+	template<size_t... i>
+	std::vector<CharSetEntry> makeCharSets(std::index_sequence<i...>){
+		return {
+			makeCharSetEntry(getDetectorOf(std::tuple_element_t<i, Kernels::FixedAlphabets>{}))...,
+			makeCharSetEntry(static_cast<PunctDetector *>(nullptr)),
+		};
+	}
+
+	const CharSetEntry *findCharSet(std::vector<uint8_t> &charsToScanFor){
+		static const std::vector<CharSetEntry> charSets = makeCharSets(std::make_index_sequence<Kernels::fixedAlphabetsCount>{});
+		std::vector<uint8_t> sorted(charsToScanFor);
+		std::sort(begin(sorted), end(sorted));
+		sorted.erase(std::unique(begin(sorted), end(sorted)), end(sorted));
+		for(auto &e: charSets){
+			if(e.chars == sorted){
+				return &e;
+			}
 		}
-		throw std::logic_error("Set of the chars must be not empty");
+		return nullptr;
 	}
 
-	Backend getGenericBackend(){
-		#ifdef SCANBYTES_JIT_SUPPORTED
-		return Backend::JIT;
-		#else
-		return Backend::Fallback;
-		#endif
+	Backend getCharSetBackend(std::vector<uint8_t> &charsToScanFor){
+		auto e = findCharSet(charsToScanFor);
+		return e ? e->backend : Backend::Unknown;
 	}
 
-	NBST scanWithBackend(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b = Backend::Auto){
+	std::unique_ptr<DetectorScanner> makeDetectorScanner(Backend b, std::vector<uint8_t> &charsToScanFor){
 		switch(b){
 			#ifdef SCANBYTES_JIT_SUPPORTED
 			case Backend::JIT:
-				return scanWithFreshDetector<Backend::JIT>(m, charsToScanFor);
+				return std::make_unique<BackendScanner<Backend::JIT>>(charsToScanFor);
 			break;
 			#endif
 			case Backend::Fallback:
-				return scanWithFreshDetector<Backend::Fallback>(m, charsToScanFor);
+				return std::make_unique<BackendScanner<Backend::Fallback>>(charsToScanFor);
 			break;
 			case Backend::LF:
-				return scanWithFreshDetector<Backend::LF>(m, charsToScanFor);
+				return std::make_unique<BackendScanner<Backend::LF>>(charsToScanFor);
 			break;
 			case Backend::CSV:
-				return scanWithFreshDetector<Backend::CSV>(m, charsToScanFor);
+				return std::make_unique<BackendScanner<Backend::CSV>>(charsToScanFor);
 			break;
 			case Backend::TSV:
-				return scanWithFreshDetector<Backend::TSV>(m, charsToScanFor);
+				return std::make_unique<BackendScanner<Backend::TSV>>(charsToScanFor);
+			break;
+			case Backend::Space:
+				return std::make_unique<BackendScanner<Backend::Space>>(charsToScanFor);
+			break;
+			case Backend::Punct:
+				return std::make_unique<BackendScanner<Backend::Punct>>(charsToScanFor);
+			break;
+			case Backend::CharSet:
+				if(auto e = findCharSet(charsToScanFor)){
+					return e->make(charsToScanFor);
+				}
+				throw std::logic_error("CharSet backend has no detector compiled for the alphabet");
+			break;
+			case Backend::CSVQuoted:
+				return std::make_unique<BackendScanner<Backend::CSVQuoted>>(charsToScanFor);
+			break;
+			case Backend::Sequences:
+				return std::make_unique<BackendScanner<Backend::Sequences>>(charsToScanFor);
+			break;
+			#ifdef SCANBYTES_SIMD_SUPPORTED
+			case Backend::SIMD:
+				return std::make_unique<BackendScanner<Backend::SIMD>>(charsToScanFor);
+			break;
+			case Backend::Shuffle:
+				return std::make_unique<BackendScanner<Backend::Shuffle>>(charsToScanFor);
 			break;
+			#endif
 			default:
 				throw std::logic_error("Unknown backend");
 		}
 	}
 
-	NBST scan(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b){
+	template<Backend backendEnum>
+	BenchmarkResultT benchmarkWithDetector(ScannableT m, std::vector<uint8_t> &charsToScanFor, uint8_t benchmarkAttempts){
+		return benchmarkDetector<typename GetBackendFromEnum<backendEnum>::type>(m, charsToScanFor, benchmarkAttempts);
+	}
+
+	/// The backend and the count of threads measured by `autotune` on this host if there are ones, then the detector compiled for the alphabet, otherwise a guess
+	Backend detectProperBackendInternal(std::vector<uint8_t> &charsToScanFor, size_t s, uint16_t &threadsCount){
+		auto tuned = getTuningDecision(charsToScanFor);
+		if(tuned.backend != Backend::Unknown){
+			if(tuned.threadsCount && !isThreadsCountSet()){
+				threadsCount = tuned.threadsCount;
+			}
+			return tuned.backend;
+		}
+		if(auto b = getCharSetBackend(charsToScanFor); b != Backend::Unknown){
+			return b;
+		}
+		#ifdef SCANBYTES_SIMD_SUPPORTED
+		if(s <= SIMDCharsDetector::maxChars && SIMDCharsDetector::isSupported()){
+			return Backend::SIMD;
+		}
+		if(ShuffleCharsDetector::isSupported()){
+			return Backend::Shuffle;
+		}
+		#endif
+		return getGenericBackend();
+	}
+
+	Backend detectProperBackend(std::vector<uint8_t> &charsToScanFor, uint16_t &threadsCount){
 		auto s = charsToScanFor.size();
 		if(s){
-			if(b == Backend::Auto){
-				b = detectProperBackendInternal(charsToScanFor, s);
-			}
-			return scanWithBackend(m, charsToScanFor, b);
+			return detectProperBackendInternal(charsToScanFor, s, threadsCount);
 		}
 		throw std::logic_error("Set of the chars must be not empty");
 	}
 
+	Backend detectProperBackend(std::vector<uint8_t> &charsToScanFor){
+		uint16_t threadsCount = getThreadsCount();
+		return detectProperBackend(charsToScanFor, threadsCount);
+	}
+
+	Backend getGenericBackend(){
+		#ifdef SCANBYTES_JIT_SUPPORTED
+		if(getTier() != Tier::Scalar){  // the generated code uses SSE2
+			return Backend::JIT;
+		}
+		#endif
+		return Backend::Fallback;
+	}
+
+	template<typename OffsetT>
+	OffsetsST<OffsetT> scanWithBackend(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state, uint16_t threadsCount){
+		auto d = makeDetectorScanner(b, charsToScanFor);
+		ThreadPool pool(getWorkersCount(m, threadsCount));
+		if constexpr(std::is_same_v<OffsetT, uint32_t>){
+			return d->scanNarrow(m, state, pool);
+		} else {
+			return d->scan(m, state, pool);
+		}
+	}
+
+	uint8_t getOffsetWidth(uint64_t dataEnd){
+		return dataEnd <= std::numeric_limits<uint32_t>::max() ? sizeof(uint32_t) : sizeof(uint64_t);
+	}
+
+	template<typename OffsetT>
+	OffsetsST<OffsetT> scanAs(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state){
+		auto s = charsToScanFor.size();
+		if(!s){
+			throw std::logic_error("Set of the chars must be not empty");
+		}
+		if(sizeof(OffsetT) < getOffsetWidth(state.base + m.size())){
+			throw std::logic_error("The offsets of the data don't fit into " + std::to_string(sizeof(OffsetT)) + " bytes");
+		}
+		uint16_t threadsCount = getThreadsCount();
+		if(b == Backend::Auto){
+			b = detectProperBackendInternal(charsToScanFor, s, threadsCount);
+		}
+		auto res = scanWithBackend<OffsetT>(m, charsToScanFor, b, state, threadsCount);
+		state.base += m.size();
+		return res;
+	}
+
+	template NarrowNBST scanAs<uint32_t>(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state);
+	template NBST scanAs<uint64_t>(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state);
+
+	NBST scan(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state){
+		return scanAs<uint64_t>(m, charsToScanFor, b, state);
+	}
+
+	NBST scan(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b){
+		ScanState state;
+		return scan(m, charsToScanFor, b, state);
+	}
+
+	NBST scanTagged(ScannableT m, std::vector<uint8_t> charsToScanFor, uint8_t recordDelimiter, Backend b, ScanState &state){
+		auto s = charsToScanFor.size();
+		if(!s){
+			throw std::logic_error("Set of the chars must be not empty");
+		}
+		if(b == Backend::Sequences){
+			throw std::logic_error("Fields indices need single-byte delimiters");
+		}
+		if(std::find(begin(charsToScanFor), end(charsToScanFor), recordDelimiter) == end(charsToScanFor)){
+			throw std::logic_error("The record delimiter must be one of the chars");
+		}
+		uint16_t threadsCount = getThreadsCount();
+		if(b == Backend::Auto){
+			b = detectProperBackendInternal(charsToScanFor, s, threadsCount);
+		}
+		auto d = makeDetectorScanner(b, charsToScanFor);
+		ThreadPool pool(getWorkersCount(m, threadsCount));
+		auto res = d->scanTagged(m, state, recordDelimiter, pool);
+		state.base += m.size();
+		return res;
+	}
+
+	size_t getRecordsTasksCount(ScannableT m){
+		return getTasksCount(m);
+	}
+
+	void scanRecords(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, RecordsSinkT sink, NBST *offsets){
+		auto s = charsToScanFor.size();
+		if(!s){
+			throw std::logic_error("Set of the chars must be not empty");
+		}
+		uint16_t threadsCount = getThreadsCount();
+		if(b == Backend::Auto){
+			b = detectProperBackendInternal(charsToScanFor, s, threadsCount);
+		}
+		auto d = makeDetectorScanner(b, charsToScanFor);
+		ThreadPool pool(getWorkersCount(m, threadsCount));
+		d->scanRecords(m, sink, offsets, pool);
+	}
+
+	void countWithBackend(ScannableT m, std::vector<uint8_t> &charsToScanFor, Backend b, ScanState &state, size_t blockSize, uint64_t *counts){
+		auto s = charsToScanFor.size();
+		if(!s){
+			throw std::logic_error("Set of the chars must be not empty");
+		}
+		uint16_t threadsCount = getThreadsCount();
+		if(b == Backend::Auto){
+			b = detectProperBackendInternal(charsToScanFor, s, threadsCount);
+		}
+		auto d = makeDetectorScanner(b, charsToScanFor);
+		ThreadPool pool(getWorkersCount(m, threadsCount));
+		d->count(m, state, blockSize, counts, pool);
+		state.base += m.size();
+	}
+
+	uint64_t count(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, ScanState &state){
+		uint64_t res = 0;
+		countWithBackend(m, charsToScanFor, b, state, std::max<size_t>(m.size(), 1), &res);
+		return res;
+	}
+
+	uint64_t count(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b){
+		ScanState state;
+		return count(m, charsToScanFor, b, state);
+	}
+
+	std::vector<uint64_t> countPerBlock(ScannableT m, std::vector<uint8_t> charsToScanFor, Backend b, size_t blockSize){
+		if(!blockSize){
+			throw std::logic_error("Block size must be not zero");
+		}
+		std::vector<uint64_t> res((m.size() + blockSize - 1) / blockSize);
+		ScanState state;
+		countWithBackend(m, charsToScanFor, b, state, blockSize, res.data());
+		return res;
+	}
+
+	/// Up to this many chars a histogram is counted with a SIMD pass per char over every window, which stays in L1, above it a table of all the bytes is cheaper
+	const size_t maxHistogramPasses = 16;
+
+	void countEachCharTask(const Kernels::KernelSet *kernels, std::vector<uint8_t> &charsToScanFor, const uint8_t *begin, const uint8_t *end, std::vector<uint64_t> &counts){
+		if(kernels && charsToScanFor.size() <= maxHistogramPasses){
+			for(const uint8_t *p = begin; p < end;){
+				const uint8_t *windowEnd = p + std::min<size_t>(scanWindowSize, end - p);
+				const uint8_t *blocksEnd = p + ((windowEnd - p) & ~(Kernels::blockSize - 1));
+				for(size_t i = 0; i < charsToScanFor.size(); ++i){
+					Kernels::CompareParams params{.charz = {charsToScanFor[i]}};
+					counts[i] += kernels->compareCount[0](params, p, blocksEnd);
+				}
+				for(; blocksEnd < windowEnd; ++blocksEnd){
+					for(size_t i = 0; i < charsToScanFor.size(); ++i){
+						counts[i] += *blocksEnd == charsToScanFor[i];
+					}
+				}
+				p = windowEnd;
+			}
+		} else {
+			uint64_t bytesCounts[256]{};
+			for(const uint8_t *p = begin; p < end; ++p){
+				++bytesCounts[*p];
+			}
+			for(size_t i = 0; i < charsToScanFor.size(); ++i){
+				counts[i] += bytesCounts[charsToScanFor[i]];
+			}
+		}
+	}
+
+	std::vector<uint64_t> countEachChar(ScannableT m, std::vector<uint8_t> charsToScanFor){
+		std::vector<uint64_t> res(charsToScanFor.size());
+		auto kernels = Kernels::getKernels(getTier());
+		std::mutex lock;
+		ThreadPool pool(getWorkersCount(m));
+		runTasks(m, [&](uint16_t worker, WorkStealingQueue &q){
+			std::vector<uint64_t> counts(charsToScanFor.size());
+			size_t task;
+			while(q.next(worker, task)){
+				size_t start = task * scanTaskSize;
+				countEachCharTask(kernels, charsToScanFor, &m[start], &m[0] + std::min(start + scanTaskSize, m.size()), counts);
+			}
+			std::lock_guard<std::mutex> guard(lock);
+			for(size_t i = 0; i < counts.size(); ++i){
+				res[i] += counts[i];
+			}
+		}, pool);
+		return res;
+	}
+
 	BenchmarkResultT benchmark(Backend b, ScannableT m, std::vector<uint8_t> charsToScanFor, uint8_t benchmarkAttempts){
 		switch(b){
+			#ifdef SCANBYTES_JIT_SUPPORTED
 			case Backend::JIT:
 				return benchmarkWithDetector<Backend::JIT>(m, charsToScanFor, benchmarkAttempts);
 			break;
+			#endif
 			case Backend::Fallback:
 				return benchmarkWithDetector<Backend::Fallback>(m, charsToScanFor, benchmarkAttempts);
 			break;
@@ -215,6 +1367,32 @@ namespace ScanBytes{
 			case Backend::TSV:
 				return benchmarkWithDetector<Backend::TSV>(m, charsToScanFor, benchmarkAttempts);
 			break;
+			case Backend::Space:
+				return benchmarkWithDetector<Backend::Space>(m, charsToScanFor, benchmarkAttempts);
+			break;
+			case Backend::Punct:
+				return benchmarkWithDetector<Backend::Punct>(m, charsToScanFor, benchmarkAttempts);
+			break;
+			case Backend::CharSet:
+				if(auto e = findCharSet(charsToScanFor)){
+					return e->benchmark(m, charsToScanFor, benchmarkAttempts);
+				}
+				throw std::logic_error("CharSet backend has no detector compiled for the alphabet");
+			break;
+			case Backend::CSVQuoted:
+				return benchmarkWithDetector<Backend::CSVQuoted>(m, charsToScanFor, benchmarkAttempts);
+			break;
+			case Backend::Sequences:
+				return benchmarkWithDetector<Backend::Sequences>(m, charsToScanFor, benchmarkAttempts);
+			break;
+			#ifdef SCANBYTES_SIMD_SUPPORTED
+			case Backend::SIMD:
+				return benchmarkWithDetector<Backend::SIMD>(m, charsToScanFor, benchmarkAttempts);
+			break;
+			case Backend::Shuffle:
+				return benchmarkWithDetector<Backend::Shuffle>(m, charsToScanFor, benchmarkAttempts);
+			break;
+			#endif
 			default:
 				throw std::logic_error("Unknown backend");
 		}
@@ -222,7 +1400,7 @@ namespace ScanBytes{
 
 	void sortIndices(NBST &chunks){
 		std::sort(begin(chunks), end(chunks), [](auto &a, auto &b) -> bool {
-			return (*a) <= (*b);
+			return (*a) < (*b);
 		});
 	}
 
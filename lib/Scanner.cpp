@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ScanBytes/Scanner.hpp>
+#include "DetectorScanner.hpp"
+
+namespace ScanBytes{
+
+	namespace {
+		std::string describeErrno(const std::string &what, const std::string &path){
+			return what + " " + path + ": " + std::error_code(errno, std::generic_category()).message();
+		}
+
+		/// Returns the count of bytes read, -1 on error
+		ssize_t readFully(int fd, uint8_t *buf, size_t size){
+			size_t done = 0;
+			while(done < size){
+				ssize_t r = read(fd, buf + done, size - done);
+				if(r < 0){
+					if(errno == EINTR){
+						continue;
+					}
+					return -1;
+				}
+				if(!r){
+					break;
+				}
+				done += r;
+			}
+			return done;
+		}
+
+		struct MappedFile{
+			uint8_t *map = nullptr;
+			size_t size = 0;
+
+			~MappedFile(){
+				if(map){
+					munmap(map, size);
+				}
+			}
+		};
+	};
+
+	struct Scanner::Impl{
+		std::unique_ptr<DetectorScanner> detector;
+		ThreadPool pool;
+
+		Impl(Backend b, std::vector<uint8_t> &charsToScanFor, uint16_t threadsCount): detector(makeDetectorScanner(b, charsToScanFor)), pool(threadsCount){}
+	};
+
+	Scanner::Scanner(std::vector<uint8_t> charsToScanFor, Backend b){
+		if(charsToScanFor.empty()){
+			throw std::logic_error("Set of the chars must be not empty");
+		}
+		uint16_t threadsCount = getThreadsCount();
+		if(b == Backend::Auto){
+			b = detectProperBackend(charsToScanFor, threadsCount);
+		}
+		backend = b;
+		impl = std::make_unique<Impl>(b, charsToScanFor, threadsCount);
+	}
+
+	Scanner::~Scanner() = default;
+
+	NBST Scanner::scan(ScannableT m, ScanState &state){
+		auto res = impl->detector->scan(m, state, impl->pool);
+		state.base += m.size();
+		return res;
+	}
+
+	NBST Scanner::scan(ScannableT m){
+		ScanState state;
+		return scan(m, state);
+	}
+
+	uint64_t Scanner::count(ScannableT m, ScanState &state){
+		uint64_t res = 0;
+		impl->detector->count(m, state, std::max<size_t>(m.size(), 1), &res, impl->pool);
+		state.base += m.size();
+		return res;
+	}
+
+	uint64_t Scanner::count(ScannableT m){
+		ScanState state;
+		return count(m, state);
+	}
+
+	std::vector<uint64_t> Scanner::countPerBlock(ScannableT m, size_t blockSize){
+		if(!blockSize){
+			throw std::logic_error("Block size must be not zero");
+		}
+		std::vector<uint64_t> res((m.size() + blockSize - 1) / blockSize);
+		ScanState state;
+		impl->detector->count(m, state, blockSize, res.data(), impl->pool);
+		return res;
+	}
+
+	void Scanner::scanRecords(ScannableT m, RecordsSinkT sink, NBST *offsets){
+		impl->detector->scanRecords(m, sink, offsets, impl->pool);
+	}
+
+	std::vector<FileError> Scanner::scanFiles(const std::vector<std::string> &paths, FileSinkT sink){
+		std::vector<FileError> errors;
+		std::vector<size_t> largeFiles;
+		std::mutex lock;
+
+		auto addError = [&](size_t i, std::string message){
+			std::lock_guard<std::mutex> guard(lock);
+			errors.emplace_back(FileError{i, std::move(message)});
+		};
+
+		runTasks(paths.size(), [&](uint16_t worker, WorkStealingQueue &q){
+			std::vector<uint8_t> buffer(scanTaskSize + 1);  // a byte more to notice a file that has grown after fstat
+			std::vector<uint32_t> offsets(scanWindowSize), altOffsets(scanWindowSize);
+			size_t i;
+			while(q.next(worker, i)){
+				int fd = open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+				if(fd < 0){
+					addError(i, describeErrno("Cannot open", paths[i]));
+					continue;
+				}
+				struct stat st;
+				ssize_t size = -1;
+				if(!fstat(fd, &st) && static_cast<size_t>(st.st_size) <= scanTaskSize){
+					size = readFully(fd, buffer.data(), buffer.size());
+					if(size < 0){
+						addError(i, describeErrno("Cannot read", paths[i]));
+						close(fd);
+						continue;
+					}
+				}
+				close(fd);
+
+				if(size < 0 || static_cast<size_t>(size) > scanTaskSize){
+					std::lock_guard<std::mutex> guard(lock);
+					largeFiles.emplace_back(i);
+					continue;
+				}
+
+				ScannableT m{buffer.data(), static_cast<size_t>(size)};
+				ScanState state;
+				auto res = impl->detector->scanInThisThread(m, state, offsets, altOffsets);  // a single thread fills the blocks in order
+				state.base += m.size();
+				sink(i, m, res, state);
+			}
+		}, impl->pool);
+
+		std::sort(begin(largeFiles), end(largeFiles));
+		for(auto i: largeFiles){
+			int fd = open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+			if(fd < 0){
+				addError(i, describeErrno("Cannot open", paths[i]));
+				continue;
+			}
+			struct stat st;
+			if(fstat(fd, &st)){
+				addError(i, describeErrno("Cannot stat", paths[i]));
+				close(fd);
+				continue;
+			}
+			MappedFile f;
+			f.size = st.st_size;
+			if(f.size){
+				void *map = mmap(nullptr, f.size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if(map == MAP_FAILED){
+					addError(i, describeErrno("Cannot map", paths[i]));
+					close(fd);
+					continue;
+				}
+				f.map = static_cast<uint8_t *>(map);
+			}
+			close(fd);
+
+			ScannableT m{f.map, f.size};
+			ScanState state;
+			auto res = scan(m, state);
+			sink(i, m, res, state);
+		}
+
+		std::sort(begin(errors), end(errors), [](auto &a, auto &b){
+			return a.fileIndex < b.fileIndex;
+		});
+		return errors;
+	}
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <ScanBytes/ScanBytes.hpp>
+#include "kernels/Kernels.hpp"
+
+/*
+Finds several multi-byte sequences at once. The candidates are the positions where the first byte of a sequence is followed by its last byte at the right distance, every candidate is then compared with the sequences.
+The pair kernels are used if the sequences have at most `maxPairs` distinct (first byte, last byte, length) triples, otherwise the candidates are the first bytes found with a table.
+Whether a position is covered by a match depends on the matches before it, so a task assumes that no match reaches into it from the previous one, `scan` fixes the beginnings of the tasks up where it is wrong.
+*/
+struct SequencesDetector{
+	std::vector<std::string> sequences; // the longest first, so the longest of the ones starting at a position matches
+	bool isFirst[256]{};
+	size_t maxDistance = 0; // of the last byte of a sequence from its first one
+
+	ScanBytes::Kernels::PairParams params;
+	ScanBytes::Kernels::PairKernelT kernel = nullptr;
+
+	inline SequencesDetector(std::vector<uint8_t> &v): sequences(ScanBytes::decodeSequences(v)){
+		std::sort(begin(sequences), end(sequences), [](auto &a, auto &b){
+			return a.size() != b.size() ? a.size() > b.size() : a < b;
+		});
+		sequences.erase(std::unique(begin(sequences), end(sequences)), end(sequences));
+
+		uint8_t pairsCount = 0;
+		bool pairsFit = true;
+		for(auto &s: sequences){
+			uint8_t first = s.front(), last = s.back(), distance = s.size() - 1;
+			isFirst[first] = true;
+			maxDistance = std::max<size_t>(maxDistance, distance);
+
+			bool known = false;
+			for(uint8_t i = 0; i < pairsCount; ++i){
+				known |= params.first[i] == first && params.last[i] == last && params.distances[i] == distance;
+			}
+			if(known){
+				continue;
+			}
+			if(pairsCount == ScanBytes::Kernels::maxPairs){
+				pairsFit = false;
+				continue;
+			}
+			params.first[pairsCount] = first;
+			params.last[pairsCount] = last;
+			params.distances[pairsCount] = distance;
+			++pairsCount;
+		}
+
+		#ifdef SCANBYTES_SIMD_SUPPORTED
+		auto kernels = ScanBytes::Kernels::getKernels(ScanBytes::getTier());
+		if(kernels && pairsFit){
+			kernel = kernels->pairs[pairsCount - 1];
+		}
+		#endif
+	}
+
+	/// Whether a sequence starts with the byte, used to estimate the count of the matches
+	inline bool operator()(uint8_t c){
+		return isFirst[c];
+	}
+
+	/// Length of the longest sequence at `p` ending before `limit`, 0 if there is none
+	inline size_t matchAt(const uint8_t *p, const uint8_t *limit){
+		for(auto &s: sequences){
+			if(s.size() <= static_cast<size_t>(limit - p) && !memcmp(p, s.data(), s.size())){
+				return s.size();
+			}
+		}
+		return 0;
+	}
+
+	/// Offsets (relative to `begin`) of the positions within [begin, end) a sequence may start at. The bytes up to `limit` can be read.
+	inline uint32_t *candidates(const uint8_t *begin, const uint8_t *end, const uint8_t *limit, uint32_t *out){
+		const uint8_t *blocksEnd = begin;
+		if(kernel && static_cast<size_t>(limit - begin) > maxDistance){
+			size_t readable = std::min<size_t>(end - begin, limit - begin - maxDistance);
+			blocksEnd += readable & ~(ScanBytes::Kernels::blockSize - 1);
+			out = kernel(params, begin, blocksEnd, out);
+		}
+		for(const uint8_t *p = blocksEnd; p < end; ++p){
+			if(isFirst[*p]){
+				*(out++) = p - begin;
+			}
+		}
+		return out;
+	}
+
+	/// Writes the offsets (relative to `begin`) of the last bytes of the matches starting within [begin, end) and not before `from` into `out`, which must have space for `end - begin` of them. Advances `from` past every match. The lengths of the matches go into `lengths` if it is set.
+	inline uint32_t *scanWindow(const uint8_t *begin, const uint8_t *end, const uint8_t *limit, const uint8_t *&from, uint32_t *out, uint8_t *lengths = nullptr){
+		uint32_t *candidatesEnd = candidates(begin, end, limit, out);
+		uint32_t *res = out;  // a match is never written past its candidate, so they share the buffer
+		for(uint32_t *c = out; c < candidatesEnd; ++c){
+			const uint8_t *p = begin + *c;
+			if(p < from){
+				continue;
+			}
+			if(auto length = matchAt(p, limit)){
+				if(lengths){
+					lengths[res - out] = length;
+				}
+				*(res++) = *c + length - 1;
+				from = p + length;
+			}
+		}
+		return res;
+	}
+
+	/// The last byte of the first match starting within [from, stop), nullptr if there is none. Used for the few bytes around the boundaries, so it is scalar.
+	inline const uint8_t *next(const uint8_t *from, const uint8_t *stop, const uint8_t *limit){
+		for(const uint8_t *p = from; p < stop; ++p){
+			if(isFirst[*p]){
+				if(auto length = matchAt(p, limit)){
+					return p + length - 1;
+				}
+			}
+		}
+		return nullptr;
+	}
+};
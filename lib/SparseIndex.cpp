@@ -0,0 +1,68 @@
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <ScanBytes/IndexFormat.hpp>
+#include "SparseIndex.hpp"
+
+namespace ScanBytes{
+
+	SparseAlphabet::SparseAlphabet(const std::vector<uint8_t> &chars){
+		for(auto c: chars){
+			bits[c / 8] |= 1 << (c % 8);
+		}
+	}
+
+	std::vector<uint8_t> SparseAlphabet::chars() const{
+		std::vector<uint8_t> res;
+		for(unsigned c = 0; c < 256; ++c){
+			if(bits[c / 8] & (1 << (c % 8))){
+				res.emplace_back(c);
+			}
+		}
+		return res;
+	}
+
+	Backend resolveSparseBackend(Backend b, std::vector<uint8_t> &charsToScanFor){
+		if(b == Backend::Auto){
+			b = detectProperBackend(charsToScanFor);
+		}
+		if(b == Backend::CSVQuoted || b == Backend::Sequences){
+			throw std::logic_error(std::string("Sparse indices are rescanned block by block, which ") + backendNames[static_cast<uint8_t>(b)] + " backend cannot do");
+		}
+		return b;
+	}
+
+	void setEndsWithMatch(IndexHeader &h, ScannableT data, const SparseAlphabet &alphabet){
+		bool endsWithMatch = !data.empty() && (alphabet.bits[data.back() / 8] & (1 << (data.back() % 8)));
+		h.flags = endsWithMatch ? (h.flags | IndexFlags::endsWithMatch) : (h.flags & ~IndexFlags::endsWithMatch);
+	}
+
+	void appendCheckpoints(ScannableT data, std::vector<uint8_t> &charsToScanFor, Backend b, uint32_t blockSize, std::vector<uint64_t> &checkpoints){
+		if(data.empty()){
+			return;
+		}
+		for(auto c: countPerBlock(data, charsToScanFor, b, blockSize)){
+			checkpoints.emplace_back(checkpoints.back() + c);
+		}
+	}
+
+	void writeSparseIndex(ScannableT data, std::vector<uint8_t> charsToScanFor, Backend b, std::ostream &out, uint32_t blockSize){
+		if(!blockSize){
+			throw std::logic_error("Block size must be not zero");
+		}
+		b = resolveSparseBackend(b, charsToScanFor);
+		std::vector<uint64_t> checkpoints{0};
+		appendCheckpoints(data, charsToScanFor, b, blockSize, checkpoints);
+
+		IndexHeader h{IndexFormat::Sparse, checkpoints.back()};
+		h.setData(data);
+		h.frameSize = blockSize;
+		h.backend = b;
+		SparseAlphabet alphabet{charsToScanFor};
+		setEndsWithMatch(h, data, alphabet);
+		out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+		out.write(reinterpret_cast<const char *>(&alphabet), sizeof(alphabet));
+		out.write(reinterpret_cast<const char *>(checkpoints.data()), checkpoints.size() * sizeof(checkpoints[0]));
+	}
+};
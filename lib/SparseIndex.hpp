@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <ScanBytes/IndexFormat.hpp>
+
+namespace ScanBytes{
+	/// Resolves Auto, throws std::logic_error for the backends whose matches cannot be found within a block without the bytes before it
+	Backend resolveSparseBackend(Backend b, std::vector<uint8_t> &charsToScanFor);
+
+	/// Sets `endsWithMatch` flag of the header of the index of `data`
+	void setEndsWithMatch(IndexHeader &h, ScannableT data, const SparseAlphabet &alphabet);
+
+	/// Counts the matches within every `blockSize` bytes of `data` and appends the count of the matches till the end of every block to `checkpoints`, continuing from its last one. `data` must start at a block boundary, `b` must be resolved.
+	void appendCheckpoints(ScannableT data, std::vector<uint8_t> &charsToScanFor, Backend b, uint32_t blockSize, std::vector<uint64_t> &checkpoints);
+};
@@ -0,0 +1,34 @@
+#include "Stats.hpp"
+
+namespace ScanBytes{
+
+	ThreadStats &ThreadStats::operator+=(const ThreadStats &o){
+		bytes += o.bytes;
+		matches += o.matches;
+		tasks += o.tasks;
+		steals += o.steals;
+		busyNs += o.busyNs;
+		arenas += o.arenas;
+		blocks += o.blocks;
+		lockWaitNs += o.lockWaitNs;
+		minorFaults += o.minorFaults;
+		majorFaults += o.majorFaults;
+		return *this;
+	}
+
+	ThreadStats ScanStats::total() const{
+		ThreadStats res;
+		for(auto &t: threads){
+			res += t;
+		}
+		return res;
+	}
+
+	double ScanStats::throughput() const{
+		return wallNs ? bytes * 1e9 / wallNs : 0.;
+	}
+
+	bool areStatsCompiledIn(){
+		return statsCompiledIn;
+	}
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+
+#include <sys/resource.h>
+
+#include <ScanBytes/ScanBytes.hpp>
+#include <ScanBytes/ScanStats.hpp>
+#include "Threading.hpp"
+
+namespace ScanBytes{
+
+	#ifdef SCANBYTES_STATS
+	constexpr bool statsCompiledIn = true;
+	#else
+	constexpr bool statsCompiledIn = false;
+	#endif
+
+	/// Null if the stats are not compiled in, so everything guarded by `if(stats)` is optimized out
+	inline ScanStats *getStats(ScanState &state){
+		if constexpr(statsCompiledIn){
+			return state.stats;
+		}
+		return nullptr;
+	}
+
+	inline uint64_t nowNs(){
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// Adds a whole scan to the stats when it is destroyed
+	struct ScanRecorder{
+		ScanStats *stats;
+		uint64_t bytes;
+		uint64_t start = 0;
+		uint64_t matches = 0; // set by the scan when it has the results
+
+		inline ScanRecorder(ScanStats *stats, uint64_t bytes, ThreadPool &pool): stats(stats), bytes(bytes){
+			if(stats){
+				stats->threads.resize(std::max<size_t>(stats->threads.size(), pool.size()));
+				start = nowNs();
+			}
+		}
+
+		inline ~ScanRecorder(){
+			if(stats){
+				stats->wallNs += nowNs() - start;
+				stats->bytes += bytes;
+				stats->matches += matches;
+				++stats->scans;
+			}
+		}
+
+		template<typename StorageT>
+		inline void setResults(StorageT &chunks){
+			if(stats){
+				for(auto &chunk: chunks){
+					matches += chunk->vec.size();
+				}
+			}
+		}
+	};
+
+	/// Adds the tasks, the page faults and the allocations of a worker to its stats
+	struct WorkerRecorder{
+		ThreadStats *ts;
+		rusage startUsage;
+
+		inline WorkerRecorder(ScanStats *stats, uint16_t worker): ts(stats ? &stats->threads[worker] : nullptr){
+			if(ts){
+				getrusage(RUSAGE_THREAD, &startUsage);
+			}
+		}
+
+		inline ~WorkerRecorder(){
+			if(ts){
+				rusage usage;
+				getrusage(RUSAGE_THREAD, &usage);
+				ts->minorFaults += usage.ru_minflt - startUsage.ru_minflt;
+				ts->majorFaults += usage.ru_majflt - startUsage.ru_majflt;
+			}
+		}
+
+		/// Returns the start time to pass to `endTask`
+		inline uint64_t startTask(){
+			return ts ? nowNs() : 0;
+		}
+
+		inline void endTask(uint64_t start, uint64_t bytes, uint64_t matches = 0){
+			if(ts){
+				ts->busyNs += nowNs() - start;
+				ts->bytes += bytes;
+				ts->matches += matches;
+				++ts->tasks;
+			}
+		}
+
+		inline void addSteals(WorkStealingQueue &q, uint16_t worker){
+			if(ts){
+				ts->steals += q.ranges[worker].steals;
+			}
+		}
+
+		/// Hands the blocks of `t` over to get its final stats
+		template<typename TAllocT>
+		inline void addAllocator(TAllocT &t){
+			if(ts){
+				t.finalize();
+				ts->arenas += t.stats.arenas;
+				ts->blocks += t.stats.blocks;
+				ts->matches += t.stats.values;
+				ts->lockWaitNs += t.stats.lockWaitNs;
+			}
+		}
+	};
+};
@@ -0,0 +1,241 @@
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <system_error>
+#include <stdexcept>
+#include <memory>
+#include <new>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <ScanBytes/Stream.hpp>
+#include <ScanBytes/Scanner.hpp>
+#include <ScanBytes/IOEngine.hpp>
+
+namespace ScanBytes{
+	namespace{
+		/// Buffers are passed between the reader thread and the scanning one through the queues of their indices
+		struct BuffersExchange{
+			std::mutex mutex;
+			std::condition_variable changed;
+			std::deque<uint8_t> free, filled;
+			std::vector<size_t> sizes;
+			bool stopped = false; // the scanning thread has given up, the reader must quit
+			bool eof = false; // the reader won't fill anything anymore
+			int error = 0;
+			int wakeFds[2]; // a pipe written by `stop`, so a reader waiting for the data of a pipe or a socket quits
+
+			BuffersExchange(){
+				if(pipe2(wakeFds, O_CLOEXEC | O_NONBLOCK)){
+					throw std::system_error(errno, std::generic_category(), "Cannot create a pipe");
+				}
+			}
+
+			~BuffersExchange(){
+				close(wakeFds[0]);
+				close(wakeFds[1]);
+			}
+
+			bool waitFree(uint8_t &idx){
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&]{return stopped || !free.empty();});
+				if(stopped){
+					return false;
+				}
+				idx = free.front();
+				free.pop_front();
+				return true;
+			}
+
+			void putFilled(uint8_t idx, size_t size, bool isLast, int err){
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					sizes[idx] = size;
+					if(size){
+						filled.emplace_back(idx);
+					} else {
+						free.emplace_back(idx);
+					}
+					eof = isLast;
+					error = err;
+				}
+				changed.notify_all();
+			}
+
+			/// Returns false when there are no more data
+			bool waitFilled(uint8_t &idx){
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&]{return eof || !filled.empty();});
+				if(filled.empty()){
+					if(error){
+						throw std::system_error(error, std::generic_category(), "Cannot read the stream");
+					}
+					return false;
+				}
+				idx = filled.front();
+				filled.pop_front();
+				return true;
+			}
+
+			void putFree(uint8_t idx){
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					free.emplace_back(idx);
+				}
+				changed.notify_all();
+			}
+
+			void stop(){
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopped = true;
+				}
+				changed.notify_all();
+				uint8_t b = 0;
+				[[maybe_unused]] auto r = write(wakeFds[1], &b, sizeof(b));
+			}
+		};
+
+		/*
+		Fills the whole buffer unless EOF or an error is reached or `wakeFd` gets readable, pipes usually give less than asked. Only a read of 0 bytes is EOF. The data is waited for with `poll`, a blocking `read` would keep the reader from noticing that the stream has been stopped.
+		A file opened with O_DIRECT can also return less than asked, reading it further is fine while the position stays aligned. From an unaligned one it would fail, so O_DIRECT is dropped from `fd` and the rest of the file is read through the page cache.
+		*/
+		size_t readFully(int fd, uint8_t *buf, size_t size, bool &isDirect, int wakeFd, int &err){
+			size_t done = 0;
+			while(done < size){
+				pollfd fds[2]{{.fd = fd, .events = POLLIN, .revents = 0}, {.fd = wakeFd, .events = POLLIN, .revents = 0}};
+				if(poll(fds, 2, -1) < 0){
+					if(errno == EINTR){
+						continue;
+					}
+					err = errno;
+					break;
+				}
+				if(fds[1].revents){
+					break;
+				}
+				ssize_t r = read(fd, buf + done, size - done);
+				if(r < 0){
+					if(errno == EINTR){
+						continue;
+					}
+					err = errno;
+					break;
+				}
+				if(!r){
+					break;
+				}
+				done += r;
+				if(isDirect && done < size && done % directIOAlignment){
+					int flags = fcntl(fd, F_GETFL);
+					if(flags == -1 || fcntl(fd, F_SETFL, flags & ~O_DIRECT)){
+						err = errno;
+						break;
+					}
+					isDirect = false;
+				}
+			}
+			return done;
+		}
+
+		struct FreeDeleter{
+			void operator()(uint8_t *p) const{
+				free(p);
+			}
+		};
+
+		/// Aligned to `directIOAlignment`, so the files opened with O_DIRECT can be read into it
+		using BufferT = std::unique_ptr<uint8_t, FreeDeleter>;
+
+		BufferT allocateBuffer(size_t size){
+			auto p = static_cast<uint8_t *>(aligned_alloc(directIOAlignment, (size + directIOAlignment - 1) / directIOAlignment * directIOAlignment));
+			if(!p){
+				throw std::bad_alloc();
+			}
+			return BufferT{p};
+		}
+
+		void readerThreadFunction(int fd, std::vector<BufferT> *buffers, size_t bufferSize, bool isDirect, BuffersExchange *ex){
+			uint8_t idx;
+			while(ex->waitFree(idx)){
+				auto buf = (*buffers)[idx].get();
+				int err = 0;
+				size_t size = readFully(fd, buf, bufferSize, isDirect, ex->wakeFds[0], err);
+				bool isLast = err || size < bufferSize;
+				ex->putFilled(idx, size, isLast, err);
+				if(isLast){
+					return;
+				}
+			}
+		}
+
+		/// Passes the buffers to `consume` in order while the reader thread fills the other ones
+		void readStream(int fd, size_t bufferSize, uint8_t buffersCount, std::function<void(ScannableT)> consume){
+			if(!bufferSize || buffersCount < 2){
+				throw std::logic_error("Streaming needs at least 2 non-empty buffers");
+			}
+			int flags = fcntl(fd, F_GETFL);
+			bool isDirect = flags != -1 && (flags & O_DIRECT);
+			if(isDirect && bufferSize % directIOAlignment){
+				throw std::logic_error("Buffers of O_DIRECT streams must be multiples of " + std::to_string(directIOAlignment) + " bytes");
+			}
+			std::vector<BufferT> buffers;
+			for(uint8_t i = 0; i < buffersCount; ++i){
+				buffers.emplace_back(allocateBuffer(bufferSize));
+			}
+			BuffersExchange ex;
+			ex.sizes.resize(buffersCount);
+			for(uint8_t i = 0; i < buffersCount; ++i){
+				ex.free.emplace_back(i);
+			}
+
+			std::thread reader(readerThreadFunction, fd, &buffers, bufferSize, isDirect, &ex);
+
+			try{
+				uint8_t idx;
+				while(ex.waitFilled(idx)){
+					consume(ScannableT{buffers[idx].get(), ex.sizes[idx]});
+					ex.putFree(idx);
+				}
+			} catch(...){
+				ex.stop();
+				reader.join();
+				throw;
+			}
+			reader.join();
+		}
+	};
+
+	uint64_t scanStream(int fd, std::vector<uint8_t> charsToScanFor, Backend b, StreamSinkT sink, ScanState &state, size_t bufferSize, uint8_t buffersCount){
+		Scanner scanner{charsToScanFor, b};
+		uint64_t start = state.base;
+		readStream(fd, bufferSize, buffersCount, [&](ScannableT m){
+			auto res = scanner.scan(m, state);
+			sink(res);
+		});
+		return state.base - start;
+	}
+
+	uint64_t scanStream(int fd, std::vector<uint8_t> charsToScanFor, Backend b, StreamSinkT sink, size_t bufferSize, uint8_t buffersCount, ScanStats *stats){
+		ScanState state{.stats = stats};
+		return scanStream(fd, charsToScanFor, b, sink, state, bufferSize, buffersCount);
+	}
+
+	uint64_t countStream(int fd, std::vector<uint8_t> charsToScanFor, Backend b, size_t bufferSize, uint8_t buffersCount, ScanStats *stats){
+		Scanner scanner{charsToScanFor, b};
+		ScanState state{.stats = stats};
+		uint64_t res = 0;
+		readStream(fd, bufferSize, buffersCount, [&](ScannableT m){
+			res += scanner.count(m, state);
+		});
+		return res;
+	}
+};
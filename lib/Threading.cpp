@@ -0,0 +1,369 @@
+#include <cstdint>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+
+#include <sched.h>
+#include <pthread.h>
+
+#include "Threading.hpp"
+
+namespace ScanBytes{
+
+	namespace {
+		std::atomic<uint16_t> threadsCountOverride{0};
+
+		/// The affinity mask respects `taskset` and cpusets of containers, unlike `hardware_concurrency`
+		uint16_t detectThreadsCount(){
+			size_t count = 0;
+			cpu_set_t set;
+			if(!sched_getaffinity(0, sizeof(set), &set)){
+				count = CPU_COUNT(&set);
+			}
+			if(!count){
+				count = std::thread::hardware_concurrency();
+			}
+			return std::clamp<size_t>(count, 1, std::numeric_limits<uint16_t>::max());
+		}
+	};
+
+	const char * threadPlacementNames[] = {
+		"Unknown",
+		"OS",
+		"Nodes",
+		"Cores",
+	};
+
+	std::unordered_map<std::string, ThreadPlacement> threadPlacementsByNames{
+		{threadPlacementNames[static_cast<uint8_t>(ThreadPlacement::OS)], ThreadPlacement::OS},
+		{threadPlacementNames[static_cast<uint8_t>(ThreadPlacement::Nodes)], ThreadPlacement::Nodes},
+		{threadPlacementNames[static_cast<uint8_t>(ThreadPlacement::Cores)], ThreadPlacement::Cores},
+	};
+
+	ThreadPlacement getThreadPlacementByName(std::string& name){
+		auto it = threadPlacementsByNames.find(name);
+		if(it == end(threadPlacementsByNames)){
+			return ThreadPlacement::Unknown;
+		}
+		return it->second;
+	}
+
+	namespace {
+		std::atomic<ThreadPlacement> placement{ThreadPlacement::OS};
+
+		/// `0-3,8,10-11` format of sysfs
+		std::vector<int> parseCPUList(const std::string &list){
+			std::vector<int> res;
+			size_t pos = 0;
+			while(pos < list.size()){
+				size_t stop = list.find(',', pos);
+				if(stop == std::string::npos){
+					stop = list.size();
+				}
+				auto range = list.substr(pos, stop - pos);
+				auto dash = range.find('-');
+				try{
+					int first = std::stoi(range.substr(0, dash));
+					int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+					for(int cpu = first; cpu <= last; ++cpu){
+						res.emplace_back(cpu);
+					}
+				} catch(std::logic_error &e){
+					// a newline or garbage, skipped
+				}
+				pos = stop + 1;
+			}
+			return res;
+		}
+
+		/// The CPUs the process was allowed to run on at start, grouped by their NUMA nodes
+		struct Topology{
+			cpu_set_t allowed;
+			std::vector<std::vector<int>> nodes;
+			size_t cpusCount = 0;
+
+			Topology(){
+				CPU_ZERO(&allowed);
+				if(sched_getaffinity(0, sizeof(allowed), &allowed)){
+					return;
+				}
+				std::vector<std::pair<int, std::vector<int>>> found;  // node number, its allowed CPUs
+				std::error_code ec;
+				for(auto &entry: std::filesystem::directory_iterator("/sys/devices/system/node", ec)){
+					auto name = entry.path().filename().string();
+					if(name.rfind("node", 0) || name.size() == 4 || name.find_first_not_of("0123456789", 4) != std::string::npos){
+						continue;
+					}
+					std::ifstream f(entry.path() / "cpulist");
+					std::string list;
+					std::getline(f, list);
+					std::vector<int> cpus;
+					for(auto cpu: parseCPUList(list)){
+						if(cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)){
+							cpus.emplace_back(cpu);
+						}
+					}
+					if(!cpus.empty()){
+						found.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+					}
+				}
+				std::sort(begin(found), end(found));
+				for(auto &node: found){
+					cpusCount += node.second.size();
+					nodes.emplace_back(std::move(node.second));
+				}
+				if(nodes.empty()){
+					nodes.emplace_back();
+					for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu){
+						if(CPU_ISSET(cpu, &allowed)){
+							nodes.back().emplace_back(cpu);
+						}
+					}
+					cpusCount = nodes.back().size();
+				}
+			}
+
+			/// The consecutive workers share a node, each node gets a count of them proportional to its CPUs
+			cpu_set_t getCPUs(uint16_t worker, uint16_t workersCount, ThreadPlacement p) const{
+				cpu_set_t res;
+				CPU_ZERO(&res);
+				size_t cpusBefore = 0;
+				for(auto &cpus: nodes){
+					size_t firstWorker = cpusBefore * workersCount / cpusCount;
+					cpusBefore += cpus.size();
+					size_t stopWorker = cpusBefore * workersCount / cpusCount;
+					if(worker >= stopWorker){
+						continue;
+					}
+					if(p == ThreadPlacement::Cores){
+						CPU_SET(cpus[(worker - firstWorker) % cpus.size()], &res);
+					} else {
+						for(auto cpu: cpus){
+							CPU_SET(cpu, &res);
+						}
+					}
+					return res;
+				}
+				return allowed;
+			}
+		};
+
+		const Topology &getTopology(){
+			static const Topology t;
+			return t;
+		}
+	};
+
+	ThreadPlacement getThreadPlacement(){
+		return placement.load(std::memory_order_relaxed);
+	}
+
+	void setThreadPlacement(ThreadPlacement p){
+		if(p != ThreadPlacement::OS && p != ThreadPlacement::Nodes && p != ThreadPlacement::Cores){
+			throw std::logic_error("Unknown thread placement");
+		}
+		getTopology();  // before anything is pinned
+		placement.store(p, std::memory_order_relaxed);
+	}
+
+	uint16_t getNUMANodesCount(){
+		return std::max<size_t>(getTopology().nodes.size(), 1);
+	}
+
+	bool placeThisThread(uint16_t worker, uint16_t workersCount){
+		auto p = getThreadPlacement();
+		if(p == ThreadPlacement::OS){
+			return false;
+		}
+		auto &t = getTopology();
+		if(!t.cpusCount){
+			return false;
+		}
+		auto cpus = t.getCPUs(worker, workersCount, p);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);  // only a hint, the scan works anyway
+		return true;
+	}
+
+	void unplaceThisThread(){
+		auto &allowed = getTopology().allowed;
+		pthread_setaffinity_np(pthread_self(), sizeof(allowed), &allowed);
+	}
+
+	uint16_t getThreadsCount(){
+		auto count = threadsCountOverride.load(std::memory_order_relaxed);
+		if(count){
+			return count;
+		}
+		static const uint16_t detected = detectThreadsCount();
+		return detected;
+	}
+
+	bool isThreadsCountSet(){
+		return threadsCountOverride.load(std::memory_order_relaxed);
+	}
+
+	void setThreadsCount(uint16_t count){
+		threadsCountOverride.store(count, std::memory_order_relaxed);
+	}
+
+	ThreadPool::ThreadPool(uint16_t threadsCount){
+		threads.reserve(threadsCount - 1);
+		for(uint16_t i = 1; i < threadsCount; ++i){
+			threads.emplace_back(&ThreadPool::workerFunction, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool(){
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		started.notify_all();
+		std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+	}
+
+	void ThreadPool::runJob(uint16_t id){
+		try{
+			(*job)(id);
+		} catch(...){
+			std::lock_guard<std::mutex> guard(lock);
+			if(!error){
+				error = std::current_exception();
+			}
+		}
+	}
+
+	void ThreadPool::workerFunction(uint16_t id){
+		uint64_t seenGeneration = 0;
+		bool isPlaced = false;
+		while(true){
+			uint16_t workersCount;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				started.wait(guard, [&]{return stopping || generation != seenGeneration;});
+				if(stopping){
+					return;
+				}
+				seenGeneration = generation;
+				if(id >= jobWorkers){
+					continue;
+				}
+				workersCount = jobWorkers;
+			}
+			// placed as a worker of the job, not of the pool, so a job on a part of the workers still spans the nodes
+			if(placeThisThread(id, workersCount)){
+				isPlaced = true;
+			} else if(isPlaced){
+				unplaceThisThread();
+				isPlaced = false;
+			}
+			runJob(id);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				--pending;
+			}
+			finished.notify_one();
+		}
+	}
+
+	void ThreadPool::run(uint16_t count, const JobT &f){
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			job = &f;
+			jobWorkers = count;
+			pending = count - 1;
+			error = nullptr;
+			++generation;
+		}
+		if(count > 1){
+			started.notify_all();
+		}
+		// the calling thread is the worker 0 only for the job, then its affinity is restored
+		cpu_set_t callerCPUs;
+		bool isPlaced = getThreadPlacement() != ThreadPlacement::OS && !pthread_getaffinity_np(pthread_self(), sizeof(callerCPUs), &callerCPUs) && placeThisThread(0, count);
+		runJob(0);
+		if(isPlaced){
+			pthread_setaffinity_np(pthread_self(), sizeof(callerCPUs), &callerCPUs);
+		}
+
+		std::unique_lock<std::mutex> guard(lock);
+		finished.wait(guard, [&]{return !pending;});
+		job = nullptr;
+		if(error){
+			std::rethrow_exception(std::exchange(error, nullptr));
+		}
+	}
+
+	WorkStealingQueue::WorkStealingQueue(size_t tasksCount, uint16_t workersCount): workersCount(workersCount), ranges(new Range[workersCount]){
+		size_t shareSize = tasksCount / workersCount;
+		size_t remainder = tasksCount % workersCount;
+		size_t start = 0;
+		for(uint16_t i = 0; i < workersCount; ++i){
+			ranges[i].next = start;
+			start += shareSize + (i < remainder);
+			ranges[i].stop = start;
+		}
+	}
+
+	uint16_t WorkStealingQueue::getInitialWorker(size_t task, size_t tasksCount, uint16_t workersCount){
+		size_t shareSize = tasksCount / workersCount;
+		size_t remainder = tasksCount % workersCount;
+		size_t longShares = remainder * (shareSize + 1);  // the first `remainder` ranges have a task more
+		if(task < longShares){
+			return task / (shareSize + 1);
+		}
+		return remainder + (task - longShares) / shareSize;
+	}
+
+	bool WorkStealingQueue::next(uint16_t worker, size_t &task){
+		auto &own = ranges[worker];
+		do{
+			bool isTaken = false;
+			{
+				std::lock_guard<std::mutex> guard(own.lock);
+				if(own.next < own.stop){
+					task = own.next++;
+					isTaken = true;
+				}
+			}
+			if(isTaken){
+				if(onProgress){
+					onProgress();
+				}
+				return true;
+			}
+		} while(steal(worker));
+		return false;
+	}
+
+	bool WorkStealingQueue::steal(uint16_t worker){
+		for(uint16_t i = 1; i < workersCount; ++i){
+			auto &victim = ranges[(worker + i) % workersCount];
+			size_t first, stop;
+			{
+				std::lock_guard<std::mutex> guard(victim.lock);
+				size_t remaining = victim.stop - victim.next;
+				if(!remaining){
+					continue;
+				}
+				stop = victim.stop;
+				first = stop - (remaining + 1) / 2;
+				victim.stop = first;
+			}
+			auto &own = ranges[worker];
+			std::lock_guard<std::mutex> guard(own.lock);
+			own.next = first;
+			own.stop = stop;
+			++own.steals;
+			return true;
+		}
+		return false;
+	}
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+#include <ScanBytes/ScanBytes.hpp>
+
+namespace ScanBytes{
+
+	/// Whether the count of threads has been set with `setThreadsCount` rather than detected
+	bool isThreadsCountSet();
+
+	/// Pins the calling thread according to `getThreadPlacement()` as the worker `worker` of `workersCount`. Returns false if the placement is OS, then it does nothing.
+	bool placeThisThread(uint16_t worker, uint16_t workersCount);
+
+	/// Restores the affinity the process had at start for the threads that have been placed
+	void unplaceThisThread();
+
+	/// Splits `s` items into `procsCount` equal shares and calls `f(id, start, stop)` for each of them in its own thread, placed as the worker `id`
+	template<typename ThreadFuncT>
+	void runOnShares(size_t s, ThreadFuncT f, uint16_t procsCount = getThreadsCount()){
+		uint16_t lastProc = procsCount - 1;
+
+		size_t shareSize = s / procsCount;
+
+		std::vector<std::thread> threadList;
+
+		auto placed = [&f, procsCount](uint16_t id, size_t start, size_t stop){
+			placeThisThread(id, procsCount);
+			f(id, start, stop);
+		};
+
+		for(uint16_t i = 0; i < lastProc; ++i){
+			size_t start = shareSize * i;
+			size_t stop = start + shareSize;
+			threadList.emplace_back(std::thread(placed, i, start, stop));
+		}
+		threadList.emplace_back(std::thread(placed, lastProc, shareSize * lastProc, s));
+		std::for_each(threadList.begin(),threadList.end(), std::mem_fn(&std::thread::join));
+	}
+
+	/*
+	Every worker starts with an equal contiguous range of tasks and takes them from its front. A worker having run out of tasks steals the back half of the remaining range of another one.
+	So the tasks processed by a worker are mostly adjacent, but a descheduled thread or one stuck on cold pages doesn't hold up the others.
+	The ranges are guarded by mutexes: a task is much longer than an uncontended lock.
+	*/
+	struct WorkStealingQueue{
+		struct alignas(64) Range{
+			std::mutex lock;
+			size_t next = 0;
+			size_t stop = 0;
+			size_t steals = 0; // ranges stolen by the worker owning this one
+		};
+
+		uint16_t workersCount;
+		std::unique_ptr<Range[]> ranges;
+		std::function<void()> onProgress; // if set, called after a worker has taken a task, out of the locks
+
+		WorkStealingQueue(size_t tasksCount, uint16_t workersCount);
+
+		/// Gets the next task for `worker`, returns false when there are no tasks left
+		bool next(uint16_t worker, size_t &task);
+
+		/// The worker whose range has `task` before anything is stolen
+		static uint16_t getInitialWorker(size_t task, size_t tasksCount, uint16_t workersCount);
+
+	private:
+		bool steal(uint16_t worker);
+	};
+
+	/// Threads living between the scans, so lots of small scans don't pay for creating threads. The calling thread works too, as the worker 0.
+	struct ThreadPool{
+		using JobT = std::function<void(uint16_t workerId)>;
+
+		ThreadPool(uint16_t threadsCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		inline uint16_t size() const {
+			return threads.size() + 1;
+		}
+
+		/// Runs `f` on the workers `0`..`count - 1` (`count <= size()`) and waits for them. Rethrows the first exception thrown by `f`. Not reentrant.
+		void run(uint16_t count, const JobT &f);
+
+	private:
+		std::vector<std::thread> threads;
+		std::mutex lock;
+		std::condition_variable started, finished;
+		const JobT *job = nullptr;
+		uint16_t jobWorkers = 0;
+		uint16_t pending = 0;
+		uint64_t generation = 0;
+		bool stopping = false;
+		std::exception_ptr error;
+
+		void workerFunction(uint16_t id);
+		void runJob(uint16_t id);
+	};
+
+	/// Runs `f(workerId, queue)` on `min(pool.size(), tasksCount)` workers of the pool, `f` takes the tasks with `queue.next(workerId, task)`
+	template<typename WorkerFuncT>
+	void runTasks(size_t tasksCount, WorkerFuncT f, ThreadPool &pool){
+		uint16_t workersCount = std::max<size_t>(std::min<size_t>(pool.size(), tasksCount), 1);
+		WorkStealingQueue q{tasksCount, workersCount};
+		pool.run(workersCount, [&](uint16_t id){
+			f(id, q);
+		});
+	}
+};
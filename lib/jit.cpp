@@ -0,0 +1,244 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <new>
+#include <initializer_list>
+
+#include "jit.hpp"
+
+#ifdef SCANBYTES_JIT_SUPPORTED
+
+#include <sys/mman.h>
+
+namespace{
+	const size_t pageSize = 4 * 1024;
+
+	/// xmm0 holds the loaded data, xmm1 accumulates the comparison results, xmm2 is a temporary. The rest keep the chars.
+	const uint8_t firstCharXmm = 3;
+	const uint8_t xmmCount = 16;
+	const uint8_t partSize = 16;
+
+	enum Reg: uint8_t{
+		rax = 0, rcx = 1, rdx = 2, rsi = 6, rdi = 7, r8 = 8, r9 = 9
+	};
+
+	struct X86_64Emitter{
+		std::vector<uint8_t> code;
+
+		void emit(std::initializer_list<uint8_t> bytes){
+			code.insert(code.end(), bytes);
+		}
+
+		void emit32(uint32_t v){
+			for(uint8_t i = 0; i < 4; ++i){
+				code.emplace_back(static_cast<uint8_t>(v >> (i * 8)));
+			}
+		}
+
+		size_t pos(){
+			return code.size();
+		}
+
+		void patch32(size_t at, uint32_t v){
+			for(uint8_t i = 0; i < 4; ++i){
+				code[at + i] = static_cast<uint8_t>(v >> (i * 8));
+			}
+		}
+
+		static uint8_t modrm(uint8_t mod, uint8_t reg, uint8_t rm){
+			return (mod << 6) | ((reg & 7) << 3) | (rm & 7);
+		}
+
+		void rexIfNeeded(bool w, uint8_t reg, uint8_t rm){
+			uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+			if(rex != 0x40){
+				code.emplace_back(rex);
+			}
+		}
+
+		/// `66 [REX] 0F op /r` with both operands being xmm registers
+		void sseRR(uint8_t op, uint8_t dst, uint8_t src){
+			code.emplace_back(0x66);
+			rexIfNeeded(false, dst, src);
+			emit({0x0F, op, modrm(3, dst, src)});
+		}
+
+		/// `66 [REX] 0F op /r` with the source at RIP-relative position not yet known, returns the position of the displacement
+		size_t sseRRipFixup(uint8_t op, uint8_t dst){
+			code.emplace_back(0x66);
+			rexIfNeeded(false, dst, 0);
+			emit({0x0F, op, modrm(0, dst, 5)});
+			size_t dispPos = pos();
+			emit32(0);
+			return dispPos;
+		}
+
+		void movdqa(uint8_t dst, uint8_t src){
+			sseRR(0x6F, dst, src);
+		}
+
+		void pcmpeqb(uint8_t dst, uint8_t src){
+			sseRR(0x74, dst, src);
+		}
+
+		void por(uint8_t dst, uint8_t src){
+			sseRR(0xEB, dst, src);
+		}
+
+		/// movdqu xmm, [rdi + disp8]
+		void movdquFromRdi(uint8_t dst, int8_t disp){
+			code.emplace_back(0xF3);
+			rexIfNeeded(false, dst, rdi);
+			if(disp){
+				emit({0x0F, 0x6F, modrm(1, dst, rdi), static_cast<uint8_t>(disp)});
+			} else {
+				emit({0x0F, 0x6F, modrm(0, dst, rdi)});
+			}
+		}
+
+		/// pmovmskb r32, xmm
+		void pmovmskb(uint8_t dst, uint8_t src){
+			code.emplace_back(0x66);
+			rexIfNeeded(false, dst, src);
+			emit({0x0F, 0xD7, modrm(3, dst, src)});
+		}
+
+		/// `REX.W op /r`, op r/m64, r64
+		void aluRR(uint8_t op, uint8_t rm, uint8_t reg){
+			rexIfNeeded(true, reg, rm);
+			emit({op, modrm(3, reg, rm)});
+		}
+
+		/// `REX.W 83 /ext ib`
+		void aluRI8(uint8_t ext, uint8_t rm, int8_t imm){
+			rexIfNeeded(true, 0, rm);
+			emit({0x83, modrm(3, ext, rm), static_cast<uint8_t>(imm)});
+		}
+
+		size_t jcc32(uint8_t cc){
+			emit({0x0F, static_cast<uint8_t>(0x80 | cc)});
+			size_t dispPos = pos();
+			emit32(0);
+			return dispPos;
+		}
+
+		size_t jmp32(){
+			code.emplace_back(0xE9);
+			size_t dispPos = pos();
+			emit32(0);
+			return dispPos;
+		}
+
+		void bindJump(size_t dispPos, size_t target){
+			patch32(dispPos, static_cast<uint32_t>(target - (dispPos + 4)));
+		}
+	};
+
+	enum Cond: uint8_t{
+		condB = 0x2, condZ = 0x4, condNZ = 0x5
+	};
+}
+
+JittedCharDetector::JittedCharDetector(std::vector<uint8_t> &v){
+	memset(charz, 0, sizeof(charz));
+	for(auto c: v){
+		charz[c >> 3] |= (1 << (c & 0x07));
+	}
+
+	X86_64Emitter e;
+	size_t inRegisters = std::min<size_t>(v.size(), xmmCount - firstCharXmm);
+	std::vector<std::pair<size_t, size_t>> poolFixups;  // (displacement position, char index)
+
+	e.emit({0xF3, 0x0F, 0x1E, 0xFA});  // endbr64
+	e.aluRR(0x89, rcx, rdi);  // mov rcx, rdi ; the beginning of the window
+	for(size_t i = 0; i < inRegisters; ++i){
+		poolFixups.emplace_back(e.sseRRipFixup(0x6F, firstCharXmm + i), i);  // movdqa xmmN, [rip + pool + 16 * i]
+	}
+	size_t toLoopHead = e.jmp32();
+
+	size_t loopBody = e.pos();
+	for(uint8_t part = 0; part < JittedCharDetector::blockSize / partSize; ++part){
+		e.movdquFromRdi(0, part * partSize);
+		for(size_t i = 0; i < v.size(); ++i){
+			uint8_t dst = i ? 2 : 1;
+			e.movdqa(dst, 0);
+			if(i < inRegisters){
+				e.pcmpeqb(dst, firstCharXmm + i);
+			} else {
+				poolFixups.emplace_back(e.sseRRipFixup(0x74, dst), i);  // pcmpeqb xmmN, [rip + pool + 16 * i]
+			}
+			if(i){
+				e.por(1, 2);
+			}
+		}
+		if(part){
+			e.pmovmskb(r8, 1);
+			e.rexIfNeeded(true, 0, r8);
+			e.emit({0xC1, X86_64Emitter::modrm(3, 4, r8), static_cast<uint8_t>(part * partSize)});  // shl r8, part * 16
+			e.aluRR(0x09, rax, r8);  // or rax, r8
+		} else {
+			e.pmovmskb(rax, 1);
+		}
+	}
+	e.aluRR(0x85, rax, rax);  // test rax, rax
+	size_t toNextBlock = e.jcc32(condZ);
+
+	e.aluRR(0x89, r9, rdi);  // mov r9, rdi
+	e.aluRR(0x29, r9, rcx);  // sub r9, rcx ; offset of the block within the window
+
+	size_t bitLoop = e.pos();
+	e.rexIfNeeded(true, r8, rax);
+	e.emit({0x0F, 0xBC, X86_64Emitter::modrm(3, r8, rax)});  // bsf r8, rax
+	e.rexIfNeeded(false, r9, r8);
+	e.emit({0x01, X86_64Emitter::modrm(3, r9, r8)});  // add r8d, r9d
+	e.rexIfNeeded(false, r8, rdx);
+	e.emit({0x89, X86_64Emitter::modrm(0, r8, rdx)});  // mov [rdx], r8d
+	e.aluRI8(0, rdx, sizeof(uint32_t));  // add rdx, 4
+	e.rexIfNeeded(true, r8, rax);
+	e.emit({0x8D, X86_64Emitter::modrm(1, r8, rax), 0xFF});  // lea r8, [rax - 1]
+	e.aluRR(0x21, rax, r8);  // and rax, r8 ; clears the lowest set bit
+	e.bindJump(e.jcc32(condNZ), bitLoop);
+
+	e.bindJump(toNextBlock, e.pos());
+	e.aluRI8(0, rdi, JittedCharDetector::blockSize);  // add rdi, 64
+
+	e.bindJump(toLoopHead, e.pos());
+	e.aluRR(0x39, rdi, rsi);  // cmp rdi, rsi
+	e.bindJump(e.jcc32(condB), loopBody);
+	e.aluRR(0x89, rax, rdx);  // mov rax, rdx
+	e.emit({0xC3});  // ret
+
+	// the constant pool, legacy SSE memory operands must be 16-byte aligned
+	while(e.pos() % partSize){
+		e.emit({0xCC});
+	}
+	size_t pool = e.pos();
+	for(auto c: v){
+		for(uint8_t i = 0; i < partSize; ++i){
+			e.code.emplace_back(c);
+		}
+	}
+	for(auto &f: poolFixups){
+		e.bindJump(f.first, pool + f.second * partSize);
+	}
+
+	funcJitCodeSize = (e.code.size() + pageSize - 1) / pageSize * pageSize;
+	funcJitCode = (uint8_t *) mmap(nullptr, funcJitCodeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (funcJitCode == (void *)-1) {
+		throw std::bad_alloc();
+	}
+	memcpy(funcJitCode, &e.code[0], e.code.size());
+
+	if (mprotect(funcJitCode, funcJitCodeSize, PROT_READ | PROT_EXEC) == -1) {
+		munmap(funcJitCode, funcJitCodeSize);
+		throw std::bad_alloc();
+	}
+	func = reinterpret_cast<FuncT>(funcJitCode);
+}
+
+JittedCharDetector::~JittedCharDetector(){
+	munmap(funcJitCode, funcJitCodeSize);
+}
+#endif
@@ -0,0 +1,90 @@
+#include "Kernels.hpp"
+
+#ifdef SCANBYTES_SIMD_SUPPORTED
+#include <immintrin.h>
+#include "TargetRegion.hpp"
+
+SCANBYTES_BEGIN_TARGET_REGION("avx2,bmi,bmi2,pclmul,popcnt")
+namespace ScanBytes::Kernels{
+	namespace {
+		struct AVX2Ops{
+			struct Block{
+				__m256i v[2];
+			};
+			using Needle = __m256i;
+			using Matches = Block;
+
+			struct Tables{
+				__m256i low, high, bits;
+			};
+
+			static constexpr bool hasShuffle = true;
+
+			static inline Block load(const uint8_t *p){
+				return {{
+					_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)),
+					_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32)),
+				}};
+			}
+
+			static inline Needle broadcast(uint8_t c){
+				return _mm256_set1_epi8(static_cast<char>(c));
+			}
+
+			static inline Matches match(const Block &b, Needle n){
+				return {{_mm256_cmpeq_epi8(b.v[0], n), _mm256_cmpeq_epi8(b.v[1], n)}};
+			}
+
+			static inline Matches merge(const Matches &a, const Matches &b){
+				return {{_mm256_or_si256(a.v[0], b.v[0]), _mm256_or_si256(a.v[1], b.v[1])}};
+			}
+
+			static inline uint64_t toMask(const Matches &m){
+				return static_cast<uint32_t>(_mm256_movemask_epi8(m.v[0])) | (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(m.v[1]))) << 32);
+			}
+
+			static inline uint64_t prefixXor(uint64_t m){
+				// carry-less multiplication by all ones
+				__m128i res = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<int64_t>(m)), _mm_set1_epi8(-1), 0);
+#if defined(__x86_64__) || defined(_M_X64)
+				return static_cast<uint64_t>(_mm_cvtsi128_si64(res));
+#else
+				// i386 has no 64-bit moves out of the XMM registers
+				return static_cast<uint32_t>(_mm_cvtsi128_si32(res)) | (static_cast<uint64_t>(static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(res, 4)))) << 32);
+#endif
+			}
+
+			static inline Tables loadTables(const ShuffleParams &params){
+				// vpshufb shuffles within 128-bit lanes, so the tables are duplicated into both of them
+				return {
+					.low = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(params.lowTable))),
+					.high = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(params.highTable))),
+					.bits = _mm256_setr_epi8(
+						1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+						1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128
+					),
+				};
+			}
+
+			static inline uint32_t classifyHalf(__m256i v, const Tables &t){
+				__m256i rows = _mm256_or_si256(
+					_mm256_shuffle_epi8(t.low, v),
+					_mm256_shuffle_epi8(t.high, _mm256_xor_si256(v, _mm256_set1_epi8(static_cast<char>(0x80))))
+				);
+				__m256i column = _mm256_shuffle_epi8(t.bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F)));
+				__m256i misses = _mm256_cmpeq_epi8(_mm256_and_si256(rows, column), _mm256_setzero_si256());
+				return ~static_cast<uint32_t>(_mm256_movemask_epi8(misses));
+			}
+
+			static inline uint64_t classify(const Block &b, const Tables &t){
+				return classifyHalf(b.v[0], t) | (static_cast<uint64_t>(classifyHalf(b.v[1], t)) << 32);
+			}
+		};
+
+		#include "KernelsImpl.hpp"
+	};
+
+	const KernelSet avx2Kernels = makeKernelSet<AVX2Ops>();
+};
+SCANBYTES_END_TARGET_REGION
+#endif
@@ -0,0 +1,77 @@
+#include "Kernels.hpp"
+
+#ifdef SCANBYTES_SIMD_SUPPORTED
+#include <immintrin.h>
+#include "TargetRegion.hpp"
+
+SCANBYTES_BEGIN_TARGET_REGION("avx512f,avx512bw,avx2,bmi,bmi2,pclmul,popcnt")
+namespace ScanBytes::Kernels{
+	namespace {
+		struct AVX512BWOps{
+			using Block = __m512i;
+			using Needle = __m512i;
+			using Matches = __mmask64;
+
+			struct Tables{
+				__m512i low, high, bits;
+			};
+
+			static constexpr bool hasShuffle = true;
+
+			static inline Block load(const uint8_t *p){
+				return _mm512_loadu_si512(p);
+			}
+
+			static inline Needle broadcast(uint8_t c){
+				return _mm512_set1_epi8(static_cast<char>(c));
+			}
+
+			static inline Matches match(const Block &b, Needle n){
+				return _mm512_cmpeq_epi8_mask(b, n);
+			}
+
+			static inline Matches merge(const Matches &a, const Matches &b){
+				return a | b;
+			}
+
+			static inline uint64_t toMask(const Matches &m){
+				return m;
+			}
+
+			static inline uint64_t prefixXor(uint64_t m){
+				// carry-less multiplication by all ones
+				__m128i res = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<int64_t>(m)), _mm_set1_epi8(-1), 0);
+#if defined(__x86_64__) || defined(_M_X64)
+				return static_cast<uint64_t>(_mm_cvtsi128_si64(res));
+#else
+				// i386 has no 64-bit moves out of the XMM registers
+				return static_cast<uint32_t>(_mm_cvtsi128_si32(res)) | (static_cast<uint64_t>(static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(res, 4)))) << 32);
+#endif
+			}
+
+			static inline Tables loadTables(const ShuffleParams &params){
+				// vpshufb shuffles within 128-bit lanes, so the tables are duplicated into all of them. Unmasked broadcast makes GCC complain about the undefined source it uses
+				return {
+					.low = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_load_si128(reinterpret_cast<const __m128i *>(params.lowTable))),
+					.high = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_load_si128(reinterpret_cast<const __m128i *>(params.highTable))),
+					.bits = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128)),
+				};
+			}
+
+			static inline uint64_t classify(const Block &v, const Tables &t){
+				__m512i rows = _mm512_or_si512(
+					_mm512_shuffle_epi8(t.low, v),
+					_mm512_shuffle_epi8(t.high, _mm512_xor_si512(v, _mm512_set1_epi8(static_cast<char>(0x80))))
+				);
+				__m512i column = _mm512_shuffle_epi8(t.bits, _mm512_and_si512(_mm512_srli_epi16(v, 4), _mm512_set1_epi8(0x0F)));
+				return _mm512_test_epi8_mask(rows, column);
+			}
+		};
+
+		#include "KernelsImpl.hpp"
+	};
+
+	const KernelSet avx512bwKernels = makeKernelSet<AVX512BWOps>();
+};
+SCANBYTES_END_TARGET_REGION
+#endif
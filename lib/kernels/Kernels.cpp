@@ -0,0 +1,20 @@
+#include "Kernels.hpp"
+
+namespace ScanBytes::Kernels{
+	const KernelSet *getKernels(Tier t){
+		switch(t){
+			#ifdef SCANBYTES_SIMD_SUPPORTED
+			case Tier::SSE2:
+				return &sse2Kernels;
+			case Tier::SSSE3:
+				return &ssse3Kernels;
+			case Tier::AVX2:
+				return &avx2Kernels;
+			case Tier::AVX512BW:
+				return &avx512bwKernels;
+			#endif
+			default:
+				return nullptr;
+		}
+	}
+};
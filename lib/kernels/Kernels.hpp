@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+#include <ScanBytes/ScanBytes.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(i386) || defined(__i386__) || defined(__i386) || defined(_M_IX86)
+	#define SCANBYTES_SIMD_SUPPORTED 1
+#else
+	#undef SCANBYTES_SIMD_SUPPORTED
+#endif
+
+namespace ScanBytes::Kernels{
+	/// All the kernels process 64-byte blocks, `blocksEnd - begin` must be a multiple of it.
+	const size_t blockSize = 64;
+
+	const uint8_t maxCompareChars = 4;
+
+	struct CompareParams{
+		uint8_t charz[maxCompareChars];
+	};
+
+	/// See `ShuffleCharsDetector` for the layout
+	struct ShuffleParams{
+		alignas(16) uint8_t lowTable[16];
+		alignas(16) uint8_t highTable[16];
+	};
+
+	constexpr ShuffleParams makeShuffleParams(const uint8_t *charz, size_t count){
+		ShuffleParams params{};
+		for(size_t i = 0; i < count; ++i){
+			uint8_t c = charz[i];
+			uint8_t *table = c & 0x80 ? params.highTable : params.lowTable;
+			table[c & 0x0F] |= 1 << ((c >> 4) & 0x07);
+		}
+		return params;
+	}
+
+	template<uint8_t... chars>
+	struct FixedAlphabet{};
+
+	/// The common alphabets of 1-4 chars, every tier has compare kernels with their chars built in
+	using FixedAlphabets = std::tuple<
+		FixedAlphabet<'\n'>,
+		FixedAlphabet<'\r', '\n'>,
+		FixedAlphabet<',', '\n'>,
+		FixedAlphabet<'\t', '\n'>,
+		FixedAlphabet<'|'>,
+		FixedAlphabet<'\x1f', '\x1e'>,
+		FixedAlphabet<' '>
+	>;
+	constexpr size_t fixedAlphabetsCount = std::tuple_size_v<FixedAlphabets>;
+
+	/// Index within `FixedAlphabets`, `fixedAlphabetsCount` if the alphabet isn't there
+	template<uint8_t... chars, size_t... i>
+	constexpr size_t findFixedAlphabet(std::index_sequence<i...>){
+		size_t res = fixedAlphabetsCount;
+		((std::is_same_v<std::tuple_element_t<i, FixedAlphabets>, FixedAlphabet<chars...>> && (res = i, true)) || ...);
+		return res;
+	}
+
+	template<uint8_t... chars>
+	constexpr size_t fixedAlphabetIndex = findFixedAlphabet<chars...>(std::make_index_sequence<fixedAlphabetsCount>{});
+
+	const uint8_t maxQuotedDelimiters = 3;
+
+	struct QuotedParams{
+		uint8_t delimiters[maxQuotedDelimiters];
+		uint8_t quote;
+	};
+
+	const uint8_t maxPairs = 4;
+
+	/// Pairs of bytes `distances[i]` apart: the first and the last bytes of the multi-byte sequences
+	struct PairParams{
+		uint8_t first[maxPairs];
+		uint8_t last[maxPairs];
+		uint8_t distances[maxPairs];
+	};
+
+	/// The kernels write offsets of the matches relative to `begin` into `out` and return the new end of the output.
+	using CompareKernelT = uint32_t *(*)(const CompareParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out);
+	using ShuffleKernelT = uint32_t *(*)(const ShuffleParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out);
+	/// Writes the offsets of the first bytes of the pairs found, reads up to the largest of the distances past `blocksEnd`
+	using PairKernelT = uint32_t *(*)(const PairParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out);
+
+	/*
+	Writes delimiters outside of quotes into `out` and the ones within quotes into `altOut`. `inQuote` is all ones if the position before `begin` is within quotes and 0 otherwise, it is updated to the state at `blocksEnd`.
+	If the assumed initial state turns out to be wrong, `altOut` contains the right offsets.
+	*/
+	using QuotedKernelT = uint32_t *(*)(const QuotedParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out, uint32_t *&altOut, uint64_t &inQuote);
+
+	/// The counting kernels return the count of the matches instead of extracting them, a single popcnt per block
+	using CompareCountKernelT = uint64_t (*)(const CompareParams &params, const uint8_t *begin, const uint8_t *blocksEnd);
+	using ShuffleCountKernelT = uint64_t (*)(const ShuffleParams &params, const uint8_t *begin, const uint8_t *blocksEnd);
+	/// Returns the count of the delimiters outside of quotes and adds the count of the ones within them to `altCount`
+	using QuotedCountKernelT = uint64_t (*)(const QuotedParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint64_t &altCount, uint64_t &inQuote);
+
+	struct KernelSet{
+		CompareKernelT compare[maxCompareChars];  // indexed by the count of the chars - 1
+		ShuffleKernelT shuffle;  // nullptr if the tier has no byte shuffles
+		QuotedKernelT quoted[maxQuotedDelimiters];  // indexed by the count of the delimiters - 1
+		CompareCountKernelT compareCount[maxCompareChars];
+		ShuffleCountKernelT shuffleCount;
+		QuotedCountKernelT quotedCount[maxQuotedDelimiters];
+		PairKernelT pairs[maxPairs];  // indexed by the count of the pairs - 1
+		CompareKernelT fixedCompare[fixedAlphabetsCount]{};  // indexed like `FixedAlphabets`, `params` are ignored
+		CompareCountKernelT fixedCompareCount[fixedAlphabetsCount]{};
+	};
+
+	#ifdef SCANBYTES_SIMD_SUPPORTED
+		extern const KernelSet sse2Kernels;
+		extern const KernelSet ssse3Kernels;
+		extern const KernelSet avx2Kernels;
+		extern const KernelSet avx512bwKernels;
+	#endif
+
+	/// nullptr for Tier::Scalar
+	const KernelSet *getKernels(Tier t);
+};
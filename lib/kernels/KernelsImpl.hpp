@@ -0,0 +1,216 @@
+/*
+Generic bodies of the kernels, parametrized by `Ops` abstracting a certain instruction set.
+This file is included into every tier translation unit inside of an anonymous namespace and a target region, so each tier gets its own copy compiled for its instruction set. So it must not include anything itself.
+
+`Ops` must provide:
+	Block load(const uint8_t *p) - loads a 64-byte block
+	Needle broadcast(uint8_t c)
+	Matches match(const Block &b, Needle n)
+	Matches merge(const Matches &a, const Matches &b)
+	uint64_t toMask(const Matches &m) - 1 bit per byte of the block
+	uint64_t prefixXor(uint64_t m) - bit i of the result is XOR of bits 0..i of `m`
+	hasShuffle, and if it is true:
+		Tables loadTables(const ShuffleParams &params)
+		uint64_t classify(const Block &b, const Tables &t)
+*/
+
+inline uint32_t *extract(uint64_t mask, uint32_t blockOffset, uint32_t *out){
+	while(mask){
+		*(out++) = blockOffset + __builtin_ctzll(mask);  // tzcnt
+		mask &= mask - 1;  // blsr
+	}
+	return out;
+}
+
+template<typename Ops, uint8_t N>
+struct Needles{
+	typename Ops::Needle v[N];
+
+	inline Needles(const uint8_t *charz){
+		for(uint8_t i = 0; i < N; ++i){
+			v[i] = Ops::broadcast(charz[i]);
+		}
+	}
+
+	/// 1 bit per byte of the block matching any of the chars
+	inline uint64_t match(const typename Ops::Block &b) const{
+		auto m = Ops::match(b, v[0]);
+		for(uint8_t i = 1; i < N; ++i){
+			m = Ops::merge(m, Ops::match(b, v[i]));
+		}
+		return Ops::toMask(m);
+	}
+};
+
+template<typename Ops, uint8_t N>
+uint32_t *compareKernel(const CompareParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out){
+	Needles<Ops, N> needles{params.charz};
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		out = extract(needles.match(Ops::load(p)), p - begin, out);
+	}
+	return out;
+}
+
+template<typename Ops, uint8_t N>
+uint64_t compareCountKernel(const CompareParams &params, const uint8_t *begin, const uint8_t *blocksEnd){
+	Needles<Ops, N> needles{params.charz};
+	uint64_t count = 0;
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		count += __builtin_popcountll(needles.match(Ops::load(p)));
+	}
+	return count;
+}
+
+template<typename Ops>
+uint32_t *shuffleKernel(const ShuffleParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out){
+	auto tables = Ops::loadTables(params);
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		out = extract(Ops::classify(Ops::load(p), tables), p - begin, out);
+	}
+	return out;
+}
+
+template<typename Ops>
+uint64_t shuffleCountKernel(const ShuffleParams &params, const uint8_t *begin, const uint8_t *blocksEnd){
+	auto tables = Ops::loadTables(params);
+	uint64_t count = 0;
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		count += __builtin_popcountll(Ops::classify(Ops::load(p), tables));
+	}
+	return count;
+}
+
+/// Splits the delimiters of a block into the ones outside of quotes and the ones within them, advances `inQuote`
+template<typename Ops, uint8_t N>
+inline uint64_t splitQuoted(const Needles<Ops, N> &needles, typename Ops::Needle quoteNeedle, const typename Ops::Block &b, uint64_t &quotedDelimiters, uint64_t &inQuote){
+	uint64_t delimiters = needles.match(b);
+
+	// a bit is set from an opening quote up to (not including) the closing one, escaped quotes "" toggle it twice
+	uint64_t quoted = Ops::prefixXor(Ops::toMask(Ops::match(b, quoteNeedle))) ^ inQuote;
+	inQuote = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+
+	quotedDelimiters = delimiters & quoted;
+	return delimiters & ~quoted;
+}
+
+template<typename Ops, uint8_t N>
+uint32_t *quotedKernel(const QuotedParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out, uint32_t *&altOut, uint64_t &inQuote){
+	Needles<Ops, N> needles{params.delimiters};
+	auto quoteNeedle = Ops::broadcast(params.quote);
+
+	uint32_t *alt = altOut;
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		uint64_t quoted;
+		out = extract(splitQuoted(needles, quoteNeedle, Ops::load(p), quoted, inQuote), p - begin, out);
+		alt = extract(quoted, p - begin, alt);
+	}
+	altOut = alt;
+	return out;
+}
+
+template<typename Ops, uint8_t N>
+uint64_t quotedCountKernel(const QuotedParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint64_t &altCount, uint64_t &inQuote){
+	Needles<Ops, N> needles{params.delimiters};
+	auto quoteNeedle = Ops::broadcast(params.quote);
+
+	uint64_t count = 0;
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		uint64_t quoted;
+		count += __builtin_popcountll(splitQuoted(needles, quoteNeedle, Ops::load(p), quoted, inQuote));
+		altCount += __builtin_popcountll(quoted);
+	}
+	return count;
+}
+
+/// The second load is skipped when none of the first bytes is in the block, so rare sequences cost about as much as a single char
+template<typename Ops, uint8_t N>
+uint32_t *pairKernel(const PairParams &params, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out){
+	Needles<Ops, N> firsts{params.first}, lasts{params.last};
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		auto b = Ops::load(p);
+		uint64_t mask = 0;
+		for(uint8_t i = 0; i < N; ++i){
+			uint64_t firstMask = Ops::toMask(Ops::match(b, firsts.v[i]));
+			if(firstMask){
+				mask |= firstMask & Ops::toMask(Ops::match(Ops::load(p + params.distances[i]), lasts.v[i]));
+			}
+		}
+		out = extract(mask, p - begin, out);
+	}
+	return out;
+}
+
+/// The chars are immediates, so the needles need no loads and the compiler can see through the whole loop
+template<typename Ops, uint8_t... chars>
+uint32_t *fixedCompareKernel(const CompareParams &, const uint8_t *begin, const uint8_t *blocksEnd, uint32_t *out){
+	constexpr uint8_t charz[] = {chars...};
+	Needles<Ops, sizeof...(chars)> needles{charz};
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		out = extract(needles.match(Ops::load(p)), p - begin, out);
+	}
+	return out;
+}
+
+template<typename Ops, uint8_t... chars>
+uint64_t fixedCompareCountKernel(const CompareParams &, const uint8_t *begin, const uint8_t *blocksEnd){
+	constexpr uint8_t charz[] = {chars...};
+	Needles<Ops, sizeof...(chars)> needles{charz};
+	uint64_t count = 0;
+	for(const uint8_t *p = begin; p < blocksEnd; p += blockSize){
+		count += __builtin_popcountll(needles.match(Ops::load(p)));
+	}
+	return count;
+}
+
+template<typename Ops, uint8_t... chars>
+constexpr void setFixedKernels(KernelSet &s, size_t i, FixedAlphabet<chars...>){
+	s.fixedCompare[i] = fixedCompareKernel<Ops, chars...>;
+	s.fixedCompareCount[i] = fixedCompareCountKernel<Ops, chars...>;
+}
+
+template<typename Ops, size_t... i>
+constexpr void setFixedKernels(KernelSet &s, std::index_sequence<i...>){
+	(setFixedKernels<Ops>(s, i, std::tuple_element_t<i, FixedAlphabets>{}), ...);
+}
+
+template<typename Ops>
+constexpr KernelSet makeKernelSet(){
+	KernelSet s{
+		.compare = {
+			compareKernel<Ops, 1>,
+			compareKernel<Ops, 2>,
+			compareKernel<Ops, 3>,
+			compareKernel<Ops, 4>,
+		},
+		.shuffle = nullptr,
+		.quoted = {
+			quotedKernel<Ops, 1>,
+			quotedKernel<Ops, 2>,
+			quotedKernel<Ops, 3>,
+		},
+		.compareCount = {
+			compareCountKernel<Ops, 1>,
+			compareCountKernel<Ops, 2>,
+			compareCountKernel<Ops, 3>,
+			compareCountKernel<Ops, 4>,
+		},
+		.shuffleCount = nullptr,
+		.quotedCount = {
+			quotedCountKernel<Ops, 1>,
+			quotedCountKernel<Ops, 2>,
+			quotedCountKernel<Ops, 3>,
+		},
+		.pairs = {
+			pairKernel<Ops, 1>,
+			pairKernel<Ops, 2>,
+			pairKernel<Ops, 3>,
+			pairKernel<Ops, 4>,
+		},
+	};
+	setFixedKernels<Ops>(s, std::make_index_sequence<fixedAlphabetsCount>{});
+	if constexpr(Ops::hasShuffle){
+		s.shuffle = shuffleKernel<Ops>;
+		s.shuffleCount = shuffleCountKernel<Ops>;
+	}
+	return s;
+}
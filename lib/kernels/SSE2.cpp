@@ -0,0 +1,17 @@
+#include "Kernels.hpp"
+
+#ifdef SCANBYTES_SIMD_SUPPORTED
+#include <immintrin.h>
+#include "TargetRegion.hpp"
+
+SCANBYTES_BEGIN_TARGET_REGION("sse2")
+namespace ScanBytes::Kernels{
+	namespace {
+		#include "SSEOps.hpp"
+		#include "KernelsImpl.hpp"
+	};
+
+	const KernelSet sse2Kernels = makeKernelSet<SSEOps>();
+};
+SCANBYTES_END_TARGET_REGION
+#endif
@@ -0,0 +1,57 @@
+/*
+128-bit operations shared by SSE2 and SSSE3 tiers. Included the same way as KernelsImpl.hpp.
+*/
+
+struct SSEOps{
+	struct Block{
+		__m128i v[4];
+	};
+	using Needle = __m128i;
+	using Matches = Block;
+
+	static constexpr bool hasShuffle = false;
+
+	static inline Block load(const uint8_t *p){
+		Block b;
+		for(uint8_t i = 0; i < 4; ++i){
+			b.v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i * 16));
+		}
+		return b;
+	}
+
+	static inline Needle broadcast(uint8_t c){
+		return _mm_set1_epi8(static_cast<char>(c));
+	}
+
+	static inline Matches match(const Block &b, Needle n){
+		Matches m;
+		for(uint8_t i = 0; i < 4; ++i){
+			m.v[i] = _mm_cmpeq_epi8(b.v[i], n);
+		}
+		return m;
+	}
+
+	static inline Matches merge(const Matches &a, const Matches &b){
+		Matches m;
+		for(uint8_t i = 0; i < 4; ++i){
+			m.v[i] = _mm_or_si128(a.v[i], b.v[i]);
+		}
+		return m;
+	}
+
+	/// carry-less multiplication is not guaranteed in these tiers, so shifts are used
+	static inline uint64_t prefixXor(uint64_t m){
+		for(uint8_t shift = 1; shift < 64; shift <<= 1){
+			m ^= m << shift;
+		}
+		return m;
+	}
+
+	static inline uint64_t toMask(const Matches &m){
+		uint64_t res = 0;
+		for(uint8_t i = 0; i < 4; ++i){
+			res |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(m.v[i]))) << (i * 16);
+		}
+		return res;
+	}
+};
@@ -0,0 +1,49 @@
+#include "Kernels.hpp"
+
+#ifdef SCANBYTES_SIMD_SUPPORTED
+#include <immintrin.h>
+#include "TargetRegion.hpp"
+
+SCANBYTES_BEGIN_TARGET_REGION("sse2,ssse3")
+namespace ScanBytes::Kernels{
+	namespace {
+		#include "SSEOps.hpp"
+
+		struct SSSE3Ops: public SSEOps{
+			struct Tables{
+				__m128i low, high, bits;
+			};
+
+			static constexpr bool hasShuffle = true;
+
+			static inline Tables loadTables(const ShuffleParams &params){
+				return {
+					.low = _mm_load_si128(reinterpret_cast<const __m128i *>(params.lowTable)),
+					.high = _mm_load_si128(reinterpret_cast<const __m128i *>(params.highTable)),
+					.bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128),
+				};
+			}
+
+			static inline uint64_t classify(const Block &b, const Tables &t){
+				uint64_t res = 0;
+				for(uint8_t i = 0; i < 4; ++i){
+					__m128i v = b.v[i];
+					__m128i rows = _mm_or_si128(
+						_mm_shuffle_epi8(t.low, v),
+						_mm_shuffle_epi8(t.high, _mm_xor_si128(v, _mm_set1_epi8(static_cast<char>(0x80))))
+					);
+					__m128i column = _mm_shuffle_epi8(t.bits, _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F)));
+					__m128i misses = _mm_cmpeq_epi8(_mm_and_si128(rows, column), _mm_setzero_si128());
+					res |= static_cast<uint64_t>(static_cast<uint16_t>(~_mm_movemask_epi8(misses))) << (i * 16);
+				}
+				return res;
+			}
+		};
+
+		#include "KernelsImpl.hpp"
+	};
+
+	const KernelSet ssse3Kernels = makeKernelSet<SSSE3Ops>();
+};
+SCANBYTES_END_TARGET_REGION
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+/*
+The code between these macros is compiled for the specified instruction sets regardless of the compiler flags, so the kernels of all the tiers live in the same binary and are chosen at runtime.
+*/
+
+#define SCANBYTES_PRAGMA(x) _Pragma(#x)
+
+#if defined(__clang__)
+	#define SCANBYTES_BEGIN_TARGET_REGION(targets) SCANBYTES_PRAGMA(clang attribute push(__attribute__((target(targets))), apply_to = function))
+	#define SCANBYTES_END_TARGET_REGION _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+	#define SCANBYTES_BEGIN_TARGET_REGION(targets) _Pragma("GCC push_options") SCANBYTES_PRAGMA(GCC target(targets))
+	#define SCANBYTES_END_TARGET_REGION _Pragma("GCC pop_options")
+#else
+	#error "Compiling kernels for multiple instruction sets in one binary is not implemented for this compiler"
+#endif
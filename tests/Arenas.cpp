@@ -0,0 +1,100 @@
+#include <thread>
+#include <algorithm>
+
+#include <ScanBytes/MultiThreadedOrderedAppendOnlyAllocator.hpp>
+
+#include "Testing.hpp"
+
+using namespace Testing;
+
+namespace {
+	const uint32_t threadsCount = 4;
+	const uint32_t tasksCount = 12;
+	const uint64_t taskBase = 1000000; // the values of a task are `taskBase * task + i`
+
+	/// Crosses the capacities of the arenas of every size, the largest ones are mmapped
+	size_t getValuesCount(uint32_t task){
+		const size_t counts[]{0, 1, 15, 16, 17, 1000, 0, 33, 300000, 2, 64, 5000};
+		return counts[task % std::size(counts)];
+	}
+
+	/// The tasks of a thread are interleaved with the ones of the others, like the ones taken from the queues of a scan
+	template<typename ValueT>
+	void appendTasks(MTOAOA<ValueT> &parent, uint32_t thread, AllocatorStats &stats){
+		auto alloc = parent.getForThread(thread);
+		std::vector<uint32_t> offsets(100);
+		for(uint32_t task = thread; task < tasksCount; task += threadsCount){
+			alloc.startTask(task);
+			uint64_t base = taskBase * task;
+			size_t count = getValuesCount(task);
+			for(size_t j = 0; j < count;){
+				if(j % 3){
+					alloc.append(static_cast<ValueT>(base + j));
+					++j;
+				} else {  // a batch may not fit into the rest of the arena
+					size_t batch = std::min(offsets.size(), count - j);
+					for(size_t k = 0; k < batch; ++k){
+						offsets[k] = j + k;
+					}
+					alloc.appendRelative(base, offsets.data(), batch);
+					j += batch;
+				}
+			}
+		}
+		alloc.finalize();
+		stats = alloc.stats;
+	}
+
+	template<typename ValueT>
+	void checkArenas(const std::string &what){
+		MTOAOA<ValueT> parent{16};
+		std::vector<AllocatorStats> stats(threadsCount);
+		std::vector<std::thread> threads;
+		for(uint32_t t = 0; t < threadsCount; ++t){
+			threads.emplace_back(appendTasks<ValueT>, std::ref(parent), t, std::ref(stats[t]));
+		}
+		for(auto &t: threads){
+			t.join();
+		}
+
+		std::vector<uint64_t> expected;  // as `flatten` gives them
+		for(uint32_t task = 0; task < tasksCount; ++task){
+			for(size_t j = 0; j < getValuesCount(task); ++j){
+				expected.emplace_back(taskBase * task + j);
+			}
+		}
+		std::sort(begin(parent.chunks), end(parent.chunks), [](auto &a, auto &b){
+			return *a < *b;
+		});
+		check(flatten(parent.chunks) == expected, what + ": the values in order of the tasks");
+
+		bool areBlocksOfTasks = true;
+		for(auto &chunk: parent.chunks){
+			areBlocksOfTasks = areBlocksOfTasks && !chunk->vec.empty() && std::all_of(chunk->vec.begin(), chunk->vec.end(), [&](ValueT v){
+				return v / taskBase == chunk->id;
+			});
+		}
+		check(areBlocksOfTasks, what + ": every block is non-empty and has the values of the task of its id");
+
+		uint64_t values = 0, blocks = 0;
+		for(auto &s: stats){
+			values += s.values;
+			blocks += s.blocks;
+		}
+		check(values == expected.size() && blocks == parent.chunks.size(), what + ": the stats count the values and the blocks");
+		check(std::all_of(begin(stats), end(stats), [](auto &s){return s.arenas > 1;}), what + ": the arenas grow");
+	}
+};
+
+/// Threads appending the values of interleaved tasks into their arenas, the blocks outlive the allocators and sorted give the values in order
+int main(){
+	checkArenas<uint64_t>("64-bit values");
+	checkArenas<uint32_t>("32-bit values");
+
+	ValueBlock<uint64_t> block{7, size_t(300000)};
+	std::fill(block.vec.begin(), block.vec.end(), 42);
+	check(block.id == 7 && block.vec.size() == 300000 && block.vec[299999] == 42, "a block with an arena of its own");
+	ValueBlock<uint64_t> empty{8, size_t(0)};
+	check(empty.vec.empty() && empty.vec.data(), "an empty block with an arena of its own");
+	return report();
+}
@@ -0,0 +1,83 @@
+#include <cctype>
+#include <stdexcept>
+
+#include "Testing.hpp"
+
+using namespace ScanBytes;
+using namespace Testing;
+
+/// Every backend with alphabets it can find, in every tier, against the naive scan and the records between its matches
+int main(){
+	std::string punct;
+	for(int c = 0; c < 128; ++c){
+		if(std::ispunct(c)){
+			punct += static_cast<char>(c);
+		}
+	}
+
+	struct Case{
+		Backend backend;
+		std::string alphabet;
+	};
+	std::vector<Case> cases{
+		{Backend::Fallback, "\n"},
+		{Backend::Fallback, std::string(" ,.e\n\0\xff", 7)},
+		{Backend::JIT, "\n"},
+		{Backend::JIT, " ,.e\n"},
+		{Backend::LF, "\n"},
+		{Backend::CSV, ",\n"},
+		{Backend::TSV, "\t\n"},
+		{Backend::Space, " "},
+		{Backend::Punct, punct},
+		{Backend::CharSet, "|"},
+		{Backend::CharSet, "\r\n"},
+		{Backend::CharSet, "\x1f\x1e"},
+		{Backend::SIMD, "\n"},
+		{Backend::SIMD, ",\n\t|"},
+		{Backend::Shuffle, "\n"},
+		{Backend::Shuffle, std::string("aeiou,.\n\0\xff", 10)},
+		{Backend::Auto, ",\n"},
+	};
+
+	// uniform bytes, with a dense part straddling the boundary of the 2nd and 3rd tasks
+	std::vector<uint8_t> data(3 * taskSize + 12345);
+	std::mt19937 rng{42};
+	for(auto &b: data){
+		b = rng();
+	}
+	auto dense = makeData(4 * windowSize, " ,.e\n\t|");
+	std::copy(begin(dense), end(dense), begin(data) + 2 * taskSize - 2 * windowSize);
+
+	ScannableT all{data.data(), data.size()};
+	std::vector<ScannableT> samples{
+		all.subspan(1, 0),
+		all.subspan(1, 1),
+		all.subspan(1, 65),  // misaligned and having a partial SIMD block
+		all.subspan(3, windowSize + 3),
+		all.subspan(1),
+	};
+
+	setThreadsCount(4);
+	for(auto tier: getSupportedTiers()){
+		forceTier(tier);
+		for(auto &c: cases){
+			auto alphabet = chars(c.alphabet);
+			for(auto m: samples){
+				auto what = describe(c.backend, tier, std::to_string(alphabet.size()) + " chars, " + std::to_string(m.size()) + " bytes");
+				std::vector<uint64_t> actual;
+				try{
+					actual = flatten(scan(m, alphabet, c.backend));
+				} catch(std::logic_error &e){
+					check(c.backend != Backend::Fallback, what + " threw " + e.what());
+					break;  // not built in or not available in this tier
+				}
+				auto expected = referenceOffsets(m, alphabet);
+				check(actual == expected, what + " scan");
+				check(count(m, alphabet, c.backend) == expected.size(), what + " count");
+				check(collectRecords(m, alphabet, c.backend) == referenceRecords(m.size(), expected), what + " records");
+			}
+		}
+	}
+	forceTier(Tier::Auto);
+	return report();
+}
@@ -0,0 +1,61 @@
+#include "Testing.hpp"
+
+using namespace ScanBytes;
+using namespace Testing;
+
+namespace {
+	std::string makeField(std::mt19937 &rng, size_t length){
+		static const char *tokens[] = {"a", "b", ",", "\n", "\t", "\"\""};
+		std::string res = "\"";
+		while(res.size() < length){
+			res += tokens[rng() % std::size(tokens)];
+		}
+		return res + "\"";
+	}
+
+	/// Records of plain and quoted fields, a long quoted field spans every boundary of the tasks and a few of the windows
+	std::vector<uint8_t> makeCSV(size_t size){
+		std::mt19937 rng{42};
+		std::string res;
+		size_t nextBoundary = taskSize;
+		while(res.size() < size){
+			if(res.size() + 512 > nextBoundary){  // a record is shorter, so the field starts before the boundary
+				res += makeField(rng, 3 * windowSize) + ",";
+				nextBoundary += taskSize;
+			}
+			for(auto fields = rng() % 5; fields; --fields){
+				res += rng() % 3 ? std::string(rng() % 10, 'x') : makeField(rng, rng() % 40);
+				res += rng() % 4 ? "," : "\t";
+			}
+			res += "end\n";
+		}
+		return {begin(res), end(res)};
+	}
+};
+
+/// Quoted fields spanning the windows, the tasks and the buffers of a stream, against the naive scan
+int main(){
+	auto data = makeCSV(3 * taskSize + 12345);
+	ScannableT m{data.data(), data.size()};
+
+	for(auto tier: getSupportedTiers()){
+		forceTier(tier);
+		for(auto alphabet: {chars(",\n"), chars("\t,\n")}){
+			auto expected = referenceQuotedOffsets(m, alphabet);
+			auto what = [&](const std::string &s){
+				return describe(Backend::CSVQuoted, tier, std::to_string(alphabet.size()) + " delimiters, " + s);
+			};
+			for(uint16_t threadsCount: {1, 4}){
+				setThreadsCount(threadsCount);
+				check(flatten(scan(m, alphabet, Backend::CSVQuoted)) == expected, what(std::to_string(threadsCount) + " threads, scan"));
+				check(count(m, alphabet, Backend::CSVQuoted) == expected.size(), what(std::to_string(threadsCount) + " threads, count"));
+				check(collectRecords(m, alphabet, Backend::CSVQuoted) == referenceRecords(m.size(), expected), what(std::to_string(threadsCount) + " threads, records"));
+			}
+			for(size_t pieceSize: {windowSize - 1, size_t(3 * 4096 + 7)}){
+				check(scanAsStream(m, alphabet, Backend::CSVQuoted, pieceSize) == expected, what("stream of " + std::to_string(pieceSize) + "-byte buffers"));
+			}
+		}
+	}
+	forceTier(Tier::Auto);
+	return report();
+}
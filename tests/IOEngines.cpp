@@ -0,0 +1,102 @@
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include <unistd.h>
+
+#include <ScanBytes/IOEngine.hpp>
+#include <ScanBytes/Stream.hpp>
+
+#include "Testing.hpp"
+
+using namespace ScanBytes;
+using namespace Testing;
+
+namespace {
+	const auto alphabet = chars("\n,");
+
+	void writeFile(const std::string &path, const std::vector<uint8_t> &data){
+		std::ofstream out(path, std::ios::binary);
+		out.write(reinterpret_cast<const char *>(data.data()), data.size());
+	}
+
+	size_t getThreadsOfProcess(){
+		auto tasks = std::filesystem::directory_iterator("/proc/self/task");
+		return std::distance(begin(tasks), end(tasks));
+	}
+
+	/// The prefetcher of a Readahead mapping exits once its scans are over, it is given a while to notice
+	bool waitThreadsOfProcess(size_t count){
+		for(unsigned i = 0; i < 500 && getThreadsOfProcess() != count; ++i){
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return getThreadsOfProcess() == count;
+	}
+
+	template<typename ExceptionT, typename FuncT>
+	bool throws(FuncT f){
+		try{
+			f();
+		} catch(const ExceptionT &){
+			return true;
+		}
+		return false;
+	}
+};
+
+/// Files mapped with every mapping engine and streamed with the reading ones, against the naive scan. The file is larger than the windows the Readahead prefetcher requests before the scan starts.
+int main(){
+	auto data = makeData(40 * taskSize + 12345, "abc\n,");
+	auto expected = referenceOffsets(ScannableT{data.data(), data.size()}, alphabet);
+	auto path = (tempDir.path / "data.csv").string();
+	writeFile(path, data);
+	auto emptyPath = (tempDir.path / "empty.csv").string();
+	writeFile(emptyPath, {});
+	auto missingPath = (tempDir.path / "missing.csv").string();
+
+	setThreadsCount(2);
+	scan(ScannableT{data.data(), windowSize}, alphabet, Backend::CSV);  // the pool is started before the threads are counted
+	auto threadsCount = getThreadsOfProcess();
+
+	for(auto engine: {IOEngine::Auto, IOEngine::Mmap, IOEngine::Populate, IOEngine::Readahead}){
+		std::string what = ioEngineNames[static_cast<uint8_t>(engine)];
+		{
+			FileMapping f{path, engine};
+			check(f.engine != IOEngine::Auto && isMappingEngine(f.engine), what + ": the engine is resolved");
+			check(std::equal(begin(f.data), end(f.data), begin(data), end(data)), what + ": the data mapped");
+			check(flatten(scan(f.data, alphabet, Backend::CSV)) == expected, what + ": scan");
+			check(count(f.data, alphabet, Backend::CSV) == expected.size(), what + ": the second scan");
+			check(waitThreadsOfProcess(threadsCount), what + ": no thread is left after the scans");
+		}
+		check(waitThreadsOfProcess(threadsCount), what + ": no thread is left after unmapping");
+
+		FileMapping empty{emptyPath, engine};
+		check(empty.data.empty() && flatten(scan(empty.data, alphabet, Backend::CSV)).empty(), what + ": empty file");
+		check(throws<std::system_error>([&]{FileMapping{missingPath, engine};}), what + ": a missing file throws");
+		check(throws<std::logic_error>([&]{openForStreaming(path, engine);}), what + ": the mapping engine doesn't stream");
+	}
+
+	for(auto engine: {IOEngine::Read, IOEngine::Direct}){
+		std::string what = ioEngineNames[static_cast<uint8_t>(engine)];
+		check(!isMappingEngine(engine), what + ": is not a mapping engine");
+		int fd = openForStreaming(path, engine);
+		std::vector<uint64_t> res;
+		auto size = scanStream(fd, alphabet, Backend::CSV, [&](NBST &chunks){
+			auto offsets = flatten(chunks);
+			res.insert(end(res), begin(offsets), end(offsets));
+		}, 4 * directIOAlignment * 64, 3);
+		close(fd);
+		check(res == expected && size == data.size(), what + ": stream");
+		check(throws<std::system_error>([&]{openForStreaming(missingPath, engine);}), what + ": a missing file throws");
+	}
+
+	// the Readahead prefetcher follows a scan of a part of its mapping too, and exits once it is over though the rest has not been requested
+	FileMapping f{path, IOEngine::Readahead};
+	auto part = f.data.subspan(taskSize + 1, 2 * taskSize);
+	check(flatten(scan(part, alphabet, Backend::CSV)) == referenceOffsets(part, alphabet), "Readahead: scan of a part of the mapping");
+	check(waitThreadsOfProcess(threadsCount), "Readahead: no thread is left after the scan of a part");
+	return report();
+}
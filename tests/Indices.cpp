@@ -0,0 +1,222 @@
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <stdexcept>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <ScanBytes/IndexFormat.hpp>
+#include <ScanBytes/IndexReader.hpp>
+#include <ScanBytes/Stream.hpp>
+
+#include "Testing.hpp"
+
+using namespace ScanBytes;
+using namespace Testing;
+
+namespace {
+	const auto alphabet = chars(",\n");
+
+	std::vector<uint8_t> makeTable(size_t size){
+		std::mt19937 rng{42};
+		std::string res;
+		while(res.size() < size){
+			for(auto fields = rng() % 6; fields; --fields){
+				res += std::string(rng() % 12, 'a' + rng() % 26) + ",";
+			}
+			res += std::string(rng() % 200, 'z') + "\n";
+		}
+		res.resize(size);
+		return {begin(res), end(res)};
+	}
+
+	void writeFile(const std::string &path, const std::function<void(std::ostream &out)> &write){
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		write(out);
+	}
+
+	std::string readFile(const std::string &path){
+		std::ifstream in(path, std::ios::binary);
+		std::ostringstream res;
+		res << in.rdbuf();
+		return res.str();
+	}
+
+	void writeIndexOf(const std::string &path, ScannableT m, IndexFormat format){
+		if(format == IndexFormat::Sparse){
+			writeFile(path, [&](std::ostream &out){
+				writeSparseIndex(m, alphabet, Backend::Auto, out, 4096);
+			});
+			return;
+		}
+		IndexHeader h{format};
+		h.setData(m);
+		auto res = scan(m, alphabet);
+		writeFile(path, [&](std::ostream &out){
+			writeIndex(res, out, h);
+		});
+	}
+
+	void checkReader(const std::string &path, ScannableT m, const std::vector<uint64_t> &expected, const std::string &what){
+		IndexReader r{path};
+		if(r.header.format == IndexFormat::Sparse){
+			r.attachData(m);
+		}
+		check(r.size() == expected.size() && r.dataSize() == m.size(), what + ": counts");
+		if(r.size() != expected.size()){
+			return;
+		}
+		std::vector<uint64_t> decoded(r.size());
+		r.decodeAll(decoded.data());
+		check(decoded == expected, what + ": decodeAll");
+		for(uint64_t i = 0; i < r.size(); i += 97){
+			check(r[i] == expected[i], what + ": offset " + std::to_string(i));
+		}
+
+		auto records = referenceRecords(m.size(), expected);
+		check(r.recordsCount() == records.size(), what + ": count of the records");
+		for(uint64_t i = 0; i < records.size(); i += i + 89 < records.size() ? 89 : std::max<uint64_t>(records.size() - 1 - i, 1)){
+			auto record = r.record(i);  // with its delimiter
+			check(record.offset == records[i].offset && record.size == records[i].size + (i < expected.size()), what + ": record " + std::to_string(i));
+		}
+	}
+
+	/// The tables of an index cut short must be refused when it is opened, not read past the mapping
+	void checkTruncated(const std::string &path, const std::string &what){
+		auto size = std::filesystem::file_size(path);
+		for(auto newSize: {size - 1, sizeof(IndexHeader) + (size - sizeof(IndexHeader)) / 2}){
+			std::filesystem::resize_file(path, newSize);
+			bool thrown = false;
+			try{
+				IndexReader r{path};
+			} catch(std::runtime_error &){
+				thrown = true;
+			}
+			check(thrown, what + ": truncated to " + std::to_string(newSize) + " bytes is detected");
+		}
+	}
+
+	/// A CSVQuoted index of a file read as a stream ending within a quoted field, brought up to date after the field is closed by an append
+	void checkQuotedStreamUpdate(const std::string &path, const std::vector<uint8_t> &table){
+		const std::string opening = "\"b\nc", closing = ",d\"\nx,y\n";
+		size_t split = taskSize + 11;
+		std::vector<uint8_t> data(begin(table), begin(table) + split);
+		data.insert(end(data), begin(opening), end(opening));
+		size_t prefixSize = data.size();
+		data.insert(end(data), begin(closing), end(closing));
+		data.insert(end(data), begin(table) + split, end(table));
+		ScannableT m{data.data(), data.size()};
+		auto prefix = m.first(prefixSize);
+
+		auto dataPath = path + ".csv";
+		writeFile(dataPath, [&](std::ostream &out){
+			out.write(reinterpret_cast<const char *>(prefix.data()), prefix.size());
+		});
+		int fd = open(dataPath.c_str(), O_RDONLY | O_CLOEXEC);
+		NBST all;
+		ScanState state;
+		auto dataSize = scanStream(fd, alphabet, Backend::CSVQuoted, [&](NBST &res){
+			for(auto &chunk: res){
+				all.emplace_back(std::move(chunk));
+			}
+		}, state, 64 * 1024);
+		close(fd);
+		check(dataSize == prefixSize && state.inQuote, "CSVQuoted stream: ends within a quoted field");
+
+		IndexHeader h{IndexFormat::Flat, 0, dataSize};
+		h.setTail(prefix.last(std::min<size_t>(prefix.size(), maxTailSize)), dataSize);
+		if(state.inQuote){
+			h.flags |= endsInQuote;
+		}
+		writeFile(path, [&](std::ostream &out){
+			writeIndex(all, out, h);
+		});
+
+		auto expected = referenceQuotedOffsets(m, alphabet);
+		auto added = updateIndex(path, m, alphabet, Backend::CSVQuoted);
+		check(added == expected.size() - referenceQuotedOffsets(prefix, alphabet).size(), "CSVQuoted stream, updated: count of the added offsets");
+		checkReader(path, m, expected, "CSVQuoted stream, updated");
+		IndexReader r{path};
+		check(!(r.header.flags & endsInQuote), "CSVQuoted stream, updated: ends out of quotes");
+	}
+
+	/// Fields index: every field of every 37th record and of the last one against the split of the record
+	void checkFields(const std::string &path, ScannableT m, const std::string &what){
+		ScanState state;
+		auto res = scanTagged(m, alphabet, '\n', Backend::Auto, state);
+		writeFile(path, [&](std::ostream &out){
+			writeIndex(res, out, IndexFormat::Fields, m.size());
+		});
+		IndexReader r{path};
+		auto records = referenceRecords(m.size(), referenceOffsets(m, chars("\n")));
+		check(r.recordsCount() == records.size(), what + ": count of the records");
+		for(uint64_t i = 0; i < records.size(); i += i + 37 < records.size() ? 37 : std::max<uint64_t>(records.size() - 1 - i, 1)){
+			auto record = m.subspan(records[i].offset, records[i].size);
+			auto delimiters = referenceOffsets(record, chars(","));
+			auto fields = referenceRecords(record.size(), delimiters);
+			if(fields.size() == delimiters.size()){  // a record ending with a delimiter has an empty last field
+				fields.emplace_back(Span{record.size(), 0});
+			}
+			check(r.fieldsCount(i) == fields.size(), what + ": count of the fields of record " + std::to_string(i));
+			for(uint64_t f = 0; f < std::min<uint64_t>(fields.size(), r.fieldsCount(i)); ++f){
+				auto field = r.field(i, f);
+				check(field.offset == records[i].offset + fields[f].offset && field.size == fields[f].size, what + ": field " + std::to_string(f) + " of record " + std::to_string(i));
+			}
+		}
+	}
+};
+
+/// Indices of every format read back with IndexReader, and brought up to date with `updateIndex` after an append
+int main(){
+	auto path = (tempDir.path / "data.idx").string();
+
+	auto data = makeTable(2 * taskSize + 777);
+	ScannableT m{data.data(), data.size()};
+	size_t lineEnd = std::find(data.rbegin(), data.rend(), '\n').base() - data.begin();
+	setThreadsCount(4);
+
+	for(auto sample: {m, m.first(lineEnd), m.first(1), m.first(0)}){  // ending within a record and with a delimiter
+		auto expected = referenceOffsets(sample, alphabet);
+		for(auto format: {IndexFormat::Flat, IndexFormat::Packed, IndexFormat::Sparse}){
+			auto what = std::string(indexFormatNames[static_cast<uint8_t>(format)]) + ", " + std::to_string(sample.size()) + " bytes";
+			writeIndexOf(path, sample, format);
+			checkReader(path, sample, expected, what);
+			if(sample.size() == m.size()){
+				checkTruncated(path, what);
+			}
+		}
+		if(sample.size()){
+			checkFields(path, sample, "Fields, " + std::to_string(sample.size()) + " bytes");
+		}
+	}
+
+	auto fullPath = (tempDir.path / "full.idx").string();
+	for(auto format: {IndexFormat::Flat, IndexFormat::Packed, IndexFormat::Sparse}){
+		auto what = std::string(indexFormatNames[static_cast<uint8_t>(format)]) + ", updated";
+		for(size_t prefixSize: {taskSize + 11, lineEnd}){
+			auto prefix = m.first(prefixSize);
+			writeIndexOf(path, prefix, format);
+			auto added = updateIndex(path, m, alphabet);
+			check(added == referenceOffsets(m, alphabet).size() - referenceOffsets(prefix, alphabet).size(), what + ": count of the added offsets");
+			writeIndexOf(fullPath, m, format);
+			check(readFile(path) == readFile(fullPath), what + " from " + std::to_string(prefixSize) + " bytes: the same as built from scratch");
+			checkReader(path, m, referenceOffsets(m, alphabet), what);
+		}
+
+		auto changed = data;
+		changed[taskSize] ^= 1;  // within the fingerprinted tail of the prefix
+		writeIndexOf(path, ScannableT{changed.data(), taskSize + 11}, format);
+		bool thrown = false;
+		try{
+			updateIndex(path, m, alphabet);
+		} catch(std::runtime_error &){
+			thrown = true;
+		}
+		check(thrown, what + ": changed data is detected");
+	}
+	checkQuotedStreamUpdate(path, data);
+
+	return report();
+}
@@ -0,0 +1,88 @@
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <ScanBytes/Scanner.hpp>
+#include <ScanBytes/IndexFormat.hpp>
+
+#include "Testing.hpp"
+
+using namespace ScanBytes;
+using namespace Testing;
+
+namespace {
+	const auto alphabet = chars("\n");
+
+	/// Every block knows the worker whose equal range of the tasks has had its task and the count of the workers of the scan
+	void checkWorkers(NBST &chunks, size_t tasksCount, uint16_t workersCount, const std::string &what){
+		std::vector<uint16_t> expected;
+		for(uint16_t w = 0; w < workersCount; ++w){
+			expected.insert(end(expected), tasksCount / workersCount + (w < tasksCount % workersCount), w);
+		}
+		bool ok = !chunks.empty();
+		for(auto &chunk: chunks){
+			ok = ok && chunk->workersCount == workersCount && chunk->id < tasksCount && chunk->worker == expected[chunk->id];
+		}
+		check(ok, what + ": the workers of the blocks");
+	}
+
+	bool isSameAffinity(const cpu_set_t &a){
+		cpu_set_t b;
+		sched_getaffinity(0, sizeof(b), &b);
+		return CPU_EQUAL(&a, &b);
+	}
+
+	std::string readFile(const std::string &path){
+		std::ifstream in(path, std::ios::binary);
+		std::ostringstream res;
+		res << in.rdbuf();
+		return res.str();
+	}
+};
+
+/// Scans and parallel writes of the indices with the threads placed on the nodes and the cores, the workers recorded in the blocks are the ones of the pool that has scanned them
+int main(){
+	// so dense that writing the index is split among the threads
+	size_t tasksCount = 10;
+	auto data = makeData((tasksCount - 1) * taskSize + 100, "abc\n");
+	ScannableT m{data.data(), data.size()};
+	auto expected = referenceOffsets(m, alphabet);
+	auto path = (tempDir.path / "data.idx").string();
+
+	cpu_set_t initial;
+	sched_getaffinity(0, sizeof(initial), &initial);
+
+	for(auto placement: {ThreadPlacement::OS, ThreadPlacement::Nodes, ThreadPlacement::Cores}){
+		setThreadPlacement(placement);
+		auto what = [&](const std::string &s){
+			return std::string(threadPlacementNames[static_cast<uint8_t>(placement)]) + ": " + s;
+		};
+
+		setThreadsCount(4);
+		auto res = scan(m, alphabet, Backend::LF);
+		check(flatten(res) == expected, what("scan"));
+		checkWorkers(res, tasksCount, 4, what("scan"));
+		check(isSameAffinity(initial), what("the affinity of the calling thread is restored"));
+
+		setThreadsCount(3);
+		Scanner scanner{alphabet, Backend::LF};
+		setThreadsCount(8);  // the pool of the scanner keeps 3 workers
+		auto scannerRes = scanner.scan(m);
+		checkWorkers(scannerRes, tasksCount, 3, what("Scanner"));
+
+		IndexHeader h{IndexFormat::Flat};
+		h.setData(m);
+		int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		writeIndex(scannerRes, fd, h);
+		close(fd);
+		std::ostringstream out;
+		writeIndex(scannerRes, out, h);
+		check(readFile(path) == out.str(), what("the index written in parallel is the same as the one written sequentially"));
+		check(isSameAffinity(initial), what("the affinity of the calling thread is restored after writing"));
+	}
+	setThreadPlacement(ThreadPlacement::OS);
+	return report();
+}
@@ -0,0 +1,66 @@
+#include <fstream>
+#include <mutex>
+
+#include <ScanBytes/Scanner.hpp>
+
+#include "Testing.hpp"
+
+using namespace ScanBytes;
+using namespace Testing;
+
+namespace {
+	const auto alphabet = chars("\n,");
+
+	void writeFile(const std::string &path, const std::vector<uint8_t> &data){
+		std::ofstream out(path, std::ios::binary);
+		out.write(reinterpret_cast<const char *>(data.data()), data.size());
+	}
+};
+
+/// A batch of the files read by the workers and of the ones mapped and split over the pool, and of the missing ones, against the naive scan of every file
+int main(){
+	std::vector<std::vector<uint8_t>> contents;
+	for(size_t size: {size_t(0), size_t(1), size_t(1000), windowSize + 1, taskSize, taskSize + 1, 3 * taskSize + 12345}){
+		contents.emplace_back(makeData(size, "abc\n,", contents.size()));
+	}
+	std::vector<std::string> paths;
+	for(size_t i = 0; i < contents.size(); ++i){
+		paths.emplace_back((tempDir.path / (std::to_string(i) + ".csv")).string());
+		writeFile(paths.back(), contents[i]);
+	}
+	size_t missing = 3;
+	paths.insert(begin(paths) + missing, (tempDir.path / "missing.csv").string());
+	contents.insert(begin(contents) + missing, std::vector<uint8_t>{});
+
+	for(uint16_t threadsCount: {1, 4}){
+		setThreadsCount(threadsCount);
+		auto what = std::to_string(threadsCount) + " threads, ";
+		Scanner scanner{alphabet, Backend::CSV};
+
+		std::mutex lock;
+		std::vector<std::vector<uint64_t>> offsets(paths.size());
+		std::vector<unsigned> calls(paths.size());
+		bool isDataSame = true, isBaseAtEnd = true;
+		auto errors = scanner.scanFiles(paths, [&](size_t fileIndex, ScannableT data, NBST &chunks, ScanState &state){
+			std::lock_guard<std::mutex> guard(lock);
+			++calls[fileIndex];
+			offsets[fileIndex] = flatten(chunks);
+			isDataSame = isDataSame && std::equal(begin(data), end(data), begin(contents[fileIndex]), end(contents[fileIndex]));
+			isBaseAtEnd = isBaseAtEnd && state.base == data.size();
+		});
+
+		check(errors.size() == 1 && errors.front().fileIndex == missing && errors.front().message.find(paths[missing]) != std::string::npos, what + "the missing file is reported");
+		check(isDataSame, what + "the data passed is the one of the file");
+		check(isBaseAtEnd, what + "the state is at the end of the file");
+		for(size_t i = 0; i < paths.size(); ++i){
+			auto file = what + "file of " + std::to_string(contents[i].size()) + " bytes";
+			if(i == missing){
+				check(!calls[i], file + ": the missing file is not passed");
+				continue;
+			}
+			check(calls[i] == 1, file + ": passed once");
+			check(offsets[i] == referenceOffsets(ScannableT{contents[i].data(), contents[i].size()}, alphabet), file + ": offsets");
+		}
+	}
+	return report();
+}
@@ -0,0 +1,65 @@
+#include "Testing.hpp"
+
+using namespace ScanBytes;
+using namespace Testing;
+
+namespace {
+	const std::vector<std::string> sequences{"\r\n", "||", "<EOR>"};
+
+	/// The longest sequence at the leftmost position not covered by the previous match
+	void referenceSequences(ScannableT m, std::vector<uint64_t> &offsets, std::vector<uint8_t> &lengths){
+		for(size_t i = 0; i < m.size();){
+			size_t longest = 0;
+			for(auto &s: sequences){
+				if(s.size() > longest && i + s.size() <= m.size() && std::equal(begin(s), end(s), m.begin() + i)){
+					longest = s.size();
+				}
+			}
+			if(longest){
+				offsets.emplace_back(i + longest - 1);
+				lengths.emplace_back(longest);
+				i += longest;
+			} else {
+				++i;
+			}
+		}
+	}
+
+	void put(std::vector<uint8_t> &data, size_t position, const std::string &s){
+		std::copy(begin(s), end(s), begin(data) + position);
+	}
+};
+
+/// Sequences straddling the windows, the tasks and the buffers of a stream, against the naive scan
+int main(){
+	auto data = makeData(3 * taskSize + 12345, "abab\r\n|<EOR>");
+	put(data, taskSize - 1, "\r\n");
+	put(data, 2 * taskSize - 2, "<EOR>");
+	for(size_t w = windowSize; w < data.size(); w += 7 * windowSize){
+		put(data, w - 1, "||");
+	}
+	put(data, 2 * taskSize + windowSize - 501, std::string(1001, '|'));  // the matches of a run depend on where it starts
+	put(data, 3 * taskSize - 333, std::string(1001, '|'));
+	ScannableT m{data.data(), data.size()};
+
+	auto alphabet = encodeSequences(sequences);
+	std::vector<uint64_t> expected;
+	std::vector<uint8_t> lengths;
+	referenceSequences(m, expected, lengths);
+
+	for(auto tier: getSupportedTiers()){
+		forceTier(tier);
+		for(uint16_t threadsCount: {1, 4}){
+			setThreadsCount(threadsCount);
+			auto what = describe(Backend::Sequences, tier, std::to_string(threadsCount) + " threads, ");
+			check(flatten(scan(m, alphabet, Backend::Sequences)) == expected, what + "scan");
+			check(count(m, alphabet, Backend::Sequences) == expected.size(), what + "count");
+			check(collectRecords(m, alphabet, Backend::Sequences) == referenceRecords(m.size(), expected, lengths), what + "records");
+		}
+		for(size_t pieceSize: {size_t(4093), windowSize + 1}){
+			check(scanAsStream(m, alphabet, Backend::Sequences, pieceSize) == expected, describe(Backend::Sequences, tier, "stream of " + std::to_string(pieceSize) + "-byte buffers"));
+		}
+	}
+	forceTier(Tier::Auto);
+	return report();
+}
@@ -0,0 +1,115 @@
+#include <fstream>
+#include <thread>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <ScanBytes/Stream.hpp>
+
+#include "Testing.hpp"
+
+using namespace ScanBytes;
+using namespace Testing;
+
+namespace {
+	const auto alphabet = chars("\n,");
+
+	/// Writes `data` into a pipe in pieces of `pieceSize` bytes, as a producer of a stream does, till it is done or the reading end is closed
+	struct PipeWriter{
+		int fds[2];
+		std::thread thread;
+
+		PipeWriter(const std::vector<uint8_t> &data, size_t pieceSize){
+			if(pipe2(fds, O_CLOEXEC)){
+				throw std::runtime_error("Cannot create a pipe");
+			}
+			thread = std::thread([this, &data, pieceSize]{
+				for(size_t start = 0; start < data.size();){
+					auto written = write(fds[1], data.data() + start, std::min(pieceSize, data.size() - start));
+					if(written <= 0){
+						break;
+					}
+					start += written;
+				}
+				close(fds[1]);
+			});
+		}
+
+		~PipeWriter(){
+			close(fds[0]);
+			thread.join();
+		}
+	};
+
+	std::vector<uint64_t> scanAll(int fd, size_t bufferSize, uint8_t buffersCount, uint64_t &size){
+		std::vector<uint64_t> res;
+		size = scanStream(fd, alphabet, Backend::CSV, [&](NBST &chunks){
+			auto offsets = flatten(chunks);
+			res.insert(end(res), begin(offsets), end(offsets));
+		}, bufferSize, buffersCount);
+		return res;
+	}
+};
+
+/// Streams from a file and from a pipe in buffers smaller and larger than the windows and the tasks of the scans, against the naive scan of the whole data, and the streams whose consumer gives up
+int main(){
+	signal(SIGPIPE, SIG_IGN);  // the writers of the abandoned pipes get EPIPE instead
+
+	auto data = makeData(3 * taskSize + 12345, "abc\n,");
+	ScannableT m{data.data(), data.size()};
+	auto expected = referenceOffsets(m, alphabet);
+	auto path = (tempDir.path / "data.csv").string();
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write(reinterpret_cast<const char *>(data.data()), data.size());
+	}
+
+	for(uint16_t threadsCount: {1, 4}){
+		setThreadsCount(threadsCount);
+		for(size_t bufferSize: {size_t(4093), windowSize + 1, 2 * taskSize}){
+			for(uint8_t buffersCount: {2, 3}){
+				auto what = std::to_string(threadsCount) + " threads, " + std::to_string(buffersCount) + " buffers of " + std::to_string(bufferSize) + " bytes, ";
+				uint64_t size = 0;
+
+				int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				check(scanAll(fd, bufferSize, buffersCount, size) == expected && size == data.size(), what + "file");
+				close(fd);
+
+				fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				check(countStream(fd, alphabet, Backend::CSV, bufferSize, buffersCount) == expected.size(), what + "count of a file");
+				close(fd);
+
+				PipeWriter writer{data, 1000};
+				check(scanAll(writer.fds[0], bufferSize, buffersCount, size) == expected && size == data.size(), what + "pipe");
+			}
+		}
+	}
+
+	std::vector<uint8_t> nothing;
+	PipeWriter empty{nothing, 1};
+	uint64_t size = 1;
+	check(scanAll(empty.fds[0], 4096, 2, size).empty() && !size, "empty pipe");
+
+	// the reader thread is waiting for a pipe that is still being written when the consumer throws
+	PipeWriter writer{data, 1000};
+	bool isRethrown = false;
+	try{
+		scanStream(writer.fds[0], alphabet, Backend::CSV, [](NBST &){
+			throw std::runtime_error("consumer has given up");
+		}, windowSize, 2);
+	} catch(const std::runtime_error &e){
+		isRethrown = std::string(e.what()) == "consumer has given up";
+	}
+	check(isRethrown, "the exception of the consumer is rethrown");
+
+	bool isRejected = false;
+	try{
+		scanStream(writer.fds[0], alphabet, Backend::CSV, [](NBST &){}, windowSize, 1);
+	} catch(const std::logic_error &){
+		isRejected = true;
+	}
+	check(isRejected, "a single buffer is rejected");
+	return report();
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+#include <filesystem>
+
+#include <unistd.h>
+
+#include <ScanBytes/ScanBytes.hpp>
+#include <ScanBytes/Records.hpp>
+
+/*
+Helpers of the behaviour tests. Every test is an executable comparing the library with naive references and returning the count of the failed checks, so ctest needs no framework.
+The sizes mirror the internal splitting of the data, so the matches and the records straddle the windows and the tasks of the scans.
+*/
+namespace Testing{
+	using ScanBytes::ScannableT;
+
+	const size_t windowSize = 16 * 1024;
+	const size_t taskSize = 64 * windowSize;
+
+	/// A directory of the test removed at its exit. The tuning cache is put there before `main`, so what `Backend::Auto` resolves to doesn't depend on the cache of the host.
+	struct TemporaryDir{
+		std::filesystem::path path;
+
+		TemporaryDir(): path{std::filesystem::temp_directory_path() / ("ScanBytesTests-" + std::to_string(getpid()))}{
+			std::filesystem::create_directories(path);
+			setenv("SCANBYTES_TUNING_CACHE", (path / "tuning.tsv").c_str(), 1);
+		}
+
+		~TemporaryDir(){
+			std::error_code ec;
+			std::filesystem::remove_all(path, ec);
+		}
+	};
+
+	inline const TemporaryDir tempDir;
+
+	inline unsigned failures = 0;
+
+	inline void check(bool ok, const std::string &what){
+		if(!ok){
+			++failures;
+			std::cerr << "FAILED: " << what << std::endl;
+		}
+	}
+
+	inline int report(){
+		if(failures){
+			std::cerr << failures << " checks failed" << std::endl;
+		}
+		return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	template<typename StorageT>
+	std::vector<uint64_t> flatten(const StorageT &chunks){
+		std::vector<uint64_t> res;
+		for(auto &chunk: chunks){
+			res.insert(res.end(), chunk->vec.begin(), chunk->vec.end());
+		}
+		return res;
+	}
+
+	/// Bytes drawn from `pool`, a fixed seed keeps the failures reproducible
+	inline std::vector<uint8_t> makeData(size_t size, const std::string &pool, uint32_t seed = 42){
+		std::mt19937 rng{seed};
+		std::uniform_int_distribution<size_t> pick{0, pool.size() - 1};
+		std::vector<uint8_t> res(size);
+		for(auto &b: res){
+			b = pool[pick(rng)];
+		}
+		return res;
+	}
+
+	inline std::vector<uint8_t> chars(const std::string &s){
+		return {begin(s), end(s)};
+	}
+
+	inline std::vector<uint64_t> referenceOffsets(ScannableT m, const std::vector<uint8_t> &charsToScanFor){
+		bool isMatch[256]{};
+		for(auto c: charsToScanFor){
+			isMatch[c] = true;
+		}
+		std::vector<uint64_t> res;
+		for(size_t i = 0; i < m.size(); ++i){
+			if(isMatch[m[i]]){
+				res.emplace_back(i);
+			}
+		}
+		return res;
+	}
+
+	/// The delimiters out of the quoted fields, a quote escaped by doubling toggles the state twice
+	inline std::vector<uint64_t> referenceQuotedOffsets(ScannableT m, const std::vector<uint8_t> &delimiters){
+		bool isDelimiter[256]{};
+		for(auto c: delimiters){
+			isDelimiter[c] = true;
+		}
+		std::vector<uint64_t> res;
+		bool inQuote = false;
+		for(size_t i = 0; i < m.size(); ++i){
+			if(m[i] == '"'){
+				inQuote = !inQuote;
+			} else if(isDelimiter[m[i]] && !inQuote){
+				res.emplace_back(i);
+			}
+		}
+		return res;
+	}
+
+	struct Span{
+		uint64_t offset;
+		uint64_t size;
+
+		bool operator==(const Span &) const = default;
+	};
+
+	/// The records between the matches ending at `offsets`, `matchLengths` bytes long, without the delimiters
+	inline std::vector<Span> referenceRecords(uint64_t dataSize, const std::vector<uint64_t> &offsets, const std::vector<uint8_t> &matchLengths = {}){
+		std::vector<Span> res;
+		uint64_t start = 0;
+		for(size_t i = 0; i < offsets.size(); ++i){
+			uint64_t matchStart = offsets[i] + 1 - (matchLengths.empty() ? 1 : matchLengths[i]);
+			res.emplace_back(Span{start, matchStart - start});
+			start = offsets[i] + 1;
+		}
+		if(start < dataSize){
+			res.emplace_back(Span{start, dataSize - start});
+		}
+		return res;
+	}
+
+	/// The records passed by `scanRecords`, in order of the data
+	inline std::vector<Span> collectRecords(ScannableT m, const std::vector<uint8_t> &charsToScanFor, ScanBytes::Backend b){
+		std::vector<std::vector<Span>> perTask(ScanBytes::getRecordsTasksCount(m));
+		ScanBytes::scanRecords(m, charsToScanFor, b, [&](uint16_t, size_t task, ScanBytes::RecordsBatchT records){
+			for(auto &r: records){
+				perTask[task].emplace_back(Span{static_cast<uint64_t>(r.data() - m.data()), r.size()});
+			}
+		});
+		std::vector<Span> res;
+		for(auto &t: perTask){
+			res.insert(end(res), begin(t), end(t));
+		}
+		return res;
+	}
+
+	/// Scans `m` as a stream of `pieceSize`-byte buffers
+	inline std::vector<uint64_t> scanAsStream(ScannableT m, const std::vector<uint8_t> &charsToScanFor, ScanBytes::Backend b, size_t pieceSize){
+		ScanBytes::ScanState state;
+		std::vector<uint64_t> res;
+		for(size_t start = 0; start < m.size(); start += pieceSize){
+			auto piece = flatten(ScanBytes::scan(m.subspan(start, std::min(pieceSize, m.size() - start)), charsToScanFor, b, state));
+			res.insert(end(res), begin(piece), end(piece));
+		}
+		return res;
+	}
+
+	/// The tiers of the SIMD kernels this CPU supports
+	inline std::vector<ScanBytes::Tier> getSupportedTiers(){
+		std::vector<ScanBytes::Tier> res;
+		for(auto t: {ScanBytes::Tier::Scalar, ScanBytes::Tier::SSE2, ScanBytes::Tier::SSSE3, ScanBytes::Tier::AVX2, ScanBytes::Tier::AVX512BW}){
+			if(ScanBytes::isTierSupported(t)){
+				res.emplace_back(t);
+			}
+		}
+		return res;
+	}
+
+	inline std::string describe(ScanBytes::Backend b, ScanBytes::Tier t, const std::string &what){
+		return std::string(ScanBytes::backendNames[static_cast<uint8_t>(b)]) + " (" + ScanBytes::tierNames[static_cast<uint8_t>(t)] + "): " + what;
+	}
+};